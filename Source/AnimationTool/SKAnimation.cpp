@@ -34,6 +34,7 @@
 #define RES_X 192
 #define RES_Y 147
 #define NFRAMES 128
+#define MAX_FRAMES 1024
 #define BITS_PER_PIXEL 8
 #define CNT_AFTER_REPETITION 1
 
@@ -56,30 +57,146 @@ const unsigned char tml[ 4 * 4 ] =
 };
 
 // some memory for loading + dithering
-unsigned char rawData[ RES_X * RES_Y * NFRAMES ];
-unsigned char bitData[ RES_X * RES_Y * NFRAMES ];
+unsigned char rawData[ RES_X * RES_Y * MAX_FRAMES ];
+unsigned char bitData[ RES_X * RES_Y * MAX_FRAMES ];
 
 // ... plus generating the output (hopefully large enough)
 unsigned char output[ 512 * 1024 ];
 unsigned char flags[ 512 * 1024 ];
 unsigned char bitflags[ 512 * 1024 / 8 ];
 
+//
+// delta-frame format (option 'd'), all values little endian:
+//
+//   u32 magic 'SKAD', u16 bytes per row (24), u16 rows (147), u16 number of frames, u16 reserved
+//   u32 offset of the delta stream for each transition frame i -> i+1 (the last one wraps to frame 0),
+//       relative to the start of the delta streams
+//   key frame (frame 0, 1 bit per pixel, 24 bytes per row)
+//   delta streams
+//
+// A transition is the XOR of two consecutive frames, i.e. the same stream is used to play the
+// animation forward and backward. Each stream is a sequence of ops covering the entire frame:
+//
+//   00nnnnnn        skip n+1 unchanged bytes
+//   01nnnnnn b...   XOR the next n+1 bytes with the following n+1 data bytes
+//   10nnnnnn b      XOR the next n+1 bytes with b
+//   11nnnnnn        skip (n+1)*64 unchanged bytes
+//
+#define DELTA_MAGIC 0x44414b53
+#define FRAME_BYTES ( RES_X * RES_Y / 8 )
+// the firmware keeps the entire file in a 128 KB block
+#define MAX_FILE_SIZE ( 128 * 1024 )
+
+int writeDeltaAnimation( const char *filename, int nFrames )
+{
+	unsigned int deltaOfs[ MAX_FRAMES ];
+	int size = 0;
+
+	for ( int t = 0; t < nFrames; t++ )
+	{
+		const unsigned char *a = &bitData[ t * FRAME_BYTES ];
+		const unsigned char *b = &bitData[ ( ( t + 1 ) % nFrames ) * FRAME_BYTES ];
+		unsigned char d[ FRAME_BYTES ];
+
+		for ( int i = 0; i < FRAME_BYTES; i++ )
+			d[ i ] = a[ i ] ^ b[ i ];
+
+		deltaOfs[ t ] = size;
+
+		int pos = 0;
+		while ( pos < FRAME_BYTES )
+		{
+			int n = 0;
+
+			if ( d[ pos ] == 0 )
+			{
+				while ( pos + n < FRAME_BYTES && d[ pos + n ] == 0 && n < 64 * 64 ) n ++;
+
+				if ( n >= 64 )
+				{
+					output[ size ++ ] = 0xc0 | ( n / 64 - 1 );
+					n = n / 64 * 64;
+				} else
+					output[ size ++ ] = n - 1;
+			} else
+			{
+				while ( pos + n < FRAME_BYTES && d[ pos + n ] == d[ pos ] && n < 64 ) n ++;
+
+				if ( n >= 3 )
+				{
+					output[ size ++ ] = 0x80 | ( n - 1 );
+					output[ size ++ ] = d[ pos ];
+				} else
+				{
+					// literal bytes up to the next unchanged byte or run
+					n = 0;
+					while ( pos + n < FRAME_BYTES && d[ pos + n ] != 0 && n < 64 &&
+							!( pos + n + 2 < FRAME_BYTES && d[ pos + n ] == d[ pos + n + 1 ] && d[ pos + n ] == d[ pos + n + 2 ] && n > 0 ) )
+						n ++;
+
+					output[ size ++ ] = 0x40 | ( n - 1 );
+					memcpy( &output[ size ], &d[ pos ], n );
+					size += n;
+				}
+			}
+			pos += n;
+
+			if ( size > (int)sizeof( output ) - 256 )
+			{
+				printf( "animation too large\n" );
+				return 0;
+			}
+		}
+	}
+
+	int fileSize = 12 + nFrames * 4 + FRAME_BYTES + size;
+	if ( fileSize > MAX_FILE_SIZE )
+	{
+		printf( "animation too large: %d bytes, the firmware accepts up to %d bytes (use fewer frames)\n", fileSize, MAX_FILE_SIZE );
+		return 0;
+	}
+
+	FILE *f = fopen( filename, "wb" );
+	if ( f == NULL )
+	{
+		printf( "cannot write %s\n", filename );
+		return 0;
+	}
+
+	unsigned int magic = DELTA_MAGIC;
+	unsigned short dims[ 4 ] = { RES_X / 8, RES_Y, (unsigned short)nFrames, 0 };
+	fwrite( &magic, 1, 4, f );
+	fwrite( dims, 1, sizeof( dims ), f );
+	fwrite( deltaOfs, 4, nFrames, f );
+	fwrite( bitData, 1, FRAME_BYTES, f );
+	fwrite( output, 1, size, f );
+	fclose( f );
+
+	printf( "%d frames, %d bytes of deltas\n", nFrames, size );
+
+	return 1;
+}
+
 int main( int argc, char **argv )
 {
 	char path[ 2048 ] = { 0 };
 	int flipY = 0;
 	int ditherType = 0;
+	int deltaFormat = 0;
+	int nFrames = NFRAMES;
 	float gamma = 1.5f, scale = 395.0f / 255.0f;
 
 	if ( argc < 5 )
 	{
-		printf( "usage: skanim f{l|o} gamma scale path output.zap\n" );
+		printf( "usage: skanim f{l|o}d gamma scale path [output.zap [frames]]\n" );
 		printf( "       converts a sequence of 128 raw-images (resolution 192x147, 8-bit gray scale) with filename 0000.raw 0001.raw etc.\n\n" );
 		printf( "       f       flip images vertically (not shown in preview!)\n" );
 		printf( "       o       standard ordered dither matrix\n" );
 		printf( "       l       line-like dither matrix\n" );
+		printf( "       d       write the delta-frame format (faster to decode), which also allows for more than 128 frames\n" );
 		printf( "       gamma   gamma-correction value (typically between 0.5 and 2.5)\n" );
 		printf( "       scale   brightness scaling (1.0 and 2.0)\n" );
+		printf( "       frames  number of images (default 128, delta-frame format only, up to %d)\n", MAX_FRAMES );
 		printf( "       e.g. \"skanim fl 1.5 1.55 ./images animation.zap\" creates a flipped animation with line dithering-style.\n" );
 		exit( 1 );
 	}
@@ -87,6 +204,17 @@ int main( int argc, char **argv )
 	// options
 	if ( strstr( argv[ 1 ], "f" ) != 0 ) flipY = 1;
 	if ( strstr( argv[ 1 ], "l" ) != 0 ) ditherType = 1;
+	if ( strstr( argv[ 1 ], "d" ) != 0 ) deltaFormat = 1;
+
+	if ( argc > 6 && deltaFormat )
+	{
+		nFrames = atoi( argv[ 6 ] );
+		if ( nFrames < 2 || nFrames > MAX_FRAMES )
+		{
+			printf( "number of frames must be between 2 and %d\n", MAX_FRAMES );
+			exit( 1 );
+		}
+	}
 
 	// gamma + scale
 	gamma = atof( argv[ 2 ] );
@@ -100,22 +228,26 @@ int main( int argc, char **argv )
 		path[ strlen( path ) + 1 ] = 0;
 	}
 
-	for ( int i = 0; i < NFRAMES; i++ )
+	for ( int i = 0; i < nFrames; i++ )
 	{
 		char fn[ 4096 ];
 		sprintf( fn, "%s%04d.raw", path, i );
 
 		FILE *f = fopen( fn, "rb" );
-		fread( &rawData[ i * RES_X * RES_Y ], 1, RES_X * RES_Y, f );
+		if ( f == NULL || fread( &rawData[ i * RES_X * RES_Y ], 1, RES_X * RES_Y, f ) != RES_X * RES_Y )
+		{
+			printf( "cannot read %s\n", fn );
+			exit( 1 );
+		}
 		fclose( f );
 	}
 
-	memset( bitData, 0, RES_X * RES_Y * NFRAMES );
+	memset( bitData, 0, sizeof( bitData ) );
 
 	//
 	// Gamma-correction + dithering
 	//
-	for ( int f = 0; f < NFRAMES; f++ )
+	for ( int f = 0; f < nFrames; f++ )
 	{
 		for ( int y = 0; y < RES_Y; y++ )
 		{
@@ -163,6 +295,9 @@ int main( int argc, char **argv )
 		fclose( g );
 	}
 
+	if ( deltaFormat )
+		return writeDeltaAnimation( argc > 5 ? argv[ 5 ] : "animation.zap", nFrames ) ? 0 : 1;
+
 	//
 	//
 	// RLE compression for "per-pixel" incremental reconstruction
@@ -0,0 +1,15 @@
+#!/bin/sh
+# build the converter (plain C++, no dependencies)
+g++ -O2 -o skanim SKAnimation.cpp -lm || exit 1
+
+rm -f animation.gif animation.mp4
+
+# flip + line dithering, brightness/gamma, source directory, destination file
+# (add 'd' to the options, e.g. "fld", for the delta-frame format)
+./skanim fl 1.5 1.55 /tmp/images animation.zap
+
+# generate a preview
+ffmpeg -f image2 -pix_fmt gray -framerate 25 -pattern_type sequence -start_number 0 -s 192x147 -i "out%04d.raw" animation.mp4
+ffmpeg -i animation.mp4 -vf vflip -pix_fmt gray -s 192x147 animation.gif
+
+rm -f out*.raw animation.mp4
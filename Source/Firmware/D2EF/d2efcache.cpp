@@ -0,0 +1,81 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ d2efcache.cpp
+
+ Sidekick64 - A framework for interfacing 8-Bit Commodore computers (C64/C128,C16/Plus4,VC20) and a Raspberry Pi Zero 2 or 3A+/3B+
+            - cache for EasyFlash images created from D64 files (D2EF)
+ Copyright (c) 2019-2022 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <circle/util.h>
+#include "../sdcache.h"
+
+// cached EasyFlash images are stored in SD:C64/D2EF, see sdcache.h
+#define D2EF_CACHE_FOLDER		"SD:C64/D2EF"
+#define D2EF_CACHE_MAX_ENTRIES	64
+#define D2EF_CACHE_MAX_SIZE		( 32 * 1024 * 1024 )
+
+// bump when the output of createD2EF changes (e.g. new kapi/launcher binaries)
+#define D2EF_CACHE_VERSION		1
+
+extern int createD2EF( unsigned char *diskimage, int imageSize, unsigned char *cart, int build, int mode, int autostart );
+
+typedef struct
+{
+	u32 magic;
+	u32 imageSize;
+	u64 imageHash;
+	u8  version, build, mode, autostart;
+} __attribute__((packed)) D2EF_CACHE_HEADER;
+
+static SDCACHE d2efCache = SDCACHE_INIT( D2EF_CACHE_FOLDER, D2EF_CACHE_MAX_ENTRIES, D2EF_CACHE_MAX_SIZE );
+
+int createD2EFCached( CLogger *logger, unsigned char *diskimage, int imageSize, unsigned char *cart, u32 cartMaxSize, int build, int mode, int autostart )
+{
+	D2EF_CACHE_HEADER header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = 0x46453244;	// "D2EF"
+	header.imageSize = imageSize;
+	header.imageHash = sdCacheHash( diskimage, imageSize );
+	header.version = D2EF_CACHE_VERSION;
+	header.build = build;
+	header.mode = mode;
+	header.autostart = autostart ? 1 : 0;
+
+	u64 h = sdCacheHash( &header, sizeof( header ) );
+	u32 key = (u32)( h ^ ( h >> 32 ) );
+
+	u32 crtSize = 0;
+	if ( sdCacheRead( logger, &d2efCache, key, &header, sizeof( header ), cart, &crtSize, cartMaxSize ) )
+	{
+		logger->Write( "d2ef", LogNotice, "using cached EasyFlash image %08x (%d bytes)", key, crtSize );
+		return crtSize;
+	}
+
+	crtSize = createD2EF( diskimage, imageSize, cart, build, mode, autostart );
+
+	if ( crtSize > 0 )
+		sdCacheWrite( logger, &d2efCache, key, &header, sizeof( header ), cart, crtSize );
+
+	return crtSize;
+}
@@ -38,19 +38,32 @@
 //#define DIGITAL_WRITE_HIGH(PORT) 
 //#define DIGITAL_WRITE_LOW(PORT) 
 
+// SDA level after the queued commands (255 = unknown), unchanged SDA levels are not queued at all
 static u32 lastSDA = 255;
 
 // PORT = SSD1306_SDA or SSD1306_SCL
 void DIGITAL_WRITE_HIGH( u32 PORT )
 {
+	if ( bufferEmptyI2C() )
+		lastSDA = 255;
+	if ( PORT == SSD1306_SDA )
+	{
+		if ( lastSDA == 1 ) return;
+		lastSDA = 1;
+	}
 	putI2CCommand( (PORT << 1) | 1 );
-	lastSDA = 1;
 }
 
 void DIGITAL_WRITE_LOW( u32 PORT )
 {
+	if ( bufferEmptyI2C() )
+		lastSDA = 255;
+	if ( PORT == SSD1306_SDA )
+	{
+		if ( lastSDA == 0 ) return;
+		lastSDA = 0;
+	}
 	putI2CCommand( (PORT << 1) | 0 );
-	lastSDA = 0;
 }
 
 // ----------------------------------------------------------------------------
@@ -47,6 +47,9 @@
 
 #include "reloc65.h"
 #include "screen.h"
+#include "../sidplay/utils/SidDatabase.h"
+#include "stilview/stilindex.h"
+#include <fatfs/ff.h>
 //#include "sidid.h"
 //#include "theme.h"
 //#include "stilview/stil.h"
@@ -71,6 +74,27 @@
 //////////////////////////////////////////////////////////////////////////////
 static char* emptyString = "";
 
+// HVSC song-length database: Songlengths.md5 is looked for in these locations,
+// the binary index built from it is kept in SONGLENGTHS_INDEX
+static const char* songlengthsLocations[] = {
+    "SD:SID/DOCUMENTS/Songlengths.md5",
+    "SD:SID/Songlengths.md5",
+    "SD:C64/Songlengths.md5",
+    NULL
+};
+#define SONGLENGTHS_INDEX "SD:C64/songlengths.idx"
+
+// shared by all Psid64 instances and loaded only once
+static SidDatabase songlengthsDatabase;
+static bool songlengthsDatabaseTried = false;
+
+// STIL index of the HVSC collection the last converted tune belongs to
+#define STIL_INDEX "SD:C64/stil.idx"
+static StilIndex stilIndex;
+
+// top-level folders of HVSC, used to locate the HVSC root in a file name
+static const char* hvscFolders[] = { "/MUSICIANS/", "/GAMES/", "/DEMOS/", NULL };
+
 #if defined(HAVE_IOS_OPENMODE)
     typedef std::ios::openmode openmode;
 #else
@@ -90,6 +114,7 @@ struct block_t
 
 static inline unsigned int min(unsigned int a, unsigned int b);
 static bool block_cmp(const block_t& a, const block_t& b);
+static const char* locateStilFile(const char* fileName, char* path, char* stilFileName);
 //static void setThemeGlobals(globals_t& globals, Psid64::Theme theme);
 
 
@@ -226,14 +251,13 @@ Psid64::Psid64() :
     //m_theme(THEME_DEFAULT),
     m_status(false),
     m_statusString(NULL),
-    //m_fileName(),
     m_tune(0),
     m_tuneInfo(),
 //    m_database(),
     //m_stil(new STIL),
     //m_sidId(new SidId),
     m_screen(new Screen),
-    //m_stilText(),
+    m_stilTextLength(0),
     m_songlengthsData(),
     m_songlengthsSize(0),
     m_driverPage(0),
@@ -245,6 +269,7 @@ Psid64::Psid64() :
     m_programData(NULL),
     m_programSize(0)
 {
+    m_fileName[0] = '\0';
 }
 
 // destructor
@@ -291,6 +316,65 @@ Psid64::~Psid64()
 
 
 
+void Psid64::setFileName(const char* fileName)
+{
+    strncpy(m_fileName, fileName, sizeof(m_fileName) - 1);
+    m_fileName[sizeof(m_fileName) - 1] = '\0';
+}
+
+
+// adds size and modification time of a file (if present) to an FNV-1a hash
+static uint_least32_t
+hashFileStamp(uint_least32_t stamp, const char* fileName)
+{
+    FILINFO info;
+    uint_least32_t data[2] = { 0, 0 };
+    if (f_stat(fileName, &info) == FR_OK)
+    {
+	data[0] = (uint_least32_t)info.fsize;
+	data[1] = ((uint_least32_t)info.fdate << 16) | info.ftime;
+    }
+
+    const uint_least8_t* p = (const uint_least8_t*)data;
+    for (unsigned int i = 0; i < sizeof(data); ++i)
+    {
+	stamp = (stamp ^ p[i]) * 16777619u;
+    }
+    return stamp;
+}
+
+
+uint_least32_t Psid64::getDatabaseStamp()
+{
+#ifndef WITH_NET
+    static FATFS stampFileSystem;
+    if (f_mount(&stampFileSystem, "SD:", 1) != FR_OK)
+    {
+	return 0;
+    }
+#endif
+
+    uint_least32_t stamp = 2166136261u;
+    for (int i = 0; songlengthsLocations[i] != NULL; ++i)
+    {
+	stamp = hashFileStamp(stamp, songlengthsLocations[i]);
+    }
+
+    char fileName[sizeof(m_fileName)];
+    char stilFileName[sizeof(m_fileName) + 32];
+    if (m_fileName[0] != '\0' && locateStilFile(m_fileName, fileName, stilFileName) != NULL)
+    {
+	stamp = hashFileStamp(stamp, stilFileName);
+    }
+
+#ifndef WITH_NET
+    f_mount(0, "SD:", 0);
+#endif
+
+    return stamp;
+}
+
+
 bool Psid64::load( unsigned char* sidData, int sidLength )
 {
 	if ( !m_tune.load( sidData, sidLength ) )
@@ -433,8 +517,8 @@ Psid64::convert()
     {
 	block_t stil_text_block;
 	stil_text_block.load = m_stilPage << 8;
-	stil_text_block.size = 0;
-	stil_text_block.data = (uint_least8_t*)emptyString;//(uint_least8_t*) m_stilText.c_str();
+	stil_text_block.size = m_stilTextLength;
+	stil_text_block.data = m_stilText;
 	//stil_text_block.description = "STIL text";
 	//blocks.push_back(stil_text_block);
 	blocks[ nBlocks++ ] = stil_text_block;
@@ -849,85 +933,124 @@ Psid64::convertBASIC()
 }
 
 
-bool
-Psid64::formatStilText()
+// case-insensitive comparison of the first len characters of str with prefix
+static bool
+hasPrefixNoCase(const char* str, const char* prefix, unsigned int len)
 {
-/*    m_stilText.clear();
-
-    if (m_hvscRoot.empty())
+    for (unsigned int i = 0; i < len; ++i)
     {
-	return true;
+	char a = str[i];
+	char b = prefix[i];
+	if (a >= 'a' && a <= 'z') a -= 'a' - 'A';
+	if (b >= 'a' && b <= 'z') b -= 'a' - 'A';
+	if (a != b)
+	{
+	    return false;
+	}
     }
+    return true;
+}
+
 
-    // strip hvsc path from the file name
-    string hvscFileName = m_fileName;
-    size_t index = hvscFileName.find(m_hvscRoot);
-    if (index != string::npos)
+// converts backslashes in fileName to slashes (result in path, same size as
+// Psid64::m_fileName) and locates the HVSC root, which is recognized by one of
+// the HVSC top-level folders; returns the path relative to the HVSC root (in
+// path) and the STIL file of this HVSC collection, or NULL if the file is not
+// part of an HVSC collection
+static const char*
+locateStilFile(const char* fileName, char* path, char* stilFileName)
+{
+    unsigned int i = 0;
+    for (; i < 255 && fileName[i]; ++i)
     {
-	hvscFileName.erase(0, index + m_hvscRoot.length());
+	path[i] = (fileName[i] == '\\') ? '/' : fileName[i];
     }
+    path[i] = '\0';
 
-    // convert backslashes to slashes (for DOS and Windows filenames)
-    replace(hvscFileName.begin(), hvscFileName.end(), '\\', '/');
-
-    string str;
-    if (!m_stil->hasCriticalError() && m_useGlobalComment)
+    char* hvscFileName = NULL;
+    for (int f = 0; hvscFolders[f] != NULL && hvscFileName == NULL; ++f)
     {
-	char* globalComment = m_stil->getGlobalComment(hvscFileName.c_str());
-	if (globalComment != NULL)
+	unsigned int len = strlen(hvscFolders[f]);
+	for (char* p = path; *p && hvscFileName == NULL; ++p)
 	{
-	    str += globalComment;
+	    if (hasPrefixNoCase(p, hvscFolders[f], len))
+	    {
+		hvscFileName = p;
+	    }
 	}
     }
-    if (!m_stil->hasCriticalError())
+
+    if (hvscFileName != NULL)
     {
-	char* stilEntry = m_stil->getEntry(hvscFileName.c_str(), 0);
-	if (stilEntry != NULL)
-	{
-	    str += stilEntry;
-	}
+	// STIL.txt of this HVSC collection: <root>/DOCUMENTS/STIL.txt
+	unsigned int rootLength = hvscFileName - path;
+	memcpy(stilFileName, path, rootLength);
+	strcpy(stilFileName + rootLength, "/DOCUMENTS/STIL.txt");
     }
-    if (!m_stil->hasCriticalError())
+
+    return hvscFileName;
+}
+
+
+bool
+Psid64::formatStilText()
+{
+    m_stilTextLength = 0;
+
+    if (m_fileName[0] == '\0')
     {
-	char* bugEntry = m_stil->getBug(hvscFileName.c_str(), 0);
-	if (bugEntry != NULL)
-	{
-	    str += bugEntry;
-	}
+	return true;
     }
-    if (m_stil->hasCriticalError())
+
+    char fileName[sizeof(m_fileName)];
+    char stilFileName[sizeof(m_fileName) + 32];
+    const char* hvscFileName = locateStilFile(m_fileName, fileName, stilFileName);
+
+    if (hvscFileName == NULL)
     {
-	m_statusString = m_stil->getErrorStr();
-	return false;
+	return true;
     }
 
-    // convert the stil text and remove all double whitespace characters
-    unsigned int n = str.length();
-    m_stilText.reserve(n);
+    if (!stilIndex.open(stilFileName, STIL_INDEX))
+    {
+	// no STIL for this collection, not an error
+	return true;
+    }
+
+    static char str[MAX_STIL_TEXT * 2];
+    unsigned int n = 0;
+    if (m_useGlobalComment)
+    {
+	n = stilIndex.getGlobalComment(hvscFileName, str, sizeof(str));
+    }
+    n += stilIndex.getEntry(hvscFileName, str + n, sizeof(str) - n);
 
     // start the scroll text with some space characters (to separate end
     // from beginning and to make sure the color effect has reached the end
     // of the line before the first character is visible)
     for (unsigned int i = 0; i < (STIL_EOT_SPACES-1); ++i)
     {
-	m_stilText += Screen::iso2scr(' ');
+	m_stilText[m_stilTextLength++] = Screen::iso2scr(' ');
     }
 
+    // convert the stil text and remove all double whitespace characters
+    // (one byte is reserved for the end-of-text marker)
     bool space = true;
     bool realText = false;
-    for (unsigned int i = 0; i < n; ++i)
+    for (unsigned int i = 0; i < n && m_stilTextLength < MAX_STIL_TEXT - 2; ++i)
     {
-	if (isspace(str[i]))
+	char c = str[i];
+	if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f')
 	{
 	    space = true;
 	}
 	else
 	{
 	    if (space) {
-	       m_stilText += Screen::iso2scr(' ');
+	       m_stilText[m_stilTextLength++] = Screen::iso2scr(' ');
 	       space = false;
 	    }
-	    m_stilText += Screen::iso2scr(str[i]);
+	    m_stilText[m_stilTextLength++] = Screen::iso2scr(c);
 	    realText = true;
 	}
     }
@@ -936,14 +1059,14 @@ Psid64::formatStilText()
     if (realText)
     {
 	// end-of-text marker
-	m_stilText += 0xff;
+	m_stilText[m_stilTextLength++] = 0xff;
     }
     else
     {
 	// no STIL text at all
-	m_stilText.clear();
+	m_stilTextLength = 0;
     }
-*/
+
     return true;
 }
 
@@ -952,15 +1075,48 @@ bool
 Psid64::getSongLengths()
 {
     bool have_songlengths = false;
+
+    if (!songlengthsDatabaseTried)
+    {
+	songlengthsDatabaseTried = true;
+	bool opened = false;
+	for (int i = 0; !opened && songlengthsLocations[i] != NULL; ++i)
+	{
+	    opened = songlengthsDatabase.open(songlengthsLocations[i], SONGLENGTHS_INDEX) == 0;
+	}
+
+	// Songlengths.md5 may have been removed after the index has been built
+	if (!opened)
+	{
+	    songlengthsDatabase.open(NULL, SONGLENGTHS_INDEX);
+	}
+    }
+
+    // fingerprints are computed once per tune (createMD5 selects all songs internally)
+    char fileMD5[SIDTUNE_MD5_LENGTH + 1], tuneMD5[SIDTUNE_MD5_LENGTH + 1];
+    fileMD5[0] = tuneMD5[0] = '\0';
+    if (songlengthsDatabase.isOpen())
+    {
+	m_tune.createFileMD5(fileMD5);
+	m_tune.createMD5(tuneMD5);
+    }
+
     for (int i = 0; i < m_tuneInfo.songs; ++i)
     {
 	// retrieve song length database information
 	m_tune.selectSong(i + 1);
 
-	int_least32_t length = 0;
+	int_least32_t length = -1;
+	if (songlengthsDatabase.isOpen())
+	{
+	    // Songlengths.md5 of HVSC #68+ uses the MD5 of the file, older ones the tune fingerprint
+	    length = songlengthsDatabase.length(fileMD5, i + 1);
+	    if (length < 0)
+	    {
+		length = songlengthsDatabase.length(tuneMD5, i + 1);
+	    }
+	}
 
-	#if 0
-	int_least32_t length = m_database.length (m_tune);
 	if (length > 0)
 	{
 	    // maximum representable length is 99:59
@@ -996,7 +1152,6 @@ Psid64::getSongLengths()
 	    have_songlengths = true;
 	}
 	else
-	#endif
 	{
 	    // no song length data for this song
 	    m_songlengthsData[i] = 0x00;
@@ -1125,12 +1280,12 @@ Psid64::findFreeSpace()
     uint_least8_t driver;
 
     // calculate size of the STIL text in pages
-    uint_least8_t stilSize = 0;//(m_stilText.length() + 255) >> 8;
+    uint_least8_t stilSize = (m_stilTextLength + 255) >> 8;
     uint_least8_t songlengthsSize = (m_songlengthsSize + 255) >> 8;
 
 	hasCustomCharset = true;
 restartBuild:
-    stilSize = 0;//(m_stilText.length() + 255) >> 8;
+    stilSize = (m_stilTextLength + 255) >> 8;
     songlengthsSize = (m_songlengthsSize + 255) >> 8;
     startp = m_tuneInfo.relocStartPage;
     maxp = m_tuneInfo.relocPages;
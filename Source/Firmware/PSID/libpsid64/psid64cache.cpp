@@ -0,0 +1,125 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ psid64cache.cpp
+
+ Sidekick64 - A framework for interfacing 8-Bit Commodore computers (C64/C128,C16/Plus4,VC20) and a Raspberry Pi Zero 2 or 3A+/3B+
+            - cache for C64 executables converted from PSID files (PSID64)
+ Copyright (c) 2019-2022 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <circle/util.h>
+#include <circle/timer.h>
+#include "../../sdcache.h"
+#include "../psid64/psid64.h"
+
+// converted PSID files are stored in SD:C64/PSID, see sdcache.h
+#define PSID64_CACHE_FOLDER			"SD:C64/PSID"
+#define PSID64_CACHE_MAX_ENTRIES	256
+#define PSID64_CACHE_MAX_SIZE		( 8 * 1024 * 1024 )
+
+// bump when the output of Psid64::convert changes (e.g. new driver, boot code or theme)
+#define PSID64_CACHE_VERSION		1
+
+typedef struct
+{
+	u32 magic;
+	u32 sidSize;
+	u64 sidHash;
+	u64 fileNameHash;		// STIL text depends on the location within HVSC
+	u32 databaseStamp;		// song lengths and STIL file
+	u8  version, noDriver, blankScreen, compress, useGlobalComment;
+	s8  initialSong;
+} __attribute__((packed)) PSID64_CACHE_HEADER;
+
+static SDCACHE psid64Cache = SDCACHE_INIT( PSID64_CACHE_FOLDER, PSID64_CACHE_MAX_ENTRIES, PSID64_CACHE_MAX_SIZE );
+
+//
+// converts a PSID file into a C64 executable (same settings as used by the menu), or takes it from the cache
+// 'fileName' (SD card path, may be NULL) is used to retrieve STIL information, 'prg' and 'sidData' may overlap
+// returns the size of the executable or 0 on error
+//
+u32 convertPSIDCached( CLogger *logger, const char *fileName, unsigned char *sidData, u32 sidSize, unsigned char *prg, u32 prgMaxSize )
+{
+	static u8 prgCache[ 65536 + 2 ];
+
+	unsigned startTime = CTimer::GetClockTicks();
+
+	Psid64 *psid64 = new Psid64();
+
+	psid64->setVerbose( false );
+	psid64->setUseGlobalComment( false );
+	psid64->setBlankScreen( false );
+	psid64->setNoDriver( false );
+	if ( fileName )
+		psid64->setFileName( fileName );
+
+	PSID64_CACHE_HEADER header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = 0x43343650;	// "P64C"
+	header.sidSize = sidSize;
+	header.sidHash = sdCacheHash( sidData, sidSize );
+	header.fileNameHash = fileName ? sdCacheHash( fileName, strlen( fileName ) ) : 0;
+	header.databaseStamp = psid64->getDatabaseStamp();
+	header.version = PSID64_CACHE_VERSION;
+	header.noDriver = psid64->getNoDriver() ? 1 : 0;
+	header.blankScreen = psid64->getBlankScreen() ? 1 : 0;
+	header.compress = psid64->getCompress() ? 1 : 0;
+	header.useGlobalComment = psid64->getUseGlobalComment() ? 1 : 0;
+	header.initialSong = psid64->getInitialSong();
+
+	u64 h = sdCacheHash( &header, sizeof( header ) );
+	u32 key = (u32)( h ^ ( h >> 32 ) );
+
+	u32 prgSize = 0;
+	if ( sdCacheRead( logger, &psid64Cache, key, &header, sizeof( header ), prgCache, &prgSize, prgMaxSize < sizeof( prgCache ) ? prgMaxSize : sizeof( prgCache ) ) )
+	{
+		memcpy( prg, prgCache, prgSize );
+		delete psid64;
+		logger->Write( "psid64", LogNotice, "using cached executable %08x (%d bytes), %d us", key, prgSize, CTimer::GetClockTicks() - startTime );
+		return prgSize;
+	}
+
+	if ( !psid64->load( sidData, sidSize ) || !psid64->convert() )
+	{
+		logger->Write( "psid64", LogError, "conversion failed: %s", psid64->getStatus() ? psid64->getStatus() : "" );
+		delete psid64;
+		return 0;
+	}
+
+	prgSize = psid64->m_programSize;
+	if ( prgSize > prgMaxSize )
+	{
+		logger->Write( "psid64", LogError, "executable too large (%d bytes)", prgSize );
+		delete psid64;
+		return 0;
+	}
+
+	memcpy( prg, psid64->m_programData, prgSize );
+	delete psid64;
+
+	logger->Write( "psid64", LogNotice, "psid converted, prg size %d, %d us", prgSize, CTimer::GetClockTicks() - startTime );
+
+	sdCacheWrite( logger, &psid64Cache, key, &header, sizeof( header ), prg, prgSize );
+
+	return prgSize;
+}
@@ -0,0 +1,321 @@
+//
+// STIL index - fast STIL lookup for the Sidekick64 software
+// (see stilindex.h)
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+
+#include <string.h>
+#include <fatfs/ff.h>
+#include <circle/logger.h>
+
+#include "stilindex.h"
+#include "../../../mempool.h"
+
+#define STIL_DRIVE          "SD:"
+#define STIL_CHUNK_SIZE     (32 * 1024)
+#define STIL_MAX_LINE       1024
+
+static const uint32_t indexMagic   = 0x58495453; // "STIX"
+static const uint32_t indexVersion = 1;
+
+struct IndexHeader {
+    uint32_t magic, version;
+    uint32_t srcSize, srcTime;      // identify the STIL.txt the index was built from
+    uint32_t nRecords;
+};
+
+#ifndef WITH_NET
+static FATFS stilFileSystem;
+#endif
+
+static bool mountDrive()
+{
+#ifndef WITH_NET
+    return f_mount(&stilFileSystem, STIL_DRIVE, 1) == FR_OK;
+#else
+    return true;
+#endif
+}
+
+static void unmountDrive()
+{
+#ifndef WITH_NET
+    f_mount(0, STIL_DRIVE, 0);
+#endif
+}
+
+// FNV-1a, case-insensitive and independent of the path separator
+uint64_t
+StilIndex::hashPath(const char *path, uint32_t length)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (uint32_t i = 0; i < length && path[i]; i++) {
+        char c = path[i];
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        else if (c == '\\')
+            c = '/';
+        h = (h ^ (uint8_t)c) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+const StilIndex::Record *
+StilIndex::find(uint64_t hash) const
+{
+    uint32_t lo = 0, hi = nRecords;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (records[mid].hash == hash)
+            return &records[mid];
+        if (records[mid].hash < hash)
+            lo = mid + 1; else
+            hi = mid;
+    }
+    return 0;
+}
+
+StilIndex::Record *
+StilIndex::allocRecords(uint32_t n)
+{
+    if (n > poolCapacity) {
+        pool = (Record *)getPoolMemory(n * sizeof(Record));
+        poolCapacity = n;
+    }
+    return pool;
+}
+
+bool
+StilIndex::loadIndex(const char *indexFilename, uint32_t srcSize, uint32_t srcTime)
+{
+    FIL file;
+    if (f_open(&file, indexFilename, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return false;
+
+    uint32_t size = f_size(&file);
+    UINT nBytesRead;
+    IndexHeader header;
+
+    bool ok = size >= sizeof(header) &&
+              f_read(&file, &header, sizeof(header), &nBytesRead) == FR_OK && nBytesRead == sizeof(header) &&
+              header.magic == indexMagic && header.version == indexVersion &&
+              header.srcSize == srcSize && header.srcTime == srcTime &&
+              size == sizeof(header) + header.nRecords * sizeof(Record);
+
+    if (ok) {
+        uint32_t bytes = header.nRecords * sizeof(Record);
+        records = allocRecords(header.nRecords);
+        ok = f_read(&file, records, bytes, &nBytesRead) == FR_OK && nBytesRead == bytes;
+        if (ok)
+            nRecords = header.nRecords; else
+            records = 0;
+    }
+
+    f_close(&file);
+    return ok;
+}
+
+bool
+StilIndex::buildIndex(const char *filename, const char *indexFilename, uint32_t srcSize, uint32_t srcTime)
+{
+    FIL file;
+    if (f_open(&file, filename, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return false;
+
+    uint32_t capacity = 16384, n = 0;
+    Record *tmp = new Record[capacity];
+
+    char *chunk = new char[STIL_CHUNK_SIZE];
+    char line[STIL_MAX_LINE];
+    uint32_t lineLength = 0, lineStart = 0, offset = 0;
+
+    bool inEntry = false;
+    uint64_t entryHash = 0;
+    uint32_t entryStart = 0;
+
+    // 'eof' adds a final empty line which closes the last entry
+    for (bool eof = false; !eof; ) {
+        UINT nBytesRead = 0;
+        if (f_read(&file, chunk, STIL_CHUNK_SIZE, &nBytesRead) != FR_OK || nBytesRead == 0) {
+            eof = true;
+            chunk[0] = '\n';
+            nBytesRead = 1;
+        }
+
+        for (UINT i = 0; i < nBytesRead; i++, offset++) {
+            char c = chunk[i];
+            if (c != '\n') {
+                if (c != '\r' && lineLength < STIL_MAX_LINE - 1)
+                    line[lineLength++] = c;
+                continue;
+            }
+
+            // a complete line from 'lineStart' to 'offset'
+            bool emptyLine = lineLength == 0;
+            bool pathLine = lineLength > 0 && line[0] == '/';
+
+            if (inEntry && (emptyLine || pathLine)) {
+                if (n == capacity) {
+                    Record *t = new Record[capacity * 2];
+                    memcpy(t, tmp, capacity * sizeof(Record));
+                    delete[] tmp;
+                    tmp = t;
+                    capacity *= 2;
+                }
+                tmp[n].hash = entryHash;
+                tmp[n].offset = entryStart;
+                tmp[n].length = lineStart - entryStart;
+                n++;
+                inEntry = false;
+            }
+
+            if (pathLine) {
+                // strip trailing whitespace
+                while (lineLength > 0 && (line[lineLength - 1] == ' ' || line[lineLength - 1] == '\t'))
+                    lineLength--;
+                entryHash = hashPath(line, lineLength);
+                entryStart = offset + 1;
+                inEntry = true;
+            }
+
+            lineLength = 0;
+            lineStart = offset + 1;
+        }
+    }
+
+    delete[] chunk;
+    f_close(&file);
+
+    // STIL.txt is ordered by path, heap sort the records by hash
+    for (uint32_t cnt = n, i = n / 2; cnt > 1; ) {
+        Record t;
+        if (i > 0) {
+            t = tmp[--i];
+        } else {
+            t = tmp[--cnt];
+            tmp[cnt] = tmp[0];
+        }
+
+        uint32_t parent = i, child = i * 2 + 1;
+        while (child < cnt) {
+            if (child + 1 < cnt && tmp[child + 1].hash > tmp[child].hash)
+                child++;
+            if (tmp[child].hash <= t.hash)
+                break;
+            tmp[parent] = tmp[child];
+            parent = child;
+            child = parent * 2 + 1;
+        }
+        tmp[parent] = t;
+    }
+
+    // store the index for the next time
+    FIL out;
+    if (f_open(&out, indexFilename, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK) {
+        IndexHeader header = { indexMagic, indexVersion, srcSize, srcTime, n };
+        UINT nBytesWritten1 = 0, nBytesWritten2 = 0;
+        f_write(&out, &header, sizeof(header), &nBytesWritten1);
+        f_write(&out, tmp, n * sizeof(Record), &nBytesWritten2);
+        f_close(&out);
+        if (nBytesWritten1 != sizeof(header) || nBytesWritten2 != n * sizeof(Record))
+            CLogger::Get()->Write("stil", LogWarning, "Cannot write index: %s", indexFilename);
+    }
+
+    records = allocRecords(n);
+    memcpy(records, tmp, n * sizeof(Record));
+    nRecords = n;
+    delete[] tmp;
+
+    return true;
+}
+
+bool
+StilIndex::open(const char *filename, const char *indexFilename)
+{
+    if (isOpen() && strcmp(filename, stilFilename) == 0)
+        return true;
+
+    records = 0;
+    nRecords = 0;
+    stilFilename[0] = 0;
+
+    if (!mountDrive())
+        return false;
+
+    bool ok = false;
+    FILINFO info;
+    if (f_stat(filename, &info) == FR_OK) {
+        uint32_t srcSize = (uint32_t)info.fsize;
+        uint32_t srcTime = ((uint32_t)info.fdate << 16) | info.ftime;
+
+        ok = loadIndex(indexFilename, srcSize, srcTime);
+        if (!ok) {
+            CLogger::Get()->Write("stil", LogNotice, "building STIL index from %s", filename);
+            ok = buildIndex(filename, indexFilename, srcSize, srcTime);
+        }
+    }
+
+    unmountDrive();
+
+    if (ok) {
+        strncpy(stilFilename, filename, sizeof(stilFilename) - 1);
+        stilFilename[sizeof(stilFilename) - 1] = 0;
+        CLogger::Get()->Write("stil", LogNotice, "STIL index: %u entries", nRecords);
+    }
+
+    return ok;
+}
+
+uint32_t
+StilIndex::readText(const Record *r, char *buf, uint32_t maxLen)
+{
+    if (!r || maxLen == 0 || !mountDrive())
+        return 0;
+
+    uint32_t length = r->length < maxLen - 1 ? r->length : maxLen - 1;
+    UINT nBytesRead = 0;
+
+    FIL file;
+    if (f_open(&file, stilFilename, FA_READ | FA_OPEN_EXISTING) == FR_OK) {
+        if (f_lseek(&file, r->offset) != FR_OK ||
+            f_read(&file, buf, length, &nBytesRead) != FR_OK)
+            nBytesRead = 0;
+        f_close(&file);
+    }
+
+    unmountDrive();
+
+    buf[nBytesRead] = 0;
+    return nBytesRead;
+}
+
+uint32_t
+StilIndex::getEntry(const char *relPathToEntry, char *buf, uint32_t maxLen)
+{
+    if (!isOpen())
+        return 0;
+
+    return readText(find(hashPath(relPathToEntry, strlen(relPathToEntry))), buf, maxLen);
+}
+
+uint32_t
+StilIndex::getGlobalComment(const char *relPathToEntry, char *buf, uint32_t maxLen)
+{
+    if (!isOpen())
+        return 0;
+
+    // the section-global comment is stored under the directory name including the last slash
+    int32_t last = -1;
+    for (int32_t i = 0; relPathToEntry[i]; i++)
+        if (relPathToEntry[i] == '/' || relPathToEntry[i] == '\\')
+            last = i;
+
+    if (last < 0)
+        return 0;
+
+    return readText(find(hashPath(relPathToEntry, last + 1)), buf, maxLen);
+}
@@ -0,0 +1,63 @@
+//
+// STIL index - fast STIL lookup for the Sidekick64 software
+//
+// Instead of scanning STIL.txt section by section (see stil.cpp, which
+// requires iostreams and is not used here), an index is built once:
+// for every entry (file or section-global comment, i.e. paths ending with
+// a slash) it stores a hash of the HVSC path together with the offset and
+// length of the entry text in STIL.txt. The index is saved on SD, loaded
+// into the memory pool and searched with a binary search; only the text of
+// the requested entry is then read from STIL.txt.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+
+#ifndef _STILINDEX_H
+#define _STILINDEX_H
+
+#include <stdint.h>
+
+class StilIndex {
+
+    public:
+        StilIndex() : records(0), nRecords(0), pool(0), poolCapacity(0) { stilFilename[0] = 0; }
+
+        // opens (and if required builds) the index 'indexFilename' for 'filename' (STIL.txt);
+        // the index is rebuilt whenever size or timestamp of STIL.txt changed
+        bool open(const char *filename, const char *indexFilename);
+
+        bool isOpen() const { return records != 0; }
+        const char *getFilename() const { return stilFilename; }
+
+        // copies the STIL entry for 'relPathToEntry' (relative to the HVSC base dir, starting with
+        // a slash) into 'buf' (zero terminated), returns the length or 0 if there is no entry
+        uint32_t getEntry(const char *relPathToEntry, char *buf, uint32_t maxLen);
+
+        // same for the section-global comment of the directory containing 'relPathToEntry'
+        uint32_t getGlobalComment(const char *relPathToEntry, char *buf, uint32_t maxLen);
+
+    private:
+        struct Record {
+            uint64_t hash;
+            uint32_t offset;
+            uint32_t length;
+        } __attribute__((packed));
+
+        Record *records;
+        uint32_t nRecords;
+        Record *pool;               // pool memory can't be freed: reused for the next index if it fits
+        uint32_t poolCapacity;
+        char stilFilename[256];
+
+        Record *allocRecords(uint32_t n);
+        static uint64_t hashPath(const char *path, uint32_t length);
+        const Record *find(uint64_t hash) const;
+        uint32_t readText(const Record *r, char *buf, uint32_t maxLen);
+        bool loadIndex(const char *indexFilename, uint32_t srcSize, uint32_t srcTime);
+        bool buildIndex(const char *filename, const char *indexFilename, uint32_t srcSize, uint32_t srcTime);
+};
+
+#endif // _STILINDEX_H
@@ -95,6 +95,21 @@ public:
         return m_hvscRoot;
     }*/
 
+    /**
+     * Set the file name of the PSID file (as on the SD card). If the file is
+     * part of an HVSC collection, it is used to retrieve the STIL information
+     * from DOCUMENTS/STIL.txt of this collection.
+     */
+    void setFileName(const char* fileName);
+
+    /**
+     * Get a stamp of the song length database and the STIL file which are
+     * used to convert the current file (size and modification time of these
+     * files). It changes whenever one of them is replaced, e.g. to tell
+     * whether a previously converted executable is still up to date.
+     */
+    uint_least32_t getDatabaseStamp();
+
     /**
      * Set the path to the HVSC song length database.
      */
@@ -316,7 +331,7 @@ private:
     const char* m_statusString;   // error/status message of last operation
 
     // other internal data
-    //std::string m_fileName;
+    char m_fileName[256];
     SidTuneMod m_tune;
     SidTuneInfo m_tuneInfo;
     //SidDatabase m_database;
@@ -325,7 +340,9 @@ private:
 
     // conversion data
     Screen *m_screen;
-    //std::string m_stilText;
+    static const unsigned int MAX_STIL_TEXT = 0x1000;
+    uint_least8_t m_stilText[MAX_STIL_TEXT];
+    unsigned int m_stilTextLength;
     uint_least8_t m_songlengthsData[4 * SIDTUNE_MAX_SONGS];
     size_t m_songlengthsSize;
     uint_least8_t m_driverPage; // startpage of driver, 0 means no driver
@@ -0,0 +1,48 @@
+/*
+ * Compact MD5 message-digest implementation (RFC 1321), used to compute the
+ * fingerprints of SID tunes for the HVSC song-length database.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef MD5_H
+#define MD5_H
+
+#include "../sidint.h"
+
+#define MD5_DIGEST_LENGTH 16
+
+class MD5
+{
+ public:
+    MD5() { reset(); }
+
+    void reset();
+    void append(const void* data, uint_least32_t nbytes);
+    void finish();
+
+    // valid after finish()
+    const uint_least8_t* getDigest() const { return digest; }
+
+ private:
+    void process(const uint_least8_t* block);
+
+    uint_least32_t state[4];
+    uint_least32_t countLo, countHi;   // number of bytes processed
+    uint_least8_t buffer[64];
+    uint_least8_t digest[MD5_DIGEST_LENGTH];
+};
+
+#endif  /* MD5_H */
@@ -15,33 +15,55 @@
  *                                                                         *
  ***************************************************************************/
 
+/*
+	this code has been modified for integration into the Sidekick64 software:
+	instead of parsing the INI-style Songlengths.md5 on every lookup, a compact
+	index (sorted MD5 -> list of song lengths) is built once, stored on SD next
+	to the other Sidekick files and kept in memory. Lookups are binary searches.
+*/
+
 #ifndef _siddatabase_h_
 #define _siddatabase_h_
 
 #include "SidTuneMod.h"
-#include "libini.h"
 
 class SID_EXTERN SidDatabase
 {
 private:
     static const char *ERR_DATABASE_CORRUPT;
     static const char *ERR_NO_DATABASE_LOADED;
-    static const char *ERR_NO_SELECTED_SONG;
     static const char *ERR_MEM_ALLOC;
     static const char *ERR_UNABLE_TO_LOAD_DATABASE;
 
-    ini_fd_t    database;
-    const char *errorString;
+    struct Record
+    {
+        uint_least8_t md5[16];
+        uint_least32_t ofs;             // into 'pool': number of songs, followed by their lengths in seconds
+    } __attribute__((packed));
+
+    uint_least8_t  *indexData;          // index file as loaded/built: header, records, pool
+    Record         *records;
+    uint_least16_t *pool;
+    uint_least32_t  nRecords;
+    uint_least32_t  nPool;
+    const char     *errorString;
 
-    int_least32_t parseTimeStamp (const char* arg);
-    uint_least8_t timesFound     (char *str);
+    bool loadIndex  (const char *indexFilename, uint_least32_t srcSize, uint_least32_t srcTime);
+    bool buildIndex (const char *filename, const char *indexFilename, uint_least32_t srcSize, uint_least32_t srcTime);
+    const Record *find (const char *md5) const;
 
 public:
-    SidDatabase  () : database (0), errorString(NULL) {;}
+    SidDatabase  () : indexData (0), records (0), pool (0), nRecords (0), nPool (0), errorString (0) {;}
     ~SidDatabase ();
 
-    int           open   (const char *filename);
+    // 'filename' is the HVSC Songlengths.md5, the binary index is stored in 'indexFilename'
+    // and rebuilt whenever Songlengths.md5 changed (size or timestamp);
+    // with 'filename' == 0 an existing index is used as is
+    int           open   (const char *filename, const char *indexFilename);
     void          close  ();
+    bool          isOpen () const { return indexData != 0; }
+
+    // length in seconds of the selected song, -1 if unknown
     int_least32_t length (SidTuneMod &tune);
     int_least32_t length (const char *md5, uint_least16_t song);
     const char *  error  (void) { return errorString; }
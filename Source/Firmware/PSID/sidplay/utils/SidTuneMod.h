@@ -34,6 +34,10 @@ class SID_EXTERN SidTuneMod : public SidTune
 
     // Not providing an md5 buffer will cause the internal one to be used
     const char *createMD5(char *md5 = 0); // Buffer must be SIDTUNE_MD5_LENGTH + 1
+
+    // MD5 of the complete file as used by Songlengths.md5 since HVSC #68
+    // (createMD5 computes the older fingerprint of data, addresses and speed flags)
+    const char *createFileMD5(char *md5 = 0); // Buffer must be SIDTUNE_MD5_LENGTH + 1
 };
 
 #endif  /* SIDTUNEMOD_H */
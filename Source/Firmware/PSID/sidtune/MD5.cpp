@@ -0,0 +1,155 @@
+/*
+ * Compact MD5 message-digest implementation (RFC 1321), used to compute the
+ * fingerprints of SID tunes for the HVSC song-length database.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+
+#include "../sidplay/utils/MD5.h"
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define STEP(f, a, b, c, d, x, t, s) \
+    (a) += f((b), (c), (d)) + (x) + (t); \
+    (a) = ROTL((a), (s)) + (b);
+
+void MD5::reset()
+{
+    state[0] = 0x67452301;
+    state[1] = 0xefcdab89;
+    state[2] = 0x98badcfe;
+    state[3] = 0x10325476;
+    countLo = countHi = 0;
+}
+
+void MD5::process(const uint_least8_t* block)
+{
+    uint_least32_t x[16];
+    for (int i = 0; i < 16; i++)
+    {
+        x[i] = (uint_least32_t)block[i * 4] |
+               ((uint_least32_t)block[i * 4 + 1] << 8) |
+               ((uint_least32_t)block[i * 4 + 2] << 16) |
+               ((uint_least32_t)block[i * 4 + 3] << 24);
+    }
+
+    uint_least32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+    STEP(F, a, b, c, d, x[ 0], 0xd76aa478,  7) STEP(F, d, a, b, c, x[ 1], 0xe8c7b756, 12)
+    STEP(F, c, d, a, b, x[ 2], 0x242070db, 17) STEP(F, b, c, d, a, x[ 3], 0xc1bdceee, 22)
+    STEP(F, a, b, c, d, x[ 4], 0xf57c0faf,  7) STEP(F, d, a, b, c, x[ 5], 0x4787c62a, 12)
+    STEP(F, c, d, a, b, x[ 6], 0xa8304613, 17) STEP(F, b, c, d, a, x[ 7], 0xfd469501, 22)
+    STEP(F, a, b, c, d, x[ 8], 0x698098d8,  7) STEP(F, d, a, b, c, x[ 9], 0x8b44f7af, 12)
+    STEP(F, c, d, a, b, x[10], 0xffff5bb1, 17) STEP(F, b, c, d, a, x[11], 0x895cd7be, 22)
+    STEP(F, a, b, c, d, x[12], 0x6b901122,  7) STEP(F, d, a, b, c, x[13], 0xfd987193, 12)
+    STEP(F, c, d, a, b, x[14], 0xa679438e, 17) STEP(F, b, c, d, a, x[15], 0x49b40821, 22)
+
+    STEP(G, a, b, c, d, x[ 1], 0xf61e2562,  5) STEP(G, d, a, b, c, x[ 6], 0xc040b340,  9)
+    STEP(G, c, d, a, b, x[11], 0x265e5a51, 14) STEP(G, b, c, d, a, x[ 0], 0xe9b6c7aa, 20)
+    STEP(G, a, b, c, d, x[ 5], 0xd62f105d,  5) STEP(G, d, a, b, c, x[10], 0x02441453,  9)
+    STEP(G, c, d, a, b, x[15], 0xd8a1e681, 14) STEP(G, b, c, d, a, x[ 4], 0xe7d3fbc8, 20)
+    STEP(G, a, b, c, d, x[ 9], 0x21e1cde6,  5) STEP(G, d, a, b, c, x[14], 0xc33707d6,  9)
+    STEP(G, c, d, a, b, x[ 3], 0xf4d50d87, 14) STEP(G, b, c, d, a, x[ 8], 0x455a14ed, 20)
+    STEP(G, a, b, c, d, x[13], 0xa9e3e905,  5) STEP(G, d, a, b, c, x[ 2], 0xfcefa3f8,  9)
+    STEP(G, c, d, a, b, x[ 7], 0x676f02d9, 14) STEP(G, b, c, d, a, x[12], 0x8d2a4c8a, 20)
+
+    STEP(H, a, b, c, d, x[ 5], 0xfffa3942,  4) STEP(H, d, a, b, c, x[ 8], 0x8771f681, 11)
+    STEP(H, c, d, a, b, x[11], 0x6d9d6122, 16) STEP(H, b, c, d, a, x[14], 0xfde5380c, 23)
+    STEP(H, a, b, c, d, x[ 1], 0xa4beea44,  4) STEP(H, d, a, b, c, x[ 4], 0x4bdecfa9, 11)
+    STEP(H, c, d, a, b, x[ 7], 0xf6bb4b60, 16) STEP(H, b, c, d, a, x[10], 0xbebfbc70, 23)
+    STEP(H, a, b, c, d, x[13], 0x289b7ec6,  4) STEP(H, d, a, b, c, x[ 0], 0xeaa127fa, 11)
+    STEP(H, c, d, a, b, x[ 3], 0xd4ef3085, 16) STEP(H, b, c, d, a, x[ 6], 0x04881d05, 23)
+    STEP(H, a, b, c, d, x[ 9], 0xd9d4d039,  4) STEP(H, d, a, b, c, x[12], 0xe6db99e5, 11)
+    STEP(H, c, d, a, b, x[15], 0x1fa27cf8, 16) STEP(H, b, c, d, a, x[ 2], 0xc4ac5665, 23)
+
+    STEP(I, a, b, c, d, x[ 0], 0xf4292244,  6) STEP(I, d, a, b, c, x[ 7], 0x432aff97, 10)
+    STEP(I, c, d, a, b, x[14], 0xab9423a7, 15) STEP(I, b, c, d, a, x[ 5], 0xfc93a039, 21)
+    STEP(I, a, b, c, d, x[12], 0x655b59c3,  6) STEP(I, d, a, b, c, x[ 3], 0x8f0ccc92, 10)
+    STEP(I, c, d, a, b, x[10], 0xffeff47d, 15) STEP(I, b, c, d, a, x[ 1], 0x85845dd1, 21)
+    STEP(I, a, b, c, d, x[ 8], 0x6fa87e4f,  6) STEP(I, d, a, b, c, x[15], 0xfe2ce6e0, 10)
+    STEP(I, c, d, a, b, x[ 6], 0xa3014314, 15) STEP(I, b, c, d, a, x[13], 0x4e0811a1, 21)
+    STEP(I, a, b, c, d, x[ 4], 0xf7537e82,  6) STEP(I, d, a, b, c, x[11], 0xbd3af235, 10)
+    STEP(I, c, d, a, b, x[ 2], 0x2ad7d2bb, 15) STEP(I, b, c, d, a, x[ 9], 0xeb86d391, 21)
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+void MD5::append(const void* data, uint_least32_t nbytes)
+{
+    const uint_least8_t* p = (const uint_least8_t*)data;
+    uint_least32_t used = countLo & 63;
+
+    if ((countLo += nbytes) < nbytes)
+        countHi++;
+
+    if (used)
+    {
+        uint_least32_t avail = 64 - used;
+        if (nbytes < avail)
+        {
+            memcpy(buffer + used, p, nbytes);
+            return;
+        }
+        memcpy(buffer + used, p, avail);
+        process(buffer);
+        p += avail;
+        nbytes -= avail;
+    }
+
+    while (nbytes >= 64)
+    {
+        process(p);
+        p += 64;
+        nbytes -= 64;
+    }
+
+    memcpy(buffer, p, nbytes);
+}
+
+void MD5::finish()
+{
+    uint_least32_t used = countLo & 63;
+    uint_least32_t bitsLo = countLo << 3;
+    uint_least32_t bitsHi = (countHi << 3) | (countLo >> 29);
+
+    buffer[used++] = 0x80;
+    if (used > 56)
+    {
+        memset(buffer + used, 0, 64 - used);
+        process(buffer);
+        used = 0;
+    }
+    memset(buffer + used, 0, 56 - used);
+
+    for (int i = 0; i < 4; i++)
+    {
+        buffer[56 + i] = (uint_least8_t)(bitsLo >> (8 * i));
+        buffer[60 + i] = (uint_least8_t)(bitsHi >> (8 * i));
+    }
+    process(buffer);
+
+    for (int i = 0; i < 16; i++)
+        digest[i] = (uint_least8_t)(state[i >> 2] >> (8 * (i & 3)));
+}
@@ -0,0 +1,405 @@
+/***************************************************************************
+                          SidDatabase.cpp  -  songlength database support
+                             -------------------
+    begin                : Sun Mar 11 2001
+    copyright            : (C) 2001 by Simon White
+    email                : s_a_white@email.com
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+/*
+	this code has been modified for integration into the Sidekick64 software,
+	see SidDatabase.h
+*/
+
+#include <string.h>
+#include <fatfs/ff.h>
+#include <circle/logger.h>
+
+#include "../config.h"
+#include "../sidplay/utils/SidDatabase.h"
+
+#define DB_DRIVE        "SD:"
+
+static const uint_least32_t indexMagic   = 0x42444c53; // "SLDB"
+static const uint_least32_t indexVersion = 1;
+
+struct IndexHeader
+{
+    uint_least32_t magic, version;
+    uint_least32_t srcSize, srcTime;    // identify the Songlengths.md5 the index was built from
+    uint_least32_t nRecords, nPool;
+};
+
+const char *SidDatabase::ERR_DATABASE_CORRUPT        = "SID DATABASE ERROR: Database seems to be corrupt.";
+const char *SidDatabase::ERR_NO_DATABASE_LOADED      = "SID DATABASE ERROR: Songlength database not loaded.";
+const char *SidDatabase::ERR_MEM_ALLOC               = "SID DATABASE ERROR: Memory Allocation Failure.";
+const char *SidDatabase::ERR_UNABLE_TO_LOAD_DATABASE = "SID DATABASE ERROR: Unable to load the songlegnth database.";
+
+#ifndef WITH_NET
+static FATFS dbFileSystem;
+#endif
+
+static bool mountDrive()
+{
+#ifndef WITH_NET
+    return f_mount(&dbFileSystem, DB_DRIVE, 1) == FR_OK;
+#else
+    return true;
+#endif
+}
+
+static void unmountDrive()
+{
+#ifndef WITH_NET
+    f_mount(0, DB_DRIVE, 0);
+#endif
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool parseMD5(const char *str, uint_least8_t *md5)
+{
+    for (int i = 0; i < 16; i++)
+    {
+        int hi = hexDigit(str[i * 2]), lo = hexDigit(str[i * 2 + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        md5[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
+// parses "m:ss", "m:ss.mmm" (HVSC #68+) or "m:ss(G)" (older releases), rounds to seconds
+// and advances 'p' behind the time stamp; returns -1 if there is no time stamp
+static int_least32_t parseTimeStamp(const char *&p, const char *end)
+{
+    while (p < end && *p == ' ')
+        p++;
+
+    int_least32_t minutes = 0, seconds = 0, millis = 0, digits = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        minutes = minutes * 10 + (*p++ - '0'), digits++;
+    if (!digits || p >= end || *p != ':')
+        return -1;
+    p++;
+
+    digits = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        seconds = seconds * 10 + (*p++ - '0'), digits++;
+    if (!digits)
+        return -1;
+
+    if (p < end && *p == '.')
+    {
+        int_least32_t scale = 100;
+        p++;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            millis += (*p++ - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    // skip attributes
+    if (p < end && *p == '(')
+        while (p < end && *p++ != ')');
+
+    return minutes * 60 + seconds + (millis >= 500 ? 1 : 0);
+}
+
+static inline int compareRecords(const uint_least8_t *a, const uint_least8_t *b)
+{
+    return memcmp(a, b, 16);
+}
+
+SidDatabase::~SidDatabase ()
+{
+    close();
+}
+
+void SidDatabase::close ()
+{
+    delete[] indexData;
+    indexData = 0;
+    records = 0;
+    pool = 0;
+    nRecords = nPool = 0;
+}
+
+bool SidDatabase::loadIndex (const char *indexFilename, uint_least32_t srcSize, uint_least32_t srcTime)
+{
+    FIL file;
+    if (f_open(&file, indexFilename, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+        return false;
+
+    uint_least32_t size = f_size(&file);
+    UINT nBytesRead;
+    IndexHeader header;
+
+    bool ok = size >= sizeof(header) &&
+              f_read(&file, &header, sizeof(header), &nBytesRead) == FR_OK && nBytesRead == sizeof(header) &&
+              header.magic == indexMagic && header.version == indexVersion &&
+              // srcSize == 0: Songlengths.md5 not present, use whatever index we have
+              (srcSize == 0 || (header.srcSize == srcSize && header.srcTime == srcTime)) &&
+              size == sizeof(header) + header.nRecords * sizeof(Record) + header.nPool * sizeof(uint_least16_t);
+
+    if (ok)
+    {
+        indexData = new uint_least8_t[size];
+        memcpy(indexData, &header, sizeof(header));
+        ok = f_read(&file, indexData + sizeof(header), size - sizeof(header), &nBytesRead) == FR_OK &&
+             nBytesRead == size - sizeof(header);
+        if (ok)
+        {
+            nRecords = header.nRecords;
+            nPool = header.nPool;
+            records = (Record *)(indexData + sizeof(header));
+            pool = (uint_least16_t *)(indexData + sizeof(header) + nRecords * sizeof(Record));
+        } else
+        {
+            errorString = ERR_DATABASE_CORRUPT;
+            close();
+        }
+    }
+
+    f_close(&file);
+    return ok;
+}
+
+bool SidDatabase::buildIndex (const char *filename, const char *indexFilename, uint_least32_t srcSize, uint_least32_t srcTime)
+{
+    FIL file;
+    if (f_open(&file, filename, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+    {
+        errorString = ERR_UNABLE_TO_LOAD_DATABASE;
+        return false;
+    }
+
+    char *text = new char[srcSize];
+    UINT nBytesRead;
+    bool ok = f_read(&file, text, srcSize, &nBytesRead) == FR_OK && nBytesRead == srcSize;
+    f_close(&file);
+
+    if (!ok)
+    {
+        delete[] text;
+        errorString = ERR_UNABLE_TO_LOAD_DATABASE;
+        return false;
+    }
+
+    const char *end = text + srcSize;
+
+    // first pass: count tunes and song lengths, second pass: fill records and pool
+    uint_least32_t nTunes = 0, nSongs = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        uint_least32_t r = 0, o = 0;
+        const char *p = text;
+        while (p < end)
+        {
+            const char *eol = p;
+            while (eol < end && *eol != '\n' && *eol != '\r')
+                eol++;
+
+            uint_least8_t md5[16];
+            if (eol - p > 33 && p[32] == '=' && parseMD5(p, md5))
+            {
+                const char *t = p + 33;
+                uint_least32_t first = o;
+                if (pass)
+                {
+                    memcpy(records[r].md5, md5, 16);
+                    records[r].ofs = o;
+                }
+                o++;    // number of songs
+
+                int_least32_t length;
+                while ((length = parseTimeStamp(t, eol)) >= 0)
+                {
+                    if (pass)
+                        pool[o] = length > 0xffff ? 0xffff : length;
+                    o++;
+                }
+
+                if (pass)
+                    pool[first] = o - first - 1;
+                r++;
+            }
+
+            p = eol + 1;
+        }
+
+        if (pass == 0)
+        {
+            nTunes = r;
+            nSongs = o;
+
+            uint_least32_t size = sizeof(IndexHeader) + nTunes * sizeof(Record) + nSongs * sizeof(uint_least16_t);
+            indexData = new uint_least8_t[size];
+            IndexHeader *header = (IndexHeader *)indexData;
+            header->magic = indexMagic;
+            header->version = indexVersion;
+            header->srcSize = srcSize;
+            header->srcTime = srcTime;
+            header->nRecords = nTunes;
+            header->nPool = nSongs;
+            records = (Record *)(indexData + sizeof(IndexHeader));
+            pool = (uint_least16_t *)(indexData + sizeof(IndexHeader) + nTunes * sizeof(Record));
+        }
+    }
+
+    delete[] text;
+
+    nRecords = nTunes;
+    nPool = nSongs;
+
+    // heap sort records by MD5 (Songlengths.md5 is ordered by path)
+    Record tmp;
+    for (uint_least32_t n = nRecords, i = nRecords / 2; n > 1; )
+    {
+        if (i > 0)
+        {
+            tmp = records[--i];
+        } else
+        {
+            tmp = records[--n];
+            records[n] = records[0];
+        }
+
+        uint_least32_t parent = i, child = i * 2 + 1;
+        while (child < n)
+        {
+            if (child + 1 < n && compareRecords(records[child + 1].md5, records[child].md5) > 0)
+                child++;
+            if (compareRecords(records[child].md5, tmp.md5) <= 0)
+                break;
+            records[parent] = records[child];
+            parent = child;
+            child = parent * 2 + 1;
+        }
+        records[parent] = tmp;
+    }
+
+    // store the index for the next time
+    FIL out;
+    if (f_open(&out, indexFilename, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK)
+    {
+        UINT nBytesWritten;
+        uint_least32_t size = sizeof(IndexHeader) + nRecords * sizeof(Record) + nPool * sizeof(uint_least16_t);
+        if (f_write(&out, indexData, size, &nBytesWritten) != FR_OK || nBytesWritten != size)
+            CLogger::Get()->Write("songlengths", LogWarning, "Cannot write index: %s", indexFilename);
+        f_close(&out);
+    }
+
+    return true;
+}
+
+int SidDatabase::open (const char *filename, const char *indexFilename)
+{
+    close();
+
+    if (!mountDrive())
+    {
+        errorString = ERR_UNABLE_TO_LOAD_DATABASE;
+        return -1;
+    }
+
+    uint_least32_t srcSize = 0, srcTime = 0;
+    if (filename)
+    {
+        FILINFO info;
+        if (f_stat(filename, &info) != FR_OK || info.fsize == 0)
+        {
+            unmountDrive();
+            errorString = ERR_UNABLE_TO_LOAD_DATABASE;
+            return -1;
+        }
+        srcSize = (uint_least32_t)info.fsize;
+        srcTime = ((uint_least32_t)info.fdate << 16) | info.ftime;
+    }
+
+    bool ok = loadIndex(indexFilename, srcSize, srcTime);
+    if (!ok && filename)
+    {
+        CLogger::Get()->Write("songlengths", LogNotice, "building song-length index from %s", filename);
+        ok = buildIndex(filename, indexFilename, srcSize, srcTime);
+    }
+
+    unmountDrive();
+
+    if (!ok)
+    {
+        close();
+        if (!errorString)
+            errorString = ERR_NO_DATABASE_LOADED;
+        return -1;
+    }
+
+    CLogger::Get()->Write("songlengths", LogNotice, "song-length database: %u tunes", nRecords);
+    return 0;
+}
+
+const SidDatabase::Record *SidDatabase::find (const char *md5) const
+{
+    uint_least8_t key[16];
+    if (!parseMD5(md5, key))
+        return 0;
+
+    uint_least32_t lo = 0, hi = nRecords;
+    while (lo < hi)
+    {
+        uint_least32_t mid = (lo + hi) / 2;
+        int c = compareRecords(records[mid].md5, key);
+        if (c == 0)
+            return &records[mid];
+        if (c < 0)
+            lo = mid + 1; else
+            hi = mid;
+    }
+    return 0;
+}
+
+int_least32_t SidDatabase::length (const char *md5, uint_least16_t song)
+{
+    if (!isOpen())
+    {
+        errorString = ERR_NO_DATABASE_LOADED;
+        return -1;
+    }
+
+    const Record *r = find(md5);
+    if (!r || r->ofs >= nPool)
+        return -1;
+
+    uint_least16_t nSongs = pool[r->ofs];
+    if (song < 1 || song > nSongs || r->ofs + song >= nPool)
+        return -1;
+
+    return pool[r->ofs + song];
+}
+
+int_least32_t SidDatabase::length (SidTuneMod &tune)
+{
+    const uint_least16_t song = tune.getInfo().currentSong;
+
+    char md5[SIDTUNE_MD5_LENGTH + 1];
+    int_least32_t l = length(tune.createFileMD5(md5), song);
+    if (l < 0)
+        l = length(tune.createMD5(md5), song);
+    return l;
+}
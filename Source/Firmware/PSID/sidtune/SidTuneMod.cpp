@@ -0,0 +1,96 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../config.h"
+#include "../sidplay/utils/SidTuneMod.h"
+#include "../sidplay/utils/MD5.h"
+#include "../sidplay/sidendian.h"
+
+static void digestToString(const uint_least8_t* digest, char* md5)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < MD5_DIGEST_LENGTH; i++)
+    {
+        md5[i * 2] = hex[digest[i] >> 4];
+        md5[i * 2 + 1] = hex[digest[i] & 15];
+    }
+    md5[SIDTUNE_MD5_LENGTH] = '\0';
+}
+
+const char *SidTuneMod::createMD5(char *md5)
+{
+    if (!md5)
+        md5 = m_md5;
+    *md5 = '\0';
+
+    if (status)
+    {
+        // Include C64 data.
+        MD5 myMD5;
+        myMD5.append(cache.get() + fileOffset, info.c64dataLen);
+
+        uint_least8_t tmp[2];
+        endian_little16(tmp, info.initAddr);
+        myMD5.append(tmp, sizeof(tmp));
+        endian_little16(tmp, info.playAddr);
+        myMD5.append(tmp, sizeof(tmp));
+        endian_little16(tmp, info.songs);
+        myMD5.append(tmp, sizeof(tmp));
+
+        {   // Include song speed for each song.
+            uint_least16_t currentSong = info.currentSong;
+            for (uint_least16_t s = 1; s <= info.songs; s++)
+            {
+                selectSong(s);
+                myMD5.append(&info.songSpeed, sizeof(info.songSpeed));
+            }
+            // Restore old song
+            selectSong(currentSong);
+        }
+
+        // Deal with PSID v2NG clock speed flags: Let only NTSC
+        // clock speed change the MD5 fingerprint. That way the
+        // fingerprint of a PAL-speed sidtune in PSID v1, v2, and
+        // PSID v2NG format is the same.
+        if (info.clockSpeed == SIDTUNE_CLOCK_NTSC)
+            myMD5.append(&info.clockSpeed, sizeof(info.clockSpeed));
+
+        myMD5.finish();
+        digestToString(myMD5.getDigest(), md5);
+    }
+
+    return md5;
+}
+
+const char *SidTuneMod::createFileMD5(char *md5)
+{
+    if (!md5)
+        md5 = m_md5;
+    *md5 = '\0';
+
+    if (status)
+    {
+        MD5 myMD5;
+        myMD5.append(cache.get(), cache.len());
+        myMD5.finish();
+        digestToString(myMD5.getDigest(), md5);
+    }
+
+    return md5;
+}
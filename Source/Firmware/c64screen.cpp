@@ -214,7 +214,7 @@ int convChar( char c, u32 convert )
 	return c2;
 }
 
-void printC64( u32 x, u32 y, const char *t, u8 color, u8 flag, u32 convert, u32 maxL )
+static void printC64To( u8 *screen, u8 *colorRAM, u32 x, u32 y, const char *t, u8 color, u8 flag, u32 convert, u32 maxL )
 {
 	u32 l = minsk( strlen( t ), maxL );
 
@@ -240,11 +240,16 @@ void printC64( u32 x, u32 y, const char *t, u8 color, u8 flag, u32 convert, u32
 				c2 = 100;
 		}
 
-		c64screen[ x + y * 40 + i ] = c2 | flag;
-		c64color[ x + y * 40 + i ] = color;
+		screen[ x + y * 40 + i ] = c2 | flag;
+		colorRAM[ x + y * 40 + i ] = color;
 	}
 }
 
+void printC64( u32 x, u32 y, const char *t, u8 color, u8 flag, u32 convert, u32 maxL )
+{
+	printC64To( c64screen, c64color, x, y, t, color, flag, convert, maxL );
+}
+
 
 int scanFileTree( u32 cursorPos, u32 scrollPos )
 {
@@ -1357,7 +1362,7 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 		if ( typeInName == 0 && ( k == VK_MOUNT || k == VK_MOUNT_START ) && dir[ cursorPos ].f & DIR_D64_FILE )
 		{
 			typeInName = 0;
-			extern int createD2EF( unsigned char *diskimage, int imageSize, unsigned char *cart, int build, int mode, int autostart );
+			extern int createD2EFCached( CLogger *logger, unsigned char *diskimage, int imageSize, unsigned char *cart, u32 cartMaxSize, int build, int mode, int autostart );
 
 			unsigned char *cart = new unsigned char[ 1024 * 1027 ];
 			unsigned char *diskimage = new unsigned char[ 1024 * 1024 ];
@@ -1390,7 +1395,7 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 			{
 				//logger->Write( "d2ef", LogNotice, "loaded %d bytes D64", diSize );
 
-				crtSize = createD2EF( diskimage, diSize, cart, 2, 0, autostart );
+				crtSize = createD2EFCached( logger, diskimage, diSize, cart, 1024 * 1027, 2, 0, autostart );
 
 				//logger->Write( "d2ef", LogNotice, "loaded %d bytes D64", diSize );
 
@@ -1789,30 +1794,11 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 						else
 							logger->Write( "exec", LogError, "could not load sid '%s'", path );
 
-						Psid64 *psid64 = new Psid64();
+						extern u32 convertPSIDCached( CLogger *logger, const char *fileName, unsigned char *sidData, u32 sidSize, unsigned char *prg, u32 prgMaxSize );
+						prgSizeLaunch = convertPSIDCached( logger, path, sidData, sidSize, prgDataLaunch, 65536 + 2 );
 
-						psid64->setVerbose(false);
-						psid64->setUseGlobalComment(false);
-						psid64->setBlankScreen(false);
-						psid64->setNoDriver(false);
-						if ( !psid64->load( sidData, sidSize ) )
-						{
-							//return false;
-						}
-						logger->Write( "exec", LogNotice, "psid loaded" );
-
-						// convert the PSID file
-						if ( !psid64->convert() ) 
-						{
-							//return false;
-						}
-						logger->Write( "exec", LogNotice, "psid converted, prg size %d", psid64->m_programSize );
-
-						memcpy( &prgDataLaunch[0], psid64->m_programData, psid64->m_programSize );
-						prgSizeLaunch = psid64->m_programSize;
-
-						delete psid64;
-						*launchKernel = 41; 
+						if ( prgSizeLaunch > 0 )
+							*launchKernel = 41; 
 					}
 					return;
 				}
@@ -1848,6 +1834,11 @@ void handleC64( int k, u32 *launchKernel, char *FILENAME, char *filenameKernal,
 				netEnableWebserver = true;
 			}
 		}
+		else if ( k == 't' || k == 'T')
+		{
+			if (pSidekickNet->IsRunning() && strcmp(netSktpHostName,"") != 0)
+				pSidekickNet->queueNetworkBenchmark();
+		}
 		else if ( k == 's' || k == 'S')
 		{
 			menuScreen = MENU_SYSTEMINFO;
@@ -2425,6 +2416,13 @@ void printNetworkScreen()
 			printC64( x+1, y1+4, "You are connected (via WLAN).",   skinValues.SKIN_MENU_TEXT_ITEM, 0 );
 		else
 			printC64( x+1, y1+4, "You are connected (via network cable).",   skinValues.SKIN_MENU_TEXT_ITEM, 0 );
+		//the benchmark runs against the sktp host
+		if (strcmp(netSktpHostName,"") != 0)
+		{
+			printC64( x+1, y1+5, "T - Run network benchmark", skinValues.SKIN_MENU_TEXT_HEADER, 0 );
+			for ( unsigned i = 0; i < 3; i++ )
+				printC64( x+1, y1+6+i, pSidekickNet->getNetworkBenchmarkInfo( i ), skinValues.SKIN_MENU_TEXT_ITEM, 0 );
+		}
 		if (strcmp(netSktpHostName,"") != 0)
 			printC64( x+1, y1+(++y2), "* - Launch SKTP browser", skinValues.SKIN_MENU_TEXT_HEADER, 0 );
 		if (!netEnableWebserver)
@@ -2552,10 +2550,81 @@ void printSystemInfoScreen()
 	
 }
 
-void printSKTPScreen()
+// SKTP screen as painted by the streaming SKTP parser (see net.cpp) in the network worker task,
+// the menu takes a finished screen with sktpShowScreen and printSKTPScreen copies it into the menu screen
+static u8 sktpScreen[ 1024 ], sktpColor[ 1024 ];
+static u8 sktpShownScreen[ 1024 ], sktpShownColor[ 1024 ];
+static boolean sktpScreenValid = false, sktpShownValid = false;
+
+void sktpBeginScreen( boolean clear )
+{
+	if ( clear || !sktpScreenValid )
+	{
+		memset( sktpScreen, ' ', 1024 );
+		memset( sktpColor, 0, 1024 );
+	}
+	sktpScreenValid = true;
+}
+
+void sktpPaintChunk( u8 type, u16 pos, u8 color, boolean inverse, u8 repeat, char * content )
 {
 	const unsigned yOffset = 0;
-	
+	u8 y = pos / 40;
+	u8 x = pos % 40;
+
+	if (type == 2)
+	{
+		for (u16 c = 0; c < strlen(content); c++)
+		{
+			sktpScreen[ pos + c ] = content[c];
+			sktpColor[ pos + c ] = color;
+		}
+	}
+	else if (type < 6)
+	{
+		for (u8 z = 0; z < repeat; z++)
+			printC64To( sktpScreen, sktpColor, x, y+yOffset+z, content, color, inverse ? 0x80 : 0, (type == 5) ? 4:1, strlen(content));
+	}
+	else if (type == 6)
+	{
+		//paintbrush chunk (6)
+		u8 gap = color;
+		for (u8 z = 0; z < repeat+1; z++)
+			for (u16 c = 0; c < strlen(content); c++)
+			{
+				u8 co = content[c];
+				if ( co == 16 ) co = 0;
+				sktpColor[ pos + c + (z*(gap + strlen(content))) ] = co;
+			}
+	}
+}
+
+void sktpPaintFrame( const u8 * screen, const u8 * color )
+{
+	memcpy( sktpScreen, screen, 1000 );
+	memcpy( sktpColor, color, 1000 );
+	sktpScreenValid = true;
+}
+
+// menu side, called when the worker has finished a screen
+void sktpShowScreen()
+{
+	if ( !sktpScreenValid )
+		return;
+	memcpy( sktpShownScreen, sktpScreen, 1024 );
+	memcpy( sktpShownColor, sktpColor, 1024 );
+	sktpShownValid = true;
+}
+
+void sktpSetColorsAndCharset( u8 borderColor, u8 bgColor, boolean lowerCharset )
+{
+	SKTPborderColor = borderColor;
+	SKTPbgColor = bgColor;
+	SKTPisLowerCharset = lowerCharset;
+}
+
+void printSKTPScreen()
+{
 	if ( pSidekickNet->IsRunning() )
 	{
 		if ( pSidekickNet->getSKTPErrorCode() > 0)
@@ -2591,93 +2660,11 @@ void printSKTPScreen()
 		}
 		else
 		{
-			if ( pSidekickNet->IsSktpScreenToBeCleared() ) clearC64();
-
-			if ( !pSidekickNet->IsSktpScreenUnchanged() )
+			//the chunks have already been painted by the streaming SKTP parser
+			if ( sktpShownValid )
 			{
-				u16 pos = 0;
-				u8 color = 0;
-				u8 y = 0;
-				u8 x = 0;
-				u8 repeat = 0;
-				boolean inverse = false;
-				char * content;
-				pSidekickNet->ResetSktpScreenContentChunks();
-				while (!pSidekickNet->IsSktpScreenContentEndReached())
-				{
-					/*
-					chunk types:
-					0 normal chunk
-					1 char repeat chunk
-					2 screencode chunk
-					3 meta screen refresh
-					4 colors (border, background) & charset
-					5 vertical repeat chunk
-					6 paintbrush chunk
-					7 tga image file url/name to be shown on color tft display
-					8 tga image content
-					*/
-					u8 type = pSidekickNet->GetSktpScreenContentChunkType();
-					if ( type == 0 || type == 1 || type == 2 || type == 5 || type == 6)
-					{
-						content = (char *) pSidekickNet->GetSktpScreenContentChunk( pos, color, inverse, repeat);
-						if (type < 5) 
-							repeat = 1;
-							
-						if (type == 2)
-						{
-							for (u16 c = 0; c < strlen(content); c++)
-							{
-								c64screen[ pos + c ] = content[c];
-								c64color[ pos + c ] = color;
-							}
-						}
-						else if (type < 6)
-						{
-							y = pos / 40;
-							x = pos % 40;
-							for (u8 z = 0; z < repeat; z++)
-								printC64( x, y+yOffset+z, content, color, inverse ? 0x80 : 0, (type == 5) ? 4:1, strlen(content));
-						}
-						else if (type == 6)
-						{
-							//paintbrush chunk (6)
-							u8 gap = color;
-							for (u8 z = 0; z < repeat+1; z++)
-								for (u16 c = 0; c < strlen(content); c++)
-								{
-									u8 co = content[c];
-									if ( co == 16 ) co = 0;
-									c64color[ pos + c + (z*(gap + strlen(content))) ] = co;
-								}
-						}
-					}
-					else if (type == 3)
-						pSidekickNet->enableSktpRefreshTimeout();
-					else if (type == 4)
-						SKTPisLowerCharset = (pSidekickNet->getSKTPBorderBGColorCharset( SKTPborderColor, SKTPbgColor) == 1);
-					else if (type == 7)
-						pSidekickNet->prepareDownloadOfTGAImage();
-					else if (type == 8)
-						pSidekickNet->updateTGAImageFromSKTPChunk();
-					else if (type == 88)
-					{
-						//silently ignore
-						//logger->Write( "printSKTPScreen", LogWarning, "magic 88");
-						break;
-					}
-					else if (type == 255)
-					{
-						logger->Write( "printSKTPScreen", LogWarning, "end of sktp response was reached");
-						break;
-					}
-					else{
-						logger->Write( "printSKTPScreen", LogWarning, "sktp screen early exit");
-						break; //in case of unknown chunk types at the end of the content we break as we don't 
-						//how long they are
-					}
-				}
-				pSidekickNet->ResetSktpScreenContentChunks();
+				memcpy( c64screen, sktpShownScreen, 1024 );
+				memcpy( c64color, sktpShownColor, 1024 );
 			}
 		}
 	}
@@ -2868,7 +2855,9 @@ void setErrorMsg( char * msg)
 void setErrorMsg2( char * msg, boolean sticky = false )
 {
 	errorMsg = msg;
-	previousMenuScreen = menuScreen;
+	//a message replacing one which hasn't been rendered yet must not become the screen to return to
+	if ( menuScreen != MENU_ERROR )
+		previousMenuScreen = menuScreen;
 	menuScreen = MENU_ERROR;
 	errorSticky = sticky;
 }
@@ -47,6 +47,37 @@ static bool menuFile = false;
 
 static char FILENAME_TEMP[24];
 
+//
+// per-folder cache of generated directory listings (keyed by folder, pattern and type) and
+// a hash index PETSCII filename -> DIRENTRY index for 'findFile' of the current folder
+//
+#define DIR_CACHE_SLOTS			4
+#define DIR_CACHE_PATTERN_LEN	20
+#define DIR_CACHE_LISTING_SIZE	4096
+
+typedef struct
+{
+	bool valid;
+	u32 parent;
+	FILE_TYPE type;
+	char pattern[ DIR_CACHE_PATTERN_LEN ];
+	u32 lastUsed;
+	u32 size;
+	u8 listing[ DIR_CACHE_LISTING_SIZE ];
+} DIR_CACHE_SLOT;
+
+static DIR_CACHE_SLOT dirCache[ DIR_CACHE_SLOTS ];
+static u32 dirCacheTick = 0;
+
+#define FILE_INDEX_BITS			11
+#define FILE_INDEX_SIZE			( 1 << FILE_INDEX_BITS )
+#define FILE_INDEX_MAX_ENTRIES	( FILE_INDEX_SIZE / 2 )
+
+static bool fileIndexValid = false;
+static bool fileIndexUsable = false;
+static u32 fileIndexParent = 0xffffffff;
+static s32 fileIndex[ FILE_INDEX_SIZE ];
+
 static u32 getParent( s32 pos )
 {
 	if ( pos >= 0 && pos < nDirEntries )
@@ -57,8 +88,21 @@ static u32 getParent( s32 pos )
 	return 0xffffffff;
 }
 
+static void invalidateDirCache( void )
+{
+	for ( u32 i = 0; i < DIR_CACHE_SLOTS; i++ )
+	{
+		dirCache[ i ].valid = false;
+	}
+
+	fileIndexValid = false;
+}
+
 void initDiskEmulation( const char *FILENAME )
 {
+	// the menu may have rescanned or modified the directory tree in the meantime
+	invalidateDirCache();
+
 	dirCurrent = cursorPos;
 	dirParent = getParent( cursorPos );
 	menuFile = FILENAME[ 0 ] != 0;
@@ -355,6 +399,54 @@ static bool typeMatch( DIRENTRY *entry, FILE_TYPE type )
 	return type == FILE_PRG;
 }
 
+// returns the slot holding the listing for the current folder/pattern/type, or (invalid) the slot to be replaced
+static DIR_CACHE_SLOT *findDirCacheSlot( const char *pattern, FILE_TYPE type )
+{
+	DIR_CACHE_SLOT *victim = &dirCache[ 0 ];
+
+	for ( u32 i = 0; i < DIR_CACHE_SLOTS; i++ )
+	{
+		DIR_CACHE_SLOT *slot = &dirCache[ i ];
+		if ( slot->valid && slot->parent == dirParent && slot->type == type &&
+			 strncmp( slot->pattern, pattern, DIR_CACHE_PATTERN_LEN ) == 0 )
+		{
+			return slot;
+		}
+
+		if ( !slot->valid )
+		{
+			if ( victim->valid )
+			{
+				victim = slot;
+			}
+		}
+		else if ( victim->valid && slot->lastUsed < victim->lastUsed )
+		{
+			victim = slot;
+		}
+	}
+
+	victim->valid = false;
+	return victim;
+}
+
+static void storeDirCacheSlot( DIR_CACHE_SLOT *slot, const char *pattern, FILE_TYPE type, const u8 *data, u32 size )
+{
+	// do not cache listings which do not fit or patterns which would be truncated
+	if ( size + 2 > DIR_CACHE_LISTING_SIZE || strlen( pattern ) >= DIR_CACHE_PATTERN_LEN )
+	{
+		return;
+	}
+
+	slot->parent = dirParent;
+	slot->type = type;
+	strcpy( slot->pattern, pattern );
+	slot->size = size;
+	memcpy( slot->listing, data, size + 2 );
+	slot->lastUsed = ++ dirCacheTick;
+	slot->valid = true;
+}
+
 static bool loadDirectory( char *pattern, u8 *data, u32 *size )
 {
 	if ( pattern[0] == 0 )      // no pattern
@@ -417,6 +509,15 @@ static bool loadDirectory( char *pattern, u8 *data, u32 *size )
 		p_ptr++;
 	}
 
+	DIR_CACHE_SLOT *slot = findDirCacheSlot( pattern, type );
+	if ( slot->valid )
+	{
+		slot->lastUsed = ++ dirCacheTick;
+		memcpy( data, slot->listing, slot->size + 2 );
+		*size = slot->size;
+		return true;
+	}
+
 	u8 *ptr = data;
 	putU16( &ptr, 0x0401 );            // start address
 
@@ -470,6 +571,8 @@ static bool loadDirectory( char *pattern, u8 *data, u32 *size )
 
 	*size = ptr - ( data + 2 );
 
+	storeDirCacheSlot( slot, pattern, type, data, *size );
+
 	return true;
 }
 
@@ -550,13 +653,108 @@ static void parseFilename( char *filename, PARSED_FILENAME *parsed )
 	}
 }
 
-static s32 findFile( const char *filename )
+static inline bool isLoadableEntry( DIRENTRY *entry )
+{
+	return (entry->f & DIR_FILE_IN_D64 && ((entry->f>>SHIFT_TYPE)&7) == FILE_PRG) ||
+		   !(entry->f & DIR_FILE_IN_D64);
+}
+
+// FNV-1a over the 16 character PETSCII name (padded with $a0, as returned by getFilename)
+static u32 hashFilename( const char *name )
+{
+	u32 h = 2166136261u;
+	for ( u8 i = 0; i < 16; i++ )
+	{
+		h = ( h ^ (u8)name[ i ] ) * 16777619u;
+	}
+
+	return h;
+}
+
+static void buildFileIndex( void )
 {
+	fileIndexValid = true;
+	fileIndexUsable = true;
+	fileIndexParent = dirParent;
+
+	for ( u32 i = 0; i < FILE_INDEX_SIZE; i++ )
+	{
+		fileIndex[ i ] = -1;
+	}
+
+	u32 nIndexed = 0;
 	DIRENTRY *entry;
+	rewindDir();
 	while ( readDir( &entry ) )
 	{
-		if ( (entry->f & DIR_FILE_IN_D64 && ((entry->f>>SHIFT_TYPE)&7) == FILE_PRG) ||
-			 !(entry->f & DIR_FILE_IN_D64) )
+		if ( !isLoadableEntry( entry ) )
+		{
+			continue;
+		}
+
+		if ( ++ nIndexed > FILE_INDEX_MAX_ENTRIES )
+		{
+			// too many files in this folder, keep using the linear search
+			fileIndexUsable = false;
+			break;
+		}
+
+		const char *filename = getFilename( entry );
+		u32 h = hashFilename( filename ) & ( FILE_INDEX_SIZE - 1 );
+
+		// linear probing: for duplicate names the entry inserted first (= first in directory order,
+		// as with the linear search) is also found first during lookup
+		while ( fileIndex[ h ] >= 0 )
+		{
+			h = ( h + 1 ) & ( FILE_INDEX_SIZE - 1 );
+		}
+		fileIndex[ h ] = dirPos - 1;
+	}
+
+	rewindDir();
+}
+
+static s32 findFile( const char *filename, bool wildcard = true )
+{
+	if ( !wildcard )
+	{
+		if ( !fileIndexValid || fileIndexParent != dirParent )
+		{
+			buildFileIndex();
+		}
+
+		if ( fileIndexUsable )
+		{
+			// pad the requested name like getFilename does
+			char key[ 16 ];
+			u8 i = 0;
+			for ( ; i < 16 && filename[ i ]; i++ )
+			{
+				key[ i ] = filename[ i ];
+			}
+			for ( ; i < 16; i++ )
+			{
+				key[ i ] = (char)0xa0;
+			}
+
+			u32 h = hashFilename( key ) & ( FILE_INDEX_SIZE - 1 );
+			while ( fileIndex[ h ] >= 0 )
+			{
+				if ( memcmp( getFilename( &dir[ fileIndex[ h ] ] ), key, 16 ) == 0 )
+				{
+					return fileIndex[ h ];
+				}
+				h = ( h + 1 ) & ( FILE_INDEX_SIZE - 1 );
+			}
+
+			return -1;
+		}
+	}
+
+	DIRENTRY *entry;
+	while ( readDir( &entry ) )
+	{
+		if ( isLoadableEntry( entry ) )
 		{
 			if ( filenameMatch( entry, filename ) )
 			{
@@ -634,7 +832,7 @@ bool loadPrgFile( CLogger *logger, const char *DRIVE, char *FILENAME, char *vic2
 		if ( parsed.name[ 0 ] != '*' || dirCurrent < 0 || dirCurrent >= nDirEntries )
 		{
 			rewindDir();
-			dirCurrent = findFile( parsed.name );
+			dirCurrent = findFile( parsed.name, parsed.wildcard );
 		}
 
 		if ( dirCurrent < 0 || dirCurrent >= nDirEntries )
@@ -653,6 +851,7 @@ bool loadPrgFile( CLogger *logger, const char *DRIVE, char *FILENAME, char *vic2
 				buildPath( dirCurrent, FILENAME, 1 );
 				strcat( FILENAME, "\\" );
 				insertDirectoryContents( dirCurrent, FILENAME, f & DIR_LISTALL );
+				invalidateDirCache();
 			}
 
 			dirParent = dirCurrent;
@@ -702,6 +901,9 @@ static s32 insertFile( u32 parent, const char *name, u32 f, u32 size )
 		prev = i;
 	}
 
+	// all indices behind 'prev' are shifted
+	invalidateDirCache();
+
 	s32 c = prev + 1;
 	s32 count = nDirEntries - prev;
 	memmove( &dir[ c ], &dir[ prev ], count * sizeof( DIRENTRY ) );
@@ -758,7 +960,7 @@ bool savePrgFile( CLogger *logger, const char *DRIVE, char *FILENAME, char *vic2
 	}
 
 	rewindDir();
-	dirCurrent = findFile( parsed.name );
+	dirCurrent = findFile( parsed.name, parsed.wildcard );
 
 	char *newName = NULL;
 	if ( dirCurrent < 0 )	// file not found
@@ -803,6 +1005,9 @@ bool savePrgFile( CLogger *logger, const char *DRIVE, char *FILENAME, char *vic2
 	logger->Write( "menu", LogNotice, "Saving %s (%s)", vic20Filename, FILENAME );
 	if ( writeFile( logger, DRIVE, FILENAME, data, size ) )
 	{
+		// block counts (and possibly the set of files) changed
+		invalidateDirCache();
+
 		if ( dirCurrent < 0 )
 		{
 			dirCurrent = insertFile( dirParent, newName, DIR_PRG_FILE, size );
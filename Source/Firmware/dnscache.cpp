@@ -0,0 +1,221 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ dnscache.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - DNS cache with background refresh of frequently used hosts
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "dnscache.h"
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+
+extern CLogger *logger;
+
+// uncached lookups are tried this often
+#define DNS_CACHE_ATTEMPTS	2
+
+CDNSCache::CDNSCache( CNetSubSystem *pNet )
+:	m_DNSClient( pNet ),
+	m_nEntries( 0 )
+{
+}
+
+CDNSCache::~CDNSCache()
+{
+}
+
+CDNSCache::TEntry *CDNSCache::find( const char *hostName )
+{
+	for ( unsigned i = 0; i < m_nEntries; i++ )
+		if ( strcmp( m_Entry[ i ].hostName, hostName ) == 0 )
+			return &m_Entry[ i ];
+	return 0;
+}
+
+CDNSCache::TEntry *CDNSCache::insert( const char *hostName )
+{
+	TEntry *e = 0;
+	if ( m_nEntries < DNS_CACHE_SIZE )
+		e = &m_Entry[ m_nEntries++ ]; else
+	{
+		// replace the least recently used entry, prefetched hosts are kept if possible
+		for ( unsigned i = 0; i < DNS_CACHE_SIZE; i++ )
+		{
+			TEntry *t = &m_Entry[ i ];
+			if ( e == 0 || ( e->prefetch && !t->prefetch ) || ( e->prefetch == t->prefetch && t->lastUsed < e->lastUsed ) )
+				e = t;
+		}
+	}
+
+	e->resolved = false;
+	e->prefetch = false;
+	e->resolvedAt = e->expires = e->refresh = e->lastUsed = 0;
+	e->failures = 0;
+	e->everResolved = false;
+	strncpy( e->hostName, hostName, DNS_CACHE_MAX_HOSTNAME - 1 );
+	e->hostName[ DNS_CACHE_MAX_HOSTNAME - 1 ] = 0;
+	return e;
+}
+
+boolean CDNSCache::isStaleUsable( TEntry *e, unsigned now )
+{
+	return e->resolved && e->prefetch && now - e->resolvedAt < DNS_CACHE_TTL + DNS_CACHE_STALE;
+}
+
+boolean CDNSCache::lookup( const char *hostName, CIPAddress *pIPAddress )
+{
+	for ( unsigned attempt = 0; attempt < DNS_CACHE_ATTEMPTS; attempt++ )
+		if ( m_DNSClient.Resolve( hostName, pIPAddress ) )
+			return true;
+	return false;
+}
+
+CDNSCache::TEntry *CDNSCache::store( const char *hostName, boolean resolved, CIPAddress &ipAddress )
+{
+	unsigned now = CTimer::Get()->GetUptime();
+
+	TEntry *e = find( hostName );
+	if ( e == 0 )
+		e = insert( hostName );
+
+	if ( resolved )
+	{
+		e->ipAddress = ipAddress;
+		e->resolved = true;
+		e->resolvedAt = now;
+		e->expires = now + DNS_CACHE_TTL;
+		e->refresh = e->expires - DNS_CACHE_REFRESH_AHEAD;
+		e->failures = 0;
+		e->everResolved = true;
+	} else
+	{
+		// a prefetched host keeps its last known address for a while
+		if ( !isStaleUsable( e, now ) )
+			e->resolved = false;
+		e->expires = now + DNS_CACHE_NEGATIVE_TTL;
+		e->refresh = e->expires;
+	}
+	return e;
+}
+
+boolean CDNSCache::Resolve( const char *hostName, CIPAddress *pIPAddress )
+{
+	unsigned now = CTimer::Get()->GetUptime();
+
+	TEntry *e = find( hostName );
+	if ( e != 0 )
+	{
+		e->lastUsed = now;
+		if ( now < e->expires || isStaleUsable( e, now ) )
+		{
+			if ( e->resolved )
+				pIPAddress->Set( e->ipAddress );
+			return e->resolved;
+		}
+	}
+
+	boolean resolved = lookup( hostName, pIPAddress );
+	store( hostName, resolved, *pIPAddress );
+	if ( !resolved )
+		logger->Write( "DNSCache", LogWarning, "Cannot resolve %s", hostName );
+	return resolved;
+}
+
+void CDNSCache::Prefetch( const char *hostName )
+{
+	if ( hostName == 0 || hostName[ 0 ] == 0 )
+		return;
+
+	TEntry *e = find( hostName );
+	if ( e == 0 )
+		e = insert( hostName );
+	e->prefetch = true;
+	e->lastUsed = CTimer::Get()->GetUptime();
+}
+
+void CDNSCache::Run( void )
+{
+	for ( ;; )
+	{
+		unsigned now = CTimer::Get()->GetUptime();
+
+		// refresh the prefetched host which is due first
+		TEntry *due = 0;
+		for ( unsigned i = 0; i < m_nEntries; i++ )
+		{
+			TEntry *e = &m_Entry[ i ];
+			if ( e->prefetch && e->refresh <= now && ( due == 0 || e->refresh < due->refresh ) )
+				due = e;
+		}
+
+		if ( due == 0 )
+		{
+			CScheduler::Get()->Sleep( 1 );
+			continue;
+		}
+
+		// the entry may be replaced while we are waiting for the answer
+		char hostName[ DNS_CACHE_MAX_HOSTNAME ];
+		strcpy( hostName, due->hostName );
+
+		CIPAddress ipAddress;
+		boolean resolved = lookup( hostName, &ipAddress );
+		TEntry *e = store( hostName, resolved, ipAddress );
+		e->prefetch = true;
+
+		if ( resolved )
+		{
+			CString address;
+			ipAddress.Format( &address );
+			logger->Write( "DNSCache", LogDebug, "Prefetch %s: %s", hostName, (const char *)address );
+			continue;
+		}
+
+		// only the first failure is logged, then retry with exponential backoff
+		if ( e->failures ++ == 0 )
+			logger->Write( "DNSCache", LogWarning, "Prefetch %s: failed", hostName );
+
+		if ( !e->everResolved && e->failures >= DNS_CACHE_PREFETCH_ATTEMPTS )
+		{
+			// e.g. a host only known in another LAN: stays a regular (negative) cache entry
+			e->prefetch = false;
+			logger->Write( "DNSCache", LogDebug, "Prefetch %s: given up", hostName );
+			continue;
+		}
+
+		unsigned backoff = DNS_CACHE_NEGATIVE_TTL;
+		for ( unsigned i = 1; i < e->failures && backoff < DNS_CACHE_MAX_BACKOFF; i++ )
+			backoff *= 2;
+		if ( backoff > DNS_CACHE_MAX_BACKOFF )
+			backoff = DNS_CACHE_MAX_BACKOFF;
+		e->refresh = CTimer::Get()->GetUptime() + backoff;
+	}
+}
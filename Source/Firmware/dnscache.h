@@ -0,0 +1,102 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ dnscache.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - DNS cache with background refresh of frequently used hosts
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _dnscache_h
+#define _dnscache_h
+
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/dnsclient.h>
+#include <circle/net/ipaddress.h>
+#include <circle/types.h>
+
+#define DNS_CACHE_SIZE				32
+#define DNS_CACHE_MAX_HOSTNAME		128
+
+// Circle's resolver does not report the TTL of a record, so all addresses are kept this long (seconds)
+#define DNS_CACHE_TTL				600
+// failed lookups are not repeated before this many seconds have passed
+#define DNS_CACHE_NEGATIVE_TTL		30
+// expired addresses of prefetched hosts are still handed out for this long while being refreshed
+#define DNS_CACHE_STALE				3600
+// prefetched hosts are refreshed this many seconds before they expire
+#define DNS_CACHE_REFRESH_AHEAD		60
+// failed refreshes of a prefetched host are retried with exponential backoff up to this many seconds
+#define DNS_CACHE_MAX_BACKOFF		3600
+// prefetching of a host which has never been resolved is given up after this many failed attempts
+#define DNS_CACHE_PREFETCH_ATTEMPTS	3
+
+//
+// shared cache of resolved host names: lookups which are answered from the cache (also negative answers)
+// don't block the caller. Hosts registered with Prefetch() are resolved and kept up-to-date by
+// the cache's own task while other tasks yield, i.e. they are usually resolved before they are needed.
+//
+class CDNSCache : public CTask
+{
+public:
+	CDNSCache( CNetSubSystem *pNet );
+	~CDNSCache();
+
+	// returns false if the host could not be resolved (now or during the last DNS_CACHE_NEGATIVE_TTL seconds)
+	boolean Resolve( const char *hostName, CIPAddress *pIPAddress );
+
+	// resolves the host in the background and keeps it up-to-date
+	void Prefetch( const char *hostName );
+
+	void Run( void );
+
+private:
+	typedef struct {
+		char hostName[ DNS_CACHE_MAX_HOSTNAME ];
+		CIPAddress ipAddress;
+		boolean resolved;
+		boolean prefetch;
+		unsigned resolvedAt;		// uptime in seconds
+		unsigned expires;
+		unsigned refresh;			// prefetched hosts are resolved again at this time
+		unsigned lastUsed;
+		unsigned failures;			// failed refreshes in a row
+		boolean everResolved;
+	} TEntry;
+
+	TEntry *find( const char *hostName );
+	TEntry *insert( const char *hostName );
+	boolean lookup( const char *hostName, CIPAddress *pIPAddress );
+	TEntry *store( const char *hostName, boolean resolved, CIPAddress &ipAddress );
+	boolean isStaleUsable( TEntry *e, unsigned now );
+
+	CDNSClient m_DNSClient;
+	TEntry m_Entry[ DNS_CACHE_SIZE ];
+	unsigned m_nEntries;
+};
+
+#endif
@@ -0,0 +1,565 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ httppool.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - pool of persistent (keep-alive) HTTP(S) connections
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "httppool.h"
+#include <circle/net/socket.h>
+#include <circle/net/in.h>
+#include <circle/timer.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#ifdef WITH_TLS
+#include <circle-mbedtls/tlssimpleclientsocket.h>
+#endif
+
+extern CLogger *logger;
+
+static unsigned parseNumber( const char *s, unsigned base )
+{
+	unsigned v = 0;
+	while ( *s == ' ' || *s == '\t' ) s++;
+	for ( ;; s++ )
+	{
+		unsigned d;
+		if ( *s >= '0' && *s <= '9' ) d = *s - '0'; else
+		if ( base == 16 && *s >= 'a' && *s <= 'f' ) d = *s - 'a' + 10; else
+		if ( base == 16 && *s >= 'A' && *s <= 'F' ) d = *s - 'A' + 10; else
+			break;
+		v = v * base + d;
+	}
+	return v;
+}
+
+static boolean hasPrefixNoCase( const char *s, const char *prefix )
+{
+	for ( ; *prefix; s++, prefix++ )
+	{
+		char a = *s;
+		if ( a >= 'A' && a <= 'Z' ) a += 'a' - 'A';
+		if ( a != *prefix )
+			return false;
+	}
+	return true;
+}
+
+#ifdef WITH_TLS
+CHTTPConnectionPool::CHTTPConnectionPool( CNetSubSystem *pNet, CTLSSimpleSupport *pTLSSupport )
+:	m_pNet( pNet ),
+	m_pTLSSupport( pTLSSupport ),
+#else
+CHTTPConnectionPool::CHTTPConnectionPool( CNetSubSystem *pNet )
+:	m_pNet( pNet ),
+#endif
+	m_RecvPos( 0 ),
+	m_RecvLength( 0 )
+{
+	for ( unsigned i = 0; i < HTTP_POOL_SIZE; i++ )
+	{
+		m_Connection[ i ].pSocket = 0;
+		m_Connection[ i ].lastUsed = 0;
+		m_Connection[ i ].requests = 0;
+	}
+}
+
+CHTTPConnectionPool::~CHTTPConnectionPool()
+{
+	CloseAll();
+}
+
+void CHTTPConnectionPool::CloseAll()
+{
+	for ( unsigned i = 0; i < HTTP_POOL_SIZE; i++ )
+		closeConnection( &m_Connection[ i ] );
+}
+
+void CHTTPConnectionPool::CloseIdle()
+{
+	unsigned now = CTimer::Get()->GetUptime();
+	for ( unsigned i = 0; i < HTTP_POOL_SIZE; i++ )
+	{
+		TConnection *c = &m_Connection[ i ];
+		if ( c->pSocket != 0 && now - c->lastUsed >= c->idleTimeout )
+			closeConnection( c );
+	}
+}
+
+void CHTTPConnectionPool::closeConnection( TConnection *c )
+{
+	if ( c->pSocket != 0 )
+	{
+		delete c->pSocket;
+		c->pSocket = 0;
+	}
+	c->requests = 0;
+}
+
+boolean CHTTPConnectionPool::openConnection( TConnection *c )
+{
+#ifdef WITH_TLS
+	if ( c->useTLS )
+	{
+		CTLSSimpleClientSocket *pTLSSocket = new CTLSSimpleClientSocket( m_pTLSSupport, IPPROTO_TCP );
+		if ( pTLSSocket->Setup( c->hostName ) != 0 )
+		{
+			logger->Write( "HTTPPool", LogError, "TLS setup for %s failed", (const char *)c->hostName );
+			delete pTLSSocket;
+			return false;
+		}
+		c->pSocket = pTLSSocket;
+	} else
+#endif
+		c->pSocket = new CSocket( m_pNet, IPPROTO_TCP );
+
+	if ( c->pSocket->Connect( c->ipAddress, c->port ) < 0 )
+	{
+		logger->Write( "HTTPPool", LogError, "Cannot connect to %s:%u", (const char *)c->hostName, c->port );
+		closeConnection( c );
+		return false;
+	}
+
+	c->requests = 0;
+	c->idleTimeout = HTTP_POOL_IDLE_TIMEOUT;
+	c->lastUsed = CTimer::Get()->GetUptime();
+	return true;
+}
+
+CHTTPConnectionPool::TConnection *CHTTPConnectionPool::getConnection( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, boolean &reused )
+{
+	unsigned now = CTimer::Get()->GetUptime();
+	reused = false;
+
+	// open connection to this host?
+	for ( unsigned i = 0; i < HTTP_POOL_SIZE; i++ )
+	{
+		TConnection *c = &m_Connection[ i ];
+		if ( c->pSocket != 0 && c->port == port && c->useTLS == useTLS && c->hostName.Compare( hostName ) == 0 )
+		{
+			if ( now - c->lastUsed < c->idleTimeout )
+			{
+				reused = true;
+				return c;
+			}
+			// most likely closed by the server by now
+			closeConnection( c );
+		}
+	}
+
+	// otherwise use a free slot or replace the least recently used connection
+	TConnection *c = 0;
+	for ( unsigned i = 0; i < HTTP_POOL_SIZE; i++ )
+	{
+		TConnection *t = &m_Connection[ i ];
+		if ( t->pSocket == 0 )
+		{
+			c = t;
+			break;
+		}
+		if ( c == 0 || t->lastUsed < c->lastUsed )
+			c = t;
+	}
+	closeConnection( c );
+
+	c->hostName = hostName;
+	c->port = port;
+	c->ipAddress = ipAddress;
+	c->useTLS = useTLS;
+
+	if ( !openConnection( c ) )
+		return 0;
+
+	return c;
+}
+
+int CHTTPConnectionPool::readByte( TConnection *c )
+{
+	if ( m_RecvPos >= m_RecvLength )
+	{
+		int n = c->pSocket->Receive( m_RecvBuffer, HTTP_POOL_RECV_BUFFER, 0 );
+		if ( n <= 0 )
+			return -1;
+		m_RecvPos = 0;
+		m_RecvLength = n;
+	}
+	return m_RecvBuffer[ m_RecvPos++ ];
+}
+
+boolean CHTTPConnectionPool::readLine( TConnection *c, char *line, unsigned maxLength )
+{
+	unsigned l = 0;
+	for ( ;; )
+	{
+		int b = readByte( c );
+		if ( b < 0 )
+			return false;
+		if ( b == '\n' )
+			break;
+		if ( b != '\r' && l < maxLength - 1 )
+			line[ l++ ] = b;
+	}
+	line[ l ] = 0;
+	return true;
+}
+
+boolean CHTTPConnectionPool::putBody( TBodySink *sink, const u8 *pData, unsigned length )
+{
+	if ( sink->pHandler != 0 )
+	{
+		if ( !sink->pHandler( pData, length, sink->pParam ) )
+			return false;
+	} else
+	{
+		if ( sink->length + length > sink->maxLength )
+			return false;
+		memcpy( sink->pBuffer + sink->length, pData, length );
+	}
+	sink->length += length;
+	return true;
+}
+
+boolean CHTTPConnectionPool::readBody( TConnection *c, TBodySink *sink, unsigned length )
+{
+	while ( length > 0 )
+	{
+		if ( m_RecvPos >= m_RecvLength )
+		{
+			int n = c->pSocket->Receive( m_RecvBuffer, HTTP_POOL_RECV_BUFFER, 0 );
+			if ( n <= 0 )
+				return false;
+			m_RecvPos = 0;
+			m_RecvLength = n;
+		}
+
+		unsigned n = m_RecvLength - m_RecvPos;
+		if ( n > length ) n = length;
+		if ( !putBody( sink, &m_RecvBuffer[ m_RecvPos ], n ) )
+			return false;
+		m_RecvPos += n;
+		length -= n;
+	}
+	return true;
+}
+
+// polls for the first bytes of the response, a blocking receive would only return after the TCP timeout
+// if the server has dropped the connection without us noticing.
+// Returns 1 if the response has started, -1 if the connection is closed and 0 on a timeout
+int CHTTPConnectionPool::waitForResponse( TConnection *c )
+{
+	unsigned start = CTimer::GetClockTicks();
+	while ( CTimer::GetClockTicks() - start < HTTP_POOL_REUSED_TIMEOUT_US )
+	{
+		int n = c->pSocket->Receive( m_RecvBuffer, HTTP_POOL_RECV_BUFFER, MSG_DONTWAIT );
+		if ( n < 0 )
+			return -1;
+		if ( n > 0 )
+		{
+			m_RecvPos = 0;
+			m_RecvLength = n;
+			return 1;
+		}
+		CScheduler::Get()->MsSleep( 1 );
+	}
+	return 0;
+}
+
+static void copyHeaderValue( char *dst, unsigned size, const char *value )
+{
+	while ( *value == ' ' || *value == '\t' ) value++;
+	strncpy( dst, value, size - 1 );
+	dst[ size - 1 ] = 0;
+}
+
+// 'resend' is set if the request failed on a reused connection which the server had closed before
+// answering, i.e. it is safe to send the request again
+unsigned CHTTPConnectionPool::request( TConnection *c, boolean reused, const char *path, TBodySink *sink, THTTPValidators *pValidators, boolean &keepAlive, boolean &resend )
+{
+	resend = false;
+
+	CString hostHeader = c->hostName;
+	if ( c->port != 80 && c->port != 443 )
+	{
+		CString port;
+		port.Format( ":%u", c->port );
+		hostHeader.Append( port );
+	}
+
+	CString request;
+	request.Format( "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: Sidekick64\r\nConnection: keep-alive\r\n", path, (const char *)hostHeader );
+
+	THTTPRange *pRange = sink->pRange;
+	boolean resume = pRange != 0 && pRange->offset > 0;
+	if ( pRange != 0 )
+	{
+		CString range;
+		if ( pRange->length > 0 )
+			range.Format( "Range: bytes=%u-%u\r\n", pRange->offset, pRange->offset + pRange->length - 1 ); else
+			range.Format( "Range: bytes=%u-\r\n", pRange->offset );
+		request.Append( range );
+	}
+
+	if ( resume && pValidators != 0 && ( pValidators->eTag[ 0 ] || pValidators->lastModified[ 0 ] ) )
+	{
+		// the rest of the resource is only wanted if it is still the same
+		request.Append( "If-Range: " );
+		request.Append( pValidators->eTag[ 0 ] ? pValidators->eTag : pValidators->lastModified );
+		request.Append( "\r\n" );
+	} else
+	if ( !resume )
+	{
+		if ( pValidators != 0 && pValidators->eTag[ 0 ] )
+		{
+			request.Append( "If-None-Match: " );
+			request.Append( pValidators->eTag );
+			request.Append( "\r\n" );
+		}
+		if ( pValidators != 0 && pValidators->lastModified[ 0 ] )
+		{
+			request.Append( "If-Modified-Since: " );
+			request.Append( pValidators->lastModified );
+			request.Append( "\r\n" );
+		}
+	}
+	request.Append( "\r\n" );
+	if ( c->pSocket->Send( (const char *)request, request.GetLength(), 0 ) != (int)request.GetLength() )
+	{
+		resend = reused;
+		return 0;
+	}
+
+	m_RecvPos = m_RecvLength = 0;
+	if ( reused )
+	{
+		int response = waitForResponse( c );
+		if ( response <= 0 )
+		{
+			// a slow server (timeout) may still process the request
+			resend = response < 0;
+			return 0;
+		}
+	}
+
+	// status line
+	char line[ 512 ];
+	if ( !readLine( c, line, sizeof( line ) ) || strncmp( line, "HTTP/1.", 7 ) != 0 || line[ 8 ] != ' ' )
+		return 0;
+	keepAlive = line[ 7 ] != '0';
+	unsigned status = parseNumber( &line[ 9 ], 10 );
+
+	// header fields
+	int contentLength = -1;
+	boolean chunked = false;
+	unsigned rangeStart = 0, rangeTotal = 0;
+	THTTPValidators received;
+	received.eTag[ 0 ] = received.lastModified[ 0 ] = 0;
+	for ( ;; )
+	{
+		if ( !readLine( c, line, sizeof( line ) ) )
+			return 0;
+		if ( line[ 0 ] == 0 )
+			break;
+
+		// validators are case-sensitive, all other fields are compared in lower case
+		if ( pValidators != 0 )
+		{
+			if ( hasPrefixNoCase( line, "etag:" ) )
+				copyHeaderValue( received.eTag, sizeof( received.eTag ), &line[ 5 ] ); else
+			if ( hasPrefixNoCase( line, "last-modified:" ) )
+				copyHeaderValue( received.lastModified, sizeof( received.lastModified ), &line[ 14 ] );
+		}
+
+		for ( char *p = line; *p; p++ )
+			if ( *p >= 'A' && *p <= 'Z' ) *p += 'a' - 'A';
+
+		if ( strncmp( line, "content-length:", 15 ) == 0 )
+			contentLength = parseNumber( &line[ 15 ], 10 ); else
+		if ( strncmp( line, "transfer-encoding:", 18 ) == 0 && strstr( line, "chunked" ) != 0 )
+			chunked = true; else
+		if ( strncmp( line, "content-range:", 14 ) == 0 )
+		{
+			// "bytes first-last/total", the total may be "*"
+			char *p = strstr( line, "bytes" );
+			if ( p != 0 )
+				rangeStart = parseNumber( p + 5, 10 );
+			p = strchr( line, '/' );
+			if ( p != 0 )
+				rangeTotal = parseNumber( p + 1, 10 );
+		} else
+		if ( strncmp( line, "connection:", 11 ) == 0 )
+		{
+			if ( strstr( line, "close" ) != 0 ) keepAlive = false;
+			if ( strstr( line, "keep-alive" ) != 0 ) keepAlive = true;
+		} else
+		if ( strncmp( line, "keep-alive:", 11 ) == 0 )
+		{
+			char *t = strstr( line, "timeout=" );
+			unsigned timeout = t ? parseNumber( t + 8, 10 ) : 0;
+			if ( timeout > 1 && timeout - 1 < HTTP_POOL_IDLE_TIMEOUT )
+				c->idleTimeout = timeout - 1;
+		}
+	}
+
+	if ( pRange != 0 )
+	{
+		if ( status == 206 )
+		{
+			pRange->offset = rangeStart;
+			pRange->total = rangeTotal;
+		} else
+		if ( status == 200 )
+		{
+			pRange->offset = 0;
+			pRange->total = contentLength >= 0 ? contentLength : 0;
+		} else
+		if ( status != 304 )
+		{
+			// e.g. 416 if the range starts beyond the end, the body is not meant for the handler
+			if ( status == 416 )
+				pRange->total = rangeTotal;
+			keepAlive = false;
+			return status;
+		}
+	}
+
+	if ( status == 204 || status == 304 || ( status >= 100 && status < 200 ) )
+	{
+		// no body
+	} else
+	if ( chunked )
+	{
+		for ( ;; )
+		{
+			if ( !readLine( c, line, sizeof( line ) ) )
+				return 0;
+			unsigned chunkSize = parseNumber( line, 16 );
+			if ( chunkSize == 0 )
+				break;
+			if ( !readBody( c, sink, chunkSize ) || !readLine( c, line, sizeof( line ) ) )
+			{
+				keepAlive = false;
+				return 0;
+			}
+		}
+		// trailer
+		do {
+			if ( !readLine( c, line, sizeof( line ) ) )
+				return 0;
+		} while ( line[ 0 ] != 0 );
+	} else
+	if ( contentLength >= 0 )
+	{
+		if ( ( sink->pHandler == 0 && (unsigned)contentLength > sink->maxLength ) || !readBody( c, sink, contentLength ) )
+		{
+			keepAlive = false;
+			return 0;
+		}
+	} else
+	{
+		// body ends when the server closes the connection
+		keepAlive = false;
+		for ( ;; )
+		{
+			if ( m_RecvPos >= m_RecvLength )
+			{
+				int n = c->pSocket->Receive( m_RecvBuffer, HTTP_POOL_RECV_BUFFER, 0 );
+				if ( n <= 0 )
+					break;
+				m_RecvPos = 0;
+				m_RecvLength = n;
+			}
+			if ( !putBody( sink, &m_RecvBuffer[ m_RecvPos ], m_RecvLength - m_RecvPos ) )
+				return 0;
+			m_RecvPos = m_RecvLength;
+		}
+	}
+
+	if ( pValidators != 0 )
+	{
+		// a 304 response may omit validators which are still valid
+		if ( status != 304 || received.eTag[ 0 ] )
+			strcpy( pValidators->eTag, received.eTag );
+		if ( status != 304 || received.lastModified[ 0 ] )
+			strcpy( pValidators->lastModified, received.lastModified );
+	}
+
+	return status;
+}
+
+unsigned CHTTPConnectionPool::get( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, const char *path, TBodySink *sink, THTTPValidators *pValidators )
+{
+	// a reused connection may have been closed by the server, in this case try once more with a new one
+	// (only if nothing has been received, the request must not reach the server twice)
+	for ( unsigned attempt = 0; attempt < 2; attempt++ )
+	{
+		boolean reused = false;
+		TConnection *c = getConnection( ipAddress, port, hostName, useTLS, reused );
+		if ( c == 0 )
+			return 0;
+
+		boolean keepAlive = false, resend = false;
+		sink->length = 0;
+		unsigned status = request( c, reused, path, sink, pValidators, keepAlive, resend );
+
+		if ( status == 0 )
+		{
+			closeConnection( c );
+			if ( resend )
+				continue;
+			return 0;
+		}
+
+		if ( keepAlive )
+		{
+			c->requests++;
+			c->lastUsed = CTimer::Get()->GetUptime();
+		} else
+			closeConnection( c );
+
+		return status;
+	}
+	return 0;
+}
+
+unsigned CHTTPConnectionPool::Get( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, const char *path, u8 *pBuffer, unsigned *pLength, THTTPValidators *pValidators )
+{
+	TBodySink sink = { pBuffer, *pLength, 0, 0, 0, 0 };
+	unsigned status = get( ipAddress, port, hostName, useTLS, path, &sink, pValidators );
+	*pLength = sink.length;
+	return status;
+}
+
+unsigned CHTTPConnectionPool::Get( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, const char *path, THTTPBodyHandler *pHandler, void *pParam, unsigned *pLength,
+								   THTTPRange *pRange, THTTPValidators *pValidators )
+{
+	TBodySink sink = { 0, 0, pHandler, pParam, 0, pRange };
+	unsigned status = get( ipAddress, port, hostName, useTLS, path, &sink, pValidators );
+	*pLength = sink.length;
+	return status;
+}
@@ -0,0 +1,155 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ httppool.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - pool of persistent (keep-alive) HTTP(S) connections
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _httppool_h
+#define _httppool_h
+
+#include <circle/net/netsubsystem.h>
+#include <circle/net/netsocket.h>
+#include <circle/net/ipaddress.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#ifdef WITH_TLS
+#include <circle-mbedtls/tlssimplesupport.h>
+using namespace CircleMbedTLS;
+#endif
+
+// number of connections kept open at the same time (SKTP server, CSDb, HVSC, WiC64 target...)
+#define HTTP_POOL_SIZE				4
+
+// idle connections are closed after this many seconds, unless the server announces
+// a shorter timeout with "Keep-Alive: timeout=n"
+#define HTTP_POOL_IDLE_TIMEOUT		10
+
+#define HTTP_POOL_RECV_BUFFER		2048
+
+// on a reused connection the response has to start within this many microseconds, otherwise the
+// request fails (a server which dropped the connection silently never answers). It is not sent
+// again, the server may have received it already
+#define HTTP_POOL_REUSED_TIMEOUT_US	10000000
+
+// receives the body of a response piece by piece as it arrives, returns false to abort the transfer
+typedef boolean THTTPBodyHandler( const u8 *pData, unsigned length, void *pParam );
+
+// validators of a cached response: sent as If-None-Match/If-Modified-Since (if set),
+// replaced by the ETag/Last-Modified header fields of the response
+typedef struct {
+	char eTag[ 128 ];
+	char lastModified[ 64 ];
+} THTTPValidators;
+
+// part of a resource: requested with "Range: bytes=offset-(offset+length-1)", 'length' 0 means up to the end.
+// On return 'offset' is where the body starts (0 if the server sent the whole resource with status 200)
+// and 'total' the size of the whole resource (0 if unknown)
+typedef struct {
+	unsigned offset;
+	unsigned length;
+	unsigned total;
+} THTTPRange;
+
+//
+// HTTP/1.1 GET requests over connections which are kept open between requests,
+// i.e. consecutive requests to the same host skip the TCP connect and (with WITH_TLS) the TLS handshake.
+// A request on a connection which has been closed by the server in the meantime is retried once on a new connection.
+//
+class CHTTPConnectionPool
+{
+public:
+#ifdef WITH_TLS
+	CHTTPConnectionPool( CNetSubSystem *pNet, CTLSSimpleSupport *pTLSSupport );
+#else
+	CHTTPConnectionPool( CNetSubSystem *pNet );
+#endif
+	~CHTTPConnectionPool();
+
+	// returns the HTTP status code (0 if no response has been received),
+	// *pLength is the buffer size on entry and the length of the body on return,
+	// with 'pValidators' the request is conditional and may return 304 (buffer untouched)
+	unsigned Get( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, const char *path, u8 *pBuffer, unsigned *pLength, THTTPValidators *pValidators = 0 );
+
+	// same, but the body is passed to 'pHandler' while it is being received, *pLength is its total length.
+	// With 'pRange' only a part is requested (status 206), 'pRange' is updated before the handler is called.
+	// With both, the validators are sent as If-Range when resuming, i.e. a modified resource is sent completely (200)
+	unsigned Get( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, const char *path, THTTPBodyHandler *pHandler, void *pParam, unsigned *pLength,
+				  THTTPRange *pRange = 0, THTTPValidators *pValidators = 0 );
+
+	// closes connections which have been idle for too long, should be called regularly
+	void CloseIdle();
+	void CloseAll();
+
+private:
+	typedef struct {
+		CNetSocket *pSocket;
+		CString hostName;
+		unsigned port;
+		CIPAddress ipAddress;
+		boolean useTLS;
+		unsigned lastUsed;			// uptime in seconds
+		unsigned idleTimeout;
+		unsigned requests;
+	} TConnection;
+
+	TConnection *getConnection( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, boolean &reused );
+	boolean openConnection( TConnection *c );
+	void closeConnection( TConnection *c );
+
+	// destination of a response body: either a buffer or a handler
+	typedef struct {
+		u8 *pBuffer;
+		unsigned maxLength;
+		THTTPBodyHandler *pHandler;
+		void *pParam;
+		unsigned length;
+		THTTPRange *pRange;
+	} TBodySink;
+
+	unsigned get( CIPAddress &ipAddress, unsigned port, const char *hostName, boolean useTLS, const char *path, TBodySink *sink, THTTPValidators *pValidators );
+	unsigned request( TConnection *c, boolean reused, const char *path, TBodySink *sink, THTTPValidators *pValidators, boolean &keepAlive, boolean &resend );
+	int waitForResponse( TConnection *c );
+	int readByte( TConnection *c );
+	boolean readLine( TConnection *c, char *line, unsigned maxLength );
+	boolean readBody( TConnection *c, TBodySink *sink, unsigned length );
+	boolean putBody( TBodySink *sink, const u8 *pData, unsigned length );
+
+	CNetSubSystem *m_pNet;
+#ifdef WITH_TLS
+	CTLSSimpleSupport *m_pTLSSupport;
+#endif
+	TConnection m_Connection[ HTTP_POOL_SIZE ];
+
+	// receive buffer of the current request
+	u8 m_RecvBuffer[ HTTP_POOL_RECV_BUFFER ];
+	unsigned m_RecvPos, m_RecvLength;
+};
+
+#endif
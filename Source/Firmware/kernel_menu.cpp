@@ -36,6 +36,9 @@
 #include "charlogo.h"
 
 #include <math.h>
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#endif
 
 // we will read these files
 static const char DRIVE[] = "SD:";
@@ -82,6 +85,41 @@ unsigned char *bitflagsRLE;
 u32 *animationState;
 u32 *animationStateInitial;
 
+// delta-frame animations (see Source/AnimationTool) are kept in animationRLE, the current frame in animationFrame
+#define ANIMATION_DELTA_MAGIC	0x44414b53
+#define ANIMATION_FRAME_BYTES	( 192 / 8 * 147 )
+static u32 animationDeltaFrames = 0;
+static u32 *animationDeltaOfs;
+static u8 *animationDeltaData;
+static u8 animationFrame[ ANIMATION_FRAME_BYTES ];
+static u8 animationRowDirty[ 147 ];
+static bool animationRedraw = true;
+
+// checks that every delta stream starts and ends within the data, so the decoder never reads beyond it
+static bool validateDeltaAnimation( const u8 *data, u32 dataSize, const u32 *ofs, u32 nFrames )
+{
+	for ( u32 t = 0; t < nFrames; t++ )
+	{
+		u32 p = ofs[ t ], pos = 0;
+		while ( pos < ANIMATION_FRAME_BYTES )
+		{
+			if ( p >= dataSize )
+				return false;
+			u32 op = data[ p++ ], n = ( op & 63 ) + 1;
+			switch ( op >> 6 )
+			{
+			case 0: pos += n; break;
+			case 3: pos += n * 64; break;
+			case 1: if ( p + n > dataSize ) return false;
+					p += n; pos += n; break;
+			case 2: if ( p + 1 > dataSize ) return false;
+					p ++; pos += n; break;
+			}
+		}
+	}
+	return true;
+}
+
 
 static u32	disableCart     = 0;
 static u32	resetCounter    = 0;
@@ -549,6 +587,27 @@ boolean CKernelMenu::Initialize( void )
 			readFile( logger, (char*)DRIVE, (char*)"SD:C64/animation.zap", tempX, &size ); 
 		} 
 
+		if ( showAnimation && *(u32*)tempX == ANIMATION_DELTA_MAGIC )
+		{
+			u16 *dims = (u16*)&tempX[ 4 ];
+			u32 headerSize = 12 + dims[ 2 ] * 4;
+
+			if ( dims[ 0 ] != 192 / 8 || dims[ 1 ] != 147 || dims[ 2 ] < 2 || 
+				 size > 128 * 1024 || size < headerSize + ANIMATION_FRAME_BYTES ||
+				 !validateDeltaAnimation( &tempX[ headerSize + ANIMATION_FRAME_BYTES ], size - headerSize - ANIMATION_FRAME_BYTES, (u32*)&tempX[ 12 ], dims[ 2 ] ) )
+			{
+				logger->Write( "RaspiMenu", LogWarning, "unsupported animation file" );
+				showAnimation = false;
+			} else
+			{
+				memcpy( animationRLE, tempX, size );
+				animationDeltaOfs = (u32*)&animationRLE[ 12 ];
+				memcpy( animationFrame, &animationRLE[ headerSize ], ANIMATION_FRAME_BYTES );
+				animationDeltaData = &animationRLE[ headerSize + ANIMATION_FRAME_BYTES ];
+				animationDeltaFrames = dims[ 2 ];
+				animationRedraw = true;
+			}
+		} else
 		if ( showAnimation )
 		{
 			u8 *temp = &tempX[ 0 ];
@@ -710,6 +769,13 @@ void injectPOKE( u32 a, u8 d )
 	cartMenu[ curAddr ++ ] = 0x10;							\
 	cartMenu[ curAddr ++ ] = ofs; }
 
+#define STA_X( addr ) { \
+	cartMenu[ curAddr ++ ] = 0x9D;							\
+	cartMenu[ curAddr ++ ] = (addr)&255;					\
+	cartMenu[ curAddr ++ ] = ((addr)>>8)&255; }
+
+#define DEX cartMenu[ curAddr ++ ] = 0xCA;
+
 #define NOP cartMenu[ curAddr ++ ] = 0xEA;
 #define RTS cartMenu[ curAddr ++ ] = 0x60;
 
@@ -726,41 +792,110 @@ u32 endOfBankAddress = 0xffff;
 // the text screen is converted to a bitmap (+ dilatation) for updating the background sprite layer
 unsigned char framebuffer[ 320 * 200 / 8 ];
 
+// the undilated bitmap is kept to update only character cells whose screen code changed,
+// its rows have zero padding on either side so that the dilation can read the neighbouring bytes
+#define SCREENBITMAP_PAD	8
+#define SCREENBITMAP_STRIDE	( 40 + 2 * SCREENBITMAP_PAD )
+
+static u8 screenBitmapRaw[ 200 ][ SCREENBITMAP_STRIDE ] AAA;
+static u8 screenBitmapHorz[ 1 + 200 + 1 ][ 40 ] AAA;	// horizontally dilated rows, plus an empty row above and below
+static u8 screenBitmapCodes[ 40 * 25 ];
+static u8 screenBitmapRowChanged[ 200 ];	// rows of the framebuffer which changed since the animation used them
+static u8 screenBitmapUppercase = 0;
+static bool screenBitmapValid = false;
+
+// pixels are stored MSB first: every pixel is spread to its neighbours within the byte and across byte boundaries
+static void dilateRowHorizontal( u8 *dst, const u8 *src )
+{
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+	for ( u32 i = 0; i < 32; i += 16 )
+	{
+		uint8x16_t c = vld1q_u8( src + i );
+		uint8x16_t h = vorrq_u8( c, vorrq_u8( vshlq_n_u8( c, 1 ), vshrq_n_u8( c, 1 ) ) );
+		h = vorrq_u8( h, vorrq_u8( vshlq_n_u8( vld1q_u8( src + i - 1 ), 7 ), vshrq_n_u8( vld1q_u8( src + i + 1 ), 7 ) ) );
+		vst1q_u8( dst + i, h );
+	}
+	uint8x8_t c = vld1_u8( src + 32 );
+	uint8x8_t h = vorr_u8( c, vorr_u8( vshl_n_u8( c, 1 ), vshr_n_u8( c, 1 ) ) );
+	h = vorr_u8( h, vorr_u8( vshl_n_u8( vld1_u8( src + 31 ), 7 ), vshr_n_u8( vld1_u8( src + 33 ), 7 ) ) );
+	vst1_u8( dst + 32, h );
+#else
+	for ( int i = 0; i < 40; i++ )
+		dst[ i ] = src[ i ] | ( src[ i ] << 1 ) | ( src[ i ] >> 1 ) | ( src[ i - 1 ] << 7 ) | ( src[ i + 1 ] >> 7 );
+#endif
+}
+
+static void dilateRowVertical( u8 *dst, const u8 *above, const u8 *row, const u8 *below )
+{
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+	for ( u32 i = 0; i < 32; i += 16 )
+		vst1q_u8( dst + i, vorrq_u8( vld1q_u8( row + i ), vorrq_u8( vld1q_u8( above + i ), vld1q_u8( below + i ) ) ) );
+	vst1_u8( dst + 32, vorr_u8( vld1_u8( row + 32 ), vorr_u8( vld1_u8( above + 32 ), vld1_u8( below + 32 ) ) ) );
+#else
+	for ( u32 i = 0; i < 40; i++ )
+		dst[ i ] = above[ i ] | row[ i ] | below[ i ];
+#endif
+}
+
 void convertScreenToBitmap( unsigned char *framebuffer )
 {
 	u32 columns = 40; 
 	u32 rows = 25;
 
-	memset( framebuffer, 0, 320 * 200 / 8 );
+	extern u8 c64screenUppercase;
+	const u8 *font = &charset[ 2048 - c64screenUppercase * 2048 ];
 
+	if ( !screenBitmapValid || screenBitmapUppercase != c64screenUppercase )
+	{
+		memset( screenBitmapRaw, 0, sizeof( screenBitmapRaw ) );
+		memset( screenBitmapHorz, 0, sizeof( screenBitmapHorz ) );
+		memset( screenBitmapCodes, 32, sizeof( screenBitmapCodes ) );
+		memset( framebuffer, 0, 320 * 200 / 8 );
+		memset( screenBitmapRowChanged, 1, sizeof( screenBitmapRowChanged ) );
+		screenBitmapUppercase = c64screenUppercase;
+		screenBitmapValid = true;
+	}
+
+	// update the character cells which have changed
+	u32 dirtyRows = 0;
 	for ( u32 j = 8; j < rows; j++ )
 	{
 		for ( u32 i = 1; i < columns-1; i++ )
 		{
 			unsigned char c = c64screen[ i + j * 40 ];
-			int x = i * 8;
-			int y = j * 8;
 
-			if ( c != 32 && c != ( 32 + 128 ) )
+			if ( c == screenBitmapCodes[ i + j * 40 ] )
+				continue;
+			screenBitmapCodes[ i + j * 40 ] = c;
+
 			for ( int b = 0; b < 8; b++ )
-			{
-				extern u8 c64screenUppercase;
-				unsigned char v = charset[ 2048 - c64screenUppercase * 2048 + c * 8 + b ];
-
-				u32 *p = (u32*)&framebuffer[ ( x / 8 - 1 ) + ( b + y ) * 320 / 8 ];
-				u32 m2 = ( (u32)v ) << 8;
-				m2 &= 0xff00;
-				u32 m = m2;
-				u8 *d = (u8*)&m;
-				d[ 1 ] = v;
-				d[ 0 ] = v >> 7;
-				d[ 1 ] |= v << 1;
-				d[ 1 ] |= v >> 1;
-				d[ 2 ] = ( v << 7 ) & 128;
-				*p |= m;
-				*( p + 320 / 8 / 4 ) |= m;
-				*( p - 320 / 8 / 4 ) |= m;
-			}
+				screenBitmapRaw[ j * 8 + b ][ SCREENBITMAP_PAD + i ] = ( c != 32 && c != ( 32 + 128 ) ) ? font[ c * 8 + b ] : 0;
+
+			dirtyRows |= 1 << j;
+		}
+	}
+
+	if ( !dirtyRows )
+		return;
+
+	// dilate the affected rows, vertically a character row also touches the pixel rows above and below
+	for ( u32 j = 8; j < rows; j++ )
+		if ( dirtyRows & ( 1 << j ) )
+			for ( u32 b = 0; b < 8; b++ )
+				dilateRowHorizontal( screenBitmapHorz[ 1 + j * 8 + b ], &screenBitmapRaw[ j * 8 + b ][ SCREENBITMAP_PAD ] );
+
+	int nextY = 0;
+	for ( u32 j = 8; j < rows; j++ )
+	{
+		if ( !( dirtyRows & ( 1 << j ) ) )
+			continue;
+
+		int y = maxsk( nextY, (int)j * 8 - 1 );
+		nextY = minsk( 200, (int)j * 8 + 9 );
+		for ( ; y < nextY; y++ )
+		{
+			dilateRowVertical( &framebuffer[ y * 320 / 8 ], screenBitmapHorz[ y ], screenBitmapHorz[ y + 1 ], screenBitmapHorz[ y + 2 ] );
+			screenBitmapRowChanged[ y ] = 1;
 		}
 	}
 }
@@ -858,6 +993,8 @@ static bool allSpeedCodeExecuted = false;
 static unsigned char bitmapPrev[ 64 * 64 ];
 unsigned char bitmap[ 64 * 64 ];
 static int ctn = 0;
+static int animationDelay = 0;
+static bool spriteTransferPending = false;
 
 static u32 menuSpeedCodeLength = 0;
 static u32 menuSpeedCodeMaxLength = 0x800;
@@ -878,6 +1015,501 @@ static int postDelayTicks = 0;
 
 static int disableFIQ_Falling = 0;
 
+//
+// speed code compiler for the screen and color RAM transfer:
+// changed cells are collected as runs (consecutive addresses, same value) in scan order until the
+// per-frame budget is used up, the remaining cells are transferred in the next frame(s).
+// The runs are emitted grouped by value with A, X and Y as value cache. Long runs become unrolled
+// STA abs,X fill loops whenever code size rather than C64 cycles is the tighter budget.
+//
+#define MENU_TRANSFER_CYCLES_PAL	4800
+#define MENU_TRANSFER_CYCLES_NTSC	4200
+#define MENU_FILL_MIN_RUN			12		// shortest run worth a fill loop
+#define MENU_FILL_UNROLL			4		// stores per loop iteration
+#define MENU_FILL_MAX_CHUNK			( 128 * MENU_FILL_UNROLL )	// X counts down from at most 127 (BPL)
+
+typedef struct
+{
+	u16 addr, len;
+	u8  value, fill;
+} MENURUN;
+
+static MENURUN menuRuns[ 2000 ];
+static u16 menuRunNext[ 2000 ];
+static u32 menuTransferBytes = 0, menuTransferCycles = 0;
+
+static void menuRunCost( u32 len, u32 fill, u32 &bytes, u32 &cycles )
+{
+	bytes = cycles = 0;
+	while ( len > 0 )
+	{
+		u32 m = minsk( len, (u32)MENU_FILL_MAX_CHUNK );
+		if ( fill && m >= MENU_FILL_MIN_RUN )
+		{
+			// LDX #q-1, unrolled STA abs,X, DEX, BPL (taken branches counted with page crossing), remainder STA abs
+			u32 q = m / MENU_FILL_UNROLL, r = m % MENU_FILL_UNROLL;
+			bytes  += 2 + 3 * MENU_FILL_UNROLL + 1 + 2 + 3 * r;
+			cycles += 2 + q * ( 5 * MENU_FILL_UNROLL + 2 + 4 ) - 2 + 4 * r;
+		} else
+		{
+			bytes  += 3 * m;
+			cycles += 4 * m;
+		}
+		len -= m;
+	}
+}
+
+// returns the screen offset where the transfer continues in the next frame
+static int compileScreenTransfer( u32 &curAddr, u32 &curValA, u32 &curValX, int curOfs, u32 maxBytes, u32 maxCycles, u8 *vdcDirtyFlags, bool &wrapped )
+{
+	u32 nRuns = 0, bytes = 0, cycles = 0;
+	s32 openRun[ 2 ] = { -1, -1 };
+	u8 valueUsed[ 256 ];
+	memset( valueUsed, 0, 256 );
+
+	wrapped = false;
+	for ( int n = 0; n < 1000; n++ )
+	{
+		for ( int k = 0; k < 2; k++ )
+		{
+			u8 *cur  = k ? c64color : c64screen;
+			u8 *prev = k ? c64colorPrev : c64screenPrev;
+			u8 v = cur[ curOfs ];
+
+			if ( v == prev[ curOfs ] )
+			{
+				openRun[ k ] = -1;
+				continue;
+			}
+
+			MENURUN *r = NULL;
+			if ( openRun[ k ] >= 0 && menuRuns[ openRun[ k ] ].value == v )
+				r = &menuRuns[ openRun[ k ] ];
+
+			u32 fill = 0, oldB = 0, oldC = 0, newB = 3, newC = 4;
+			if ( r )
+			{
+				fill = r->fill;
+				// decide once a run is long enough: fill loops save code size, but cost cycles
+				if ( r->len + 1 == MENU_FILL_MIN_RUN )
+					fill = (u64)bytes * maxCycles > (u64)cycles * maxBytes;
+				menuRunCost( r->len, r->fill, oldB, oldC );
+				menuRunCost( r->len + 1, fill, newB, newC );
+			}
+
+			// first store of a value needs a load
+			u32 load = valueUsed[ v ] ? 0 : 2;
+			u32 nextBytes  = bytes + newB + load - oldB;
+			u32 nextCycles = cycles + newC + load - oldC;
+
+			if ( nextBytes > maxBytes || nextCycles > maxCycles )
+				goto budgetUsedUp;
+
+			bytes = nextBytes;
+			cycles = nextCycles;
+			valueUsed[ v ] = 1;
+
+			if ( r )
+			{
+				r->len ++;
+				r->fill = fill;
+			} else
+			{
+				r = &menuRuns[ nRuns ];
+				r->addr  = ( k ? 0xd800 : 0x0400 ) + curOfs;
+				r->len   = 1;
+				r->value = v;
+				r->fill  = 0;
+				openRun[ k ] = nRuns ++;
+			}
+
+			prev[ curOfs ] = v;
+			vdcDirtyFlags[ k * 25 + curOfs / 40 ] = 1;
+		}
+
+		if ( ++ curOfs >= 1000 )
+		{
+			curOfs = 0;
+			wrapped = true;
+			openRun[ 0 ] = openRun[ 1 ] = -1;
+		}
+	}
+
+budgetUsedUp:
+	u16 firstRun[ 256 ];
+	memset( firstRun, 0xff, sizeof( firstRun ) );
+	for ( u32 i = 0; i < nRuns; i++ )
+	{
+		menuRunNext[ i ] = firstRun[ menuRuns[ i ].value ];
+		firstRun[ menuRuns[ i ].value ] = i;
+	}
+
+	// value cache: A, X, Y
+	const u8 opLoad[ 3 ]  = { 0xA9, 0xA2, 0xA0 };
+	const u8 opStore[ 3 ] = { 0x8D, 0x8E, 0x8C };
+	u32 reg[ 3 ] = { curValA, curValX, 0xffff };
+	u32 lastUse[ 3 ] = { 0, 0, 0 }, useCount = 0;
+
+	u32 startAddr = curAddr;
+
+	// values with fill loops first: they need A for the value and X as loop counter
+	for ( int pass = 0; pass < 2; pass++ )
+		for ( int v = 0; v < 256; v++ )
+		{
+			if ( firstRun[ v ] == 0xffff )
+				continue;
+
+			u32 hasFill = 0;
+			for ( u16 i = firstRun[ v ]; i != 0xffff; i = menuRunNext[ i ] )
+				hasFill |= menuRuns[ i ].fill;
+
+			if ( hasFill != ( pass == 0 ? 1u : 0u ) )
+				continue;
+
+			int rg = 0;
+			if ( !hasFill )
+			{
+				rg = -1;
+				for ( int j = 0; j < 3; j++ )
+					if ( reg[ j ] == (u32)v ) rg = j;
+				if ( rg < 0 )
+				{
+					rg = 0;
+					for ( int j = 1; j < 3; j++ )
+						if ( lastUse[ j ] < lastUse[ rg ] ) rg = j;
+				}
+			}
+
+			if ( reg[ rg ] != (u32)v )
+			{
+				cartMenu[ curAddr ++ ] = opLoad[ rg ];
+				cartMenu[ curAddr ++ ] = v;
+				reg[ rg ] = v;
+			}
+			lastUse[ rg ] = ++ useCount;
+
+			for ( u16 i = firstRun[ v ]; i != 0xffff; i = menuRunNext[ i ] )
+			{
+				u32 addr = menuRuns[ i ].addr, len = menuRuns[ i ].len;
+				while ( len > 0 )
+				{
+					u32 m = minsk( len, (u32)MENU_FILL_MAX_CHUNK );
+					len -= m;
+					if ( menuRuns[ i ].fill && m >= MENU_FILL_MIN_RUN )
+					{
+						u32 q = m / MENU_FILL_UNROLL;
+						LDX( q - 1 );
+						for ( u32 u = 0; u < MENU_FILL_UNROLL; u++ )
+							STA_X( addr + u * q );
+						DEX
+						BPL( ( 256 - ( 3 * MENU_FILL_UNROLL + 1 + 2 ) ) & 255 );
+						reg[ 1 ] = 255;
+						lastUse[ 1 ] = useCount;
+						addr += q * MENU_FILL_UNROLL;
+						m -= q * MENU_FILL_UNROLL;
+					}
+					for ( ; m > 0; m--, addr++ )
+					{
+						cartMenu[ curAddr ++ ] = opStore[ rg ];
+						cartMenu[ curAddr ++ ] = addr & 255;
+						cartMenu[ curAddr ++ ] = ( addr >> 8 ) & 255;
+					}
+				}
+			}
+		}
+
+	curValA = reg[ 0 ];
+	curValX = reg[ 1 ];
+
+	menuTransferBytes  = curAddr - startAddr;
+	menuTransferCycles = cycles;
+
+	return curOfs;
+}
+
+//
+// speed code compiler for the VDC transfer (C128 80-column output):
+// a shadow of the VDC screen and attribute memory is compared to the screen, the changed spans within
+// each line are transferred using the VDC block copy (e.g. a list scrolling by one line copies the line
+// from its neighbour), block fill for runs of equal bytes, and single writes for the rest.
+// The number of VDC register accesses per frame is limited, the remaining lines follow in the next frame(s).
+//
+#define VDC_ACCESSES_PER_FRAME	400
+#define VDC_SPAN_MAX_GAP		2		// unchanged bytes bridged instead of setting the update address again
+#define VDC_FILL_MIN_RUN		4
+#define VDC_COPY_MIN_LEN		6
+#define VDC_ATTRIBUTE_ADDR		0x0800
+
+static u16 vdcShadow[ 2 ][ 1000 ];		// screen codes and attributes in VDC memory, 0xffff = unknown
+static u8  vdcWanted[ 2 ][ 1000 ];
+static int vdcCurRow = 0;
+static bool vdcAllRowsDone = true;
+
+typedef struct
+{
+	u32 addr;			// update address (R18/R19), 0xffff = unknown
+	u32 valA;
+	u8  reg;			// selected register, 0xff = unknown
+	u8  blockMode;		// R24 bit 7: 0x00 fill, 0x80 copy, 0xff = unknown
+	u32 accesses;
+} VDCSTATE;
+
+// X holds 31 (data register) during the VDC transfer, Y is used for register numbers and parameters
+static void vdcWriteRegister( u32 &curAddr, VDCSTATE &s, u8 reg, u8 data, bool emit )
+{
+	if ( emit )
+	{
+		if ( s.reg != reg )
+		{
+			LDY( reg );
+			STY( 0xd600 );
+		}
+		LDY( data );
+		BIT_( 0xd600 );
+		BPL( 0xfb );
+		STY( 0xd601 );
+	}
+	s.reg = reg;
+	s.accesses ++;
+}
+
+static void vdcWriteData( u32 &curAddr, VDCSTATE &s, u8 data, bool emit )
+{
+	if ( emit )
+	{
+		if ( s.reg != 31 )
+			STX( 0xd600 );
+		if ( s.valA != data )
+			LDA( data );
+		BIT_( 0xd600 );
+		BPL( 0xfb );
+		STA( 0xd601 );
+	}
+	s.reg = 31;
+	s.valA = data;
+	s.addr ++;
+	s.accesses ++;
+}
+
+static void vdcSetAddress( u32 &curAddr, VDCSTATE &s, u32 addr, bool emit )
+{
+	if ( s.addr == addr )
+		return;
+	vdcWriteRegister( curAddr, s, 19, addr & 255, emit );
+	vdcWriteRegister( curAddr, s, 18, addr >> 8, emit );
+	s.addr = addr;
+}
+
+// R24 also contains the reverse, blink and vertical scroll settings: read-modify-write
+static void vdcSetBlockMode( u32 &curAddr, VDCSTATE &s, u8 mode, bool emit )
+{
+	if ( s.blockMode == mode )
+		return;
+	if ( emit )
+	{
+		if ( s.reg != 24 )
+		{
+			LDY( 24 );
+			STY( 0xd600 );
+		}
+		BIT_( 0xd600 );
+		BPL( 0xfb );
+		cartMenu[ curAddr ++ ] = 0xAD; // LDA $d601
+		cartMenu[ curAddr ++ ] = 0x01;
+		cartMenu[ curAddr ++ ] = 0xd6;
+		if ( mode )
+		{
+			cartMenu[ curAddr ++ ] = 0x09; // ORA #$80
+			cartMenu[ curAddr ++ ] = 0x80;
+		} else
+		{
+			cartMenu[ curAddr ++ ] = 0x29; // AND #$7f
+			cartMenu[ curAddr ++ ] = 0x7f;
+		}
+		BIT_( 0xd600 );
+		BPL( 0xfb );
+		STA( 0xd601 );
+	}
+	s.reg = 24;
+	s.valA = 0xffff;
+	s.blockMode = mode;
+	s.accesses += 2;
+}
+
+// transfers the bytes [a, b] of a line, the shadow is only updated when emitting code
+static void vdcTransferSpan( u32 &curAddr, VDCSTATE &s, int plane, int row, int a, int b, bool emit )
+{
+	const u8 *want = &vdcWanted[ plane ][ row * 40 ];
+	u16 *shadow = vdcShadow[ plane ];
+	u32 base = plane ? VDC_ATTRIBUTE_ADDR : 0;
+	int len = b - a + 1;
+
+	vdcSetAddress( curAddr, s, base + row * 40 + a, emit );
+
+	// same bytes in another line of VDC memory (nearest first): block copy
+	int src = -1;
+	if ( len >= VDC_COPY_MIN_LEN )
+		for ( int d = 1; d < 25 && src < 0; d++ )
+			for ( int k = row - d; k <= row + d && src < 0; k += 2 * d )
+			{
+				if ( k < 0 || k >= 25 )
+					continue;
+				int i = a;
+				while ( i <= b && shadow[ k * 40 + i ] == want[ i ] )
+					i ++;
+				if ( i > b )
+					src = k;
+			}
+
+	if ( src >= 0 )
+	{
+		u32 srcAddr = base + src * 40 + a;
+		vdcSetBlockMode( curAddr, s, 0x80, emit );
+		vdcWriteRegister( curAddr, s, 32, srcAddr >> 8, emit );
+		vdcWriteRegister( curAddr, s, 33, srcAddr & 255, emit );
+		vdcWriteRegister( curAddr, s, 30, len, emit );
+		s.addr += len;
+	} else
+	{
+		for ( int i = a; i <= b; )
+		{
+			int run = 1;
+			while ( i + run <= b && want[ i + run ] == want[ i ] )
+				run ++;
+
+			// the first byte is written as usual, the block fill repeats it
+			vdcWriteData( curAddr, s, want[ i ], emit );
+			if ( run >= VDC_FILL_MIN_RUN )
+			{
+				vdcSetBlockMode( curAddr, s, 0x00, emit );
+				vdcWriteRegister( curAddr, s, 30, run - 1, emit );
+				s.addr += run - 1;
+				i += run;
+			} else
+				i ++;
+		}
+	}
+
+	if ( emit )
+		for ( int i = a; i <= b; i++ )
+			shadow[ row * 40 + i ] = want[ i ];
+}
+
+// the block copy mode is not left behind for other code which writes to the VDC (the transfer ends in fill mode);
+// its 2 register accesses are included in VDC_ACCESSES_PER_FRAME
+static u32 vdcEndAccesses( const VDCSTATE &s )
+{
+	return s.accesses + ( s.blockMode == 0x80 ? 2 : 0 );
+}
+
+static void vdcEndTransfer( u32 &curAddr, VDCSTATE &s )
+{
+	if ( s.blockMode == 0x80 )
+		vdcSetBlockMode( curAddr, s, 0x00, true );
+}
+
+// true if line k in VDC memory contains what line j should show
+static bool vdcLineInShadow( int plane, int j, int k )
+{
+	const u8 *want = &vdcWanted[ plane ][ j * 40 ];
+	const u16 *shadow = &vdcShadow[ plane ][ k * 40 ];
+	for ( int i = 0; i < 40; i++ )
+		if ( shadow[ i ] != want[ i ] )
+			return false;
+	return true;
+}
+
+static void compileVDCTransfer( u32 &curAddr, u8 *vdcDirtyFlags )
+{
+	extern u8 c64screenUppercase;
+	static u8 lastUppercase = 0xff;
+
+	const unsigned char vdcColorConversion[ 16 ] = {
+		0x00, 0x0f, 0x08, 0x07, 0x0a, 0x04, 0x02, 0x0d, 0x0e, 0x0c, 0x09, 0x01, 0x01, 0x05, 0x03, 0x0e
+	};
+
+	if ( lastUppercase != c64screenUppercase )
+	{
+		lastUppercase = c64screenUppercase;
+		memset( &vdcDirtyFlags[ 25 ], 1, 25 );
+	}
+
+	// the menu code might change the attributes of lines 0 and 2, send them again
+	for ( int i = 0; i < 40; i++ )
+		vdcShadow[ 1 ][ 0 * 40 + i ] = vdcShadow[ 1 ][ 2 * 40 + i ] = 0xffff;
+
+	memcpy( vdcWanted[ 0 ], c64screen, 1000 );
+	for ( int i = 0; i < 1000; i++ )
+		vdcWanted[ 1 ][ i ] = vdcColorConversion[ c64color[ i ] & 15 ] | ( c64screenUppercase ? 0 : 0x80 );
+
+	// lines are processed such that block copy sources are not overwritten before they are used:
+	// top to bottom when the content moves up, bottom to top when it moves down
+	int movedUp = 0, movedDown = 0;
+	for ( int j = 0; j < 25; j++ )
+		if ( vdcDirtyFlags[ j ] )
+		{
+			if ( j < 24 && vdcLineInShadow( 0, j, j + 1 ) ) movedUp ++;
+			if ( j > 0 && vdcLineInShadow( 0, j, j - 1 ) ) movedDown ++;
+		}
+	int dir = movedDown > movedUp ? -1 : 1;
+	if ( vdcAllRowsDone )
+		vdcCurRow = dir > 0 ? 0 : 24;
+
+	VDCSTATE s = { 0xffff, 0xffff, 0xff, 0xff, 0 };
+
+	LDX( 31 );
+
+	vdcAllRowsDone = false;
+	for ( int n = 0; n < 25; n++ )
+	{
+		for ( int plane = 0; plane < 2; plane++ )
+		{
+			int row = vdcCurRow;
+			if ( !vdcDirtyFlags[ plane * 25 + row ] )
+				continue;
+
+			const u8 *want = &vdcWanted[ plane ][ row * 40 ];
+			const u16 *shadow = &vdcShadow[ plane ][ row * 40 ];
+
+			for ( int i = 0; i < 40; )
+			{
+				if ( shadow[ i ] == want[ i ] )
+				{
+					i ++;
+					continue;
+				}
+
+				// span of changed bytes, short gaps of unchanged bytes are included
+				int a = i, b = i, gap = 0;
+				for ( i ++; i < 40 && gap <= VDC_SPAN_MAX_GAP; i++ )
+				{
+					if ( shadow[ i ] != want[ i ] )
+					{
+						b = i;
+						gap = 0;
+					} else
+						gap ++;
+				}
+				i = b + 1;
+
+				VDCSTATE t = s;
+				vdcTransferSpan( curAddr, t, plane, row, a, b, false );
+				if ( vdcEndAccesses( t ) > VDC_ACCESSES_PER_FRAME )
+				{
+					vdcEndTransfer( curAddr, s );
+					return;
+				}
+
+				vdcTransferSpan( curAddr, s, plane, row, a, b, true );
+			}
+			vdcDirtyFlags[ plane * 25 + row ] = 0;
+		}
+		vdcCurRow = ( vdcCurRow + dir + 25 ) % 25;
+	}
+	vdcEndTransfer( curAddr, s );
+	vdcAllRowsDone = true;
+}
+
 #ifdef WITH_NET
 void CKernelMenu::SplashScreenTFT( void )
 {
@@ -916,9 +1548,12 @@ void CKernelMenu::Run( void )
 	doneWithHandling = 1;
 	firstMenu = firstSprites = 1;
 	startAfterReset = 1;
+	screenBitmapValid = false;
 
 	memset( bitmapPrev, 255, 64 * 64 );
 	ctn = 0;
+	animationDelay = 0;
+	spriteTransferPending = false;
 
 	menuSpeedCodeLength = 0;
 	menuSpeedCodeMaxLength = 0x800;
@@ -1229,7 +1864,7 @@ void CKernelMenu::Run( void )
 				memcpy( tftBackground, tftC128Logo, 240 * 240 * 2 );
 				flush4BitBuffer( true );
 				tftCopyBackground2Framebuffer();
-				tftSendFramebuffer16BitImm( tftFrameBuffer );
+				tftUpdateFramebuffer16BitImm( tftFrameBuffer );
 			}
 
 			startForC128 = 0;
@@ -1293,6 +1928,7 @@ void CKernelMenu::Run( void )
 				isFirstSKTPScreen = m_SidekickNet.isFirstSKTPScreen();
 				if (isFirstSKTPScreen){
 					memset( bitmap, 0, 64 * 64 );
+					animationRedraw = true;
 					//showAnimation = false;
 				}
 			}
@@ -1310,10 +1946,14 @@ void CKernelMenu::Run( void )
 				if ( currentVDCMode == 1 )
 				{
 					memset( bitmap, 0, 64 * 64 );
+					animationRedraw = true;
 				} else
 				{
-					if ( skinValues.SKIN_BACKGROUND_GFX_SPEED <= 1 || ( ( ctn % skinValues.SKIN_BACKGROUND_GFX_SPEED ) == 0 ) )
+					// the next animation frame is only decoded when the previous one has completely been
+					// transferred to the sprites, i.e. the frame rate drops instead of mixing frames
+					if ( ++ animationDelay >= skinValues.SKIN_BACKGROUND_GFX_SPEED && !spriteTransferPending )
 					{
+						animationDelay = 0;
 						#include "render_sprite_animation.h"
 					}
 				}
@@ -1413,7 +2053,7 @@ void CKernelMenu::Run( void )
 				if ( postDelayFrame ) postDelayFrame ++;
 			}
 
-			u8 vdcDirtyFlags[ 50 ]; // 25 lines of chars and attributes
+			static u8 vdcDirtyFlags[ 50 ]; // 25 lines of chars and attributes
 			if ( firstMenu ) 
 			{
 				firstMenu = 0;
@@ -1423,6 +2063,7 @@ void CKernelMenu::Run( void )
 					c64colorPrev[ i ] = 255;
 				}
 				memset( vdcDirtyFlags, 1, 50 );
+				memset( vdcShadow, 0xff, sizeof( vdcShadow ) );
 			} else
 			{
 				// always update one line in color RAM where the menu code might change it
@@ -1437,6 +2078,8 @@ void CKernelMenu::Run( void )
 
 			int nBytesToTransfer = 1000;
 
+			menuTransferBytes = menuTransferCycles = 0;
+
 			if ( currentVDCMode == 2 )
 			{
 				for ( int j = 0; j < 25; j++ )
@@ -1467,54 +2110,20 @@ void CKernelMenu::Run( void )
 				nextLine:;
 				}
 			} else
-			while ( nBytesToTransfer > 0 )
 			{
-				nBytesToTransfer--;
-
-				u8 byteA = c64screen[ curOfs ];
-				u8 byteX = c64color[ curOfs ];
-
-				if ( byteA != c64screenPrev[ curOfs ] )
-				{
-					c64screenPrev[ curOfs ] = byteA;
-					if ( byteA != curValA )
-					{
-						curValA = byteA;
-						LDA( byteA );
-					}
-					STA( 0x400 + curOfs );
+				u32 maxCycles = ( modePALNTSC == 1 || modePALNTSC == 2 ) ? MENU_TRANSFER_CYCLES_NTSC : MENU_TRANSFER_CYCLES_PAL;
+				u32 endAddr = 0x2000 + menuSpeedCodeMaxLength - 10;
+				bool wrapped;
 
-					vdcDirtyFlags[ curOfs / 40 ] = 1;
-				}
+				curOfs = compileScreenTransfer( curAddr, curValA, curValX, curOfs, endAddr > curAddr ? endAddr - curAddr : 0, maxCycles, vdcDirtyFlags, wrapped );
 
-				if ( byteX != c64colorPrev[ curOfs ] )
+				if ( wrapped && firstRunAfterReset )
 				{
-					c64colorPrev[ curOfs ] = byteX;
-					if ( byteX != curValX )
-					{
-						curValX = byteX;
-						LDX( byteX );
-					}
-					STX( 0xd800 + curOfs );
-					vdcDirtyFlags[ 25 + curOfs / 40 ] = 1;
-				}
-
-				if ( curAddr >= 0x2000 + menuSpeedCodeMaxLength - 10 )
-					goto cantCopyEverythingThisTimeText;
-
-				curOfs += ofsIncr;
-				if ( curOfs >= 1000 )
-				{
-					curOfs = 0;
-					if ( firstRunAfterReset )
-					{
-						firstSprites = 1;
-						firstRunAfterReset = 0;
-					}
+					firstSprites = 1;
+					firstRunAfterReset = 0;
 				}
 			}
 
-		cantCopyEverythingThisTimeText:
 			lastCurOfsText = curOfs;
 
 			extern u32 showLogo;
@@ -1576,133 +2185,14 @@ void CKernelMenu::Run( void )
 
 			// generate code for VDC-update
 			if ( currentVDCMode )
-			{
-				// next line of chars/attributes to update
-				static int vdcCurPosChar = 0;
-				static int vdcCurPosAttr = 0;
-
-				/*int nUpdates = 0;
-				for ( int i = 0; i < 50; i++ )
-					nUpdates += vdcDirtyFlags[ i ];
-
-				static int forcedUpdatePosition = 0;
-				if ( nUpdates < 10 )
-				{
-					for ( int i = 0; i < 2; i++ )
-					{
-						vdcDirtyFlags[ forcedUpdatePosition ] =
-						vdcDirtyFlags[ forcedUpdatePosition + 25 ] = 1;
-						forcedUpdatePosition ++;
-						forcedUpdatePosition %= 25;
-					}
-				}*/
-
-				#define VDC_WRITE( reg, data ) \
-					LDY( reg );		\
-					STY( 0xd600 );	\
-					LDY( data );	\
-					BIT_( 0xd600 );	\
-					BPL( 0xfb );	\
-					STY( 0xd601 );
-
-				int nLines = 5, nLinesScanned = 0, lastTransferredLine = -1;
-
-				curValA = 0xffff;
-
-				LDX( 31 );
-				while ( nLines > 0 && nLinesScanned < 25 )
-				{
-					if ( vdcDirtyFlags[ vdcCurPosChar ] )
-					{
-						// first line at all, start of screen or jump in address
-						if ( lastTransferredLine <= 0 || ((lastTransferredLine+1)%25) != vdcCurPosChar )
-						{
-							int ofs = vdcCurPosChar * 40;
-							VDC_WRITE( 19, ( ofs & 255 ) );
-							VDC_WRITE( 18, ( ofs >> 8 ) );
-						}
-						lastTransferredLine = vdcCurPosChar;
-						
-						u8 *src = &c64screen[ vdcCurPosChar * 40 ];
-						for ( int i = 0; i < 40; i++ )
-						{
-							u8 byteA = *(src++);
-				
-							STX( 0xd600 );
-
-							if ( byteA != curValA )
-							{
-								curValA = byteA;
-								LDA( byteA );
-							}
-
-							BIT_( 0xd600 );
-							BPL( 0xfb );
-							STA( 0xd601 );
-						}
-						vdcDirtyFlags[ vdcCurPosChar ] = 0;
-						nLines --;
-					}
-					vdcCurPosChar ++;
-					vdcCurPosChar %= 25;
-					nLinesScanned ++;
-				}
-
-				nLines = 5;
-				nLinesScanned = 0;
-				lastTransferredLine = -1;
-
-				const unsigned char vdcColorConversion[ 16 ] = {
-				    0x00, 0x0f, 0x08, 0x07, 0x0a, 0x04, 0x02, 0x0d, 0x0e, 0x0c, 0x09, 0x01, 0x01, 0x05, 0x03, 0x0e
-				};
-
-				curValA = 0xffff;
-
-				LDX( 31 );
-				while ( nLines > 0 && nLinesScanned < 25 )
-				{
-					if ( vdcDirtyFlags[ 25 + vdcCurPosAttr ] )
-					{
-						// first line at all, start of screen or jump in address
-						if ( lastTransferredLine <= 0 || ((lastTransferredLine+1)%25) != vdcCurPosAttr )
-						{
-							int ofs = vdcCurPosAttr * 40;
-							VDC_WRITE( 19, ( ofs & 255 ) );
-							VDC_WRITE( 18, ( 8 + ( ofs >> 8 ) ) );
-						}
-						lastTransferredLine = vdcCurPosAttr;
-						
-						u8 *src = &c64color[ vdcCurPosAttr * 40 ];
-						for ( int i = 0; i < 40; i++ )
-						{
-							u8 byteA = *(src++) & 15;
-
-							STX( 0xd600 );
-
-							if ( byteA != curValA )
-							{
-								curValA = byteA;
-								extern u8 c64screenUppercase;
-								LDA( vdcColorConversion[ byteA ] | ((~c64screenUppercase)<<7) );
-							}
-
-							BIT_( 0xd600 );
-							BPL( 0xfb );
-							STA( 0xd601 );
-						}
-						vdcDirtyFlags[ 25 + vdcCurPosAttr ] = 0;
-						nLines --;
-					}
-					vdcCurPosAttr ++;
-					vdcCurPosAttr %= 25;
-					nLinesScanned ++;
-				}
-
-			}			
-
+				compileVDCTransfer( curAddr, vdcDirtyFlags );
 
 			menuSpeedCodeLength = curAddr - 0x2000;
 
+			// fill loops run longer than their code size suggests, the sprite transfer budget is based on time
+			if ( menuTransferCycles * 3 / 4 > menuTransferBytes )
+				menuSpeedCodeLength += menuTransferCycles * 3 / 4 - menuTransferBytes;
+
 			// payload
 			if ( firstSprites ) 
 			{
@@ -1731,6 +2221,7 @@ void CKernelMenu::Run( void )
 			}
 
 			nBytesToTransfer = 7 * 8 * 64;
+			spriteTransferPending = false;
 
 			// transfer animation only if VIC-output is active
 #ifdef WITH_NET
@@ -1769,7 +2260,10 @@ void CKernelMenu::Run( void )
 				}
 
 				if ( curAddr >= animationStartAddr + speedCodeMaxLength - 10 )
+				{
+					spriteTransferPending = true;
 					goto cantCopyEverythingThisTime2;
+				}
 
 				curOfs += ofsIncr;
 				curOfs %= 56 * 64;
@@ -868,6 +868,8 @@ void CKernelMenu::Run( void )
 		
 		if ( cfgVIC_Emulation )
 		{
+			flushLinesVIC656x();
+
 			{
 				const u32 visX = 16, visY = 8;
 				static u8 w2do = 0;
@@ -42,12 +42,16 @@ u32 latchDOld;
 u8 i2cBuffer[ FAKE_I2C_BUF_SIZE ] AAA;
 u32 i2cBufferCountLast, i2cBufferCountCur;
 
+// state of the SPI byte event being expanded by prepareOutputLatch4Bit
+u32 spiByte, spiBit, spiRepeat, spiPhase;
+
 void initLatch()
 {
 	latchD = 0;
 	latchClr = latchSet = 0;
 	latchDOld = 0xFFFFFFFF;
 	i2cBufferCountLast = i2cBufferCountCur = 0;
+	spiBit = 0;
 	//putI2CCommand( 0 );
 }
 
@@ -89,6 +89,12 @@ extern void initLatch();
 extern u8 i2cBuffer[ FAKE_I2C_BUF_SIZE ];
 extern u32 i2cBufferCountLast, i2cBufferCountCur;
 
+// 4-bit commands with bit 1 set are byte events: the drain expands an SPI byte (SCK/SDA, MSB first)
+// into its transitions itself, only those which change a line, optionally repeated (fills)
+#define LATCH4_SPI_BYTE		2		// + 2 nibbles: byte
+#define LATCH4_SPI_RUN		3		// + 2 nibbles: repeat count - 1, + 2 nibbles: byte
+extern u32 spiByte, spiBit, spiRepeat, spiPhase;
+
 #define DELAY(rounds) \
 	for ( int i = 0; i < rounds; i++ ) { \
 		asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" );	asm volatile( "nop" ); }
@@ -181,6 +187,40 @@ static __attribute__( ( always_inline ) ) inline void put4BitCommand( u32 c )
 	i2cBufferCountCur &= ( FAKE_I2C_BUF_SIZE - 1 );
 }
 
+static __attribute__( ( always_inline ) ) inline void set4BitEntry( u32 pos, u32 c )
+{
+	pos &= ( FAKE_I2C_BUF_SIZE - 1 );
+	u32 memOfs = pos >> 1;
+	u8  bitOfs = (pos & 1 ) << 2; 
+	u8  v = i2cBuffer[ memOfs ];
+	v &= ~( 15 << bitOfs );
+	v |= ( c & 15 ) << bitOfs;
+	i2cBuffer[ memOfs ] = v;
+}
+
+// queues an SPI byte, 'count' times (1..256), as one event of 3 or 5 nibbles
+static __attribute__( ( always_inline ) ) inline void put4BitByte( u8 d, u32 count = 1 )
+{
+	u32 cur = i2cBufferCountCur;
+	if ( count <= 1 )
+	{
+		set4BitEntry( cur, LATCH4_SPI_BYTE );
+		cur ++;
+	} else
+	{
+		set4BitEntry( cur, LATCH4_SPI_RUN );
+		set4BitEntry( cur + 1, ( count - 1 ) >> 4 );
+		set4BitEntry( cur + 2, ( count - 1 ) & 15 );
+		cur += 3;
+	}
+	set4BitEntry( cur, d >> 4 );
+	set4BitEntry( cur + 1, d & 15 );
+
+	// the event becomes visible to the drain only with all of its nibbles
+	asm volatile( "" ::: "memory" );
+	i2cBufferCountCur = ( cur + 2 ) & ( FAKE_I2C_BUF_SIZE - 1 );
+}
+
 static __attribute__( ( always_inline ) ) inline u32 get4BitCommand()
 {
 	u32 memOfs = i2cBufferCountLast >> 1;
@@ -195,7 +235,7 @@ static __attribute__( ( always_inline ) ) inline u32 get4BitCommand()
 
 static __attribute__( ( always_inline ) ) inline boolean bufferEmptyI2C()
 {
-	return ( i2cBufferCountLast == i2cBufferCountCur );
+	return ( i2cBufferCountLast == i2cBufferCountCur ) && spiBit == 0;
 }
 
 static __attribute__( ( always_inline ) ) inline u32 bufferIsFreeI2C()
@@ -285,15 +325,66 @@ static __attribute__( ( always_inline ) ) inline void flushI2CBuffer( bool witho
 static __attribute__( ( always_inline ) ) inline void clearI2CBuffer()
 {
 	i2cBufferCountLast = i2cBufferCountCur = 0;
+	spiBit = 0;
+}
+
+// next step of the current SPI byte event, returns false if no line had to change
+static __attribute__( ( always_inline ) ) inline bool stepSPIByte()
+{
+	if ( spiPhase == 0 )		// SCK low
+	{
+		spiPhase = 1;
+		if ( !( latchD & LATCH_SCL ) )
+			return false;
+		latchD &= ~LATCH_SCL;
+	} else
+	if ( spiPhase == 1 )		// SDA, if different
+	{
+		spiPhase = 2;
+		u32 sda = ( spiByte & spiBit ) ? LATCH_SDA : 0;
+		if ( ( latchD & LATCH_SDA ) == sda )
+			return false;
+		latchD ^= LATCH_SDA;
+	} else						// SCK high
+	{
+		spiPhase = 0;
+		latchD |= LATCH_SCL;
+		spiBit >>= 1;
+		if ( spiBit == 0 && spiRepeat )
+		{
+			spiRepeat --;
+			spiBit = 0x80;
+		}
+	}
+	return true;
 }
 
 static __attribute__( ( always_inline ) ) inline void prepareOutputLatch4Bit()
 {
+	while ( spiBit )
+		if ( stepSPIByte() ) return;
+
 	test:
 	if ( !bufferEmptyI2C() )
 	{
 		u32 v = get4BitCommand();
 
+		if ( v & 2 )
+		{
+			spiRepeat = 0;
+			if ( v & 1 )
+			{
+				spiRepeat  = get4BitCommand() << 4;
+				spiRepeat |= get4BitCommand();
+			}
+			spiByte  = get4BitCommand() << 4;
+			spiByte |= get4BitCommand();
+			spiBit = 0x80;
+			spiPhase = 0;
+			while ( !stepSPIByte() ) ;	// SCK high is always a change
+			return;
+		}
+
 		const u32 tab[4] = { LATCH_SCL, LATCH_SDA, LATCH_LED3, LATCH_LED2 };
 		u32 c = tab[ v >> 2 ]; 
 
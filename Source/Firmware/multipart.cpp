@@ -0,0 +1,191 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ multipart.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - incremental parser for multipart/form-data request bodies
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "multipart.h"
+#include <circle/util.h>
+
+CMultipartParser::CMultipartParser()
+:	m_pHandler( 0 ),
+	m_pParam( 0 ),
+	m_State( StateError ),
+	m_nDelimiterLength( 0 ),
+	m_nMatched( 0 ),
+	m_nBoundaryEnd( 0 ),
+	m_nHeaderLength( 0 )
+{
+}
+
+boolean CMultipartParser::Init( const char *boundary, TMultipartHandler *pHandler, void *pParam )
+{
+	unsigned l = strlen( boundary );
+	if ( l == 0 || l > MULTIPART_MAX_BOUNDARY )
+	{
+		m_State = StateError;
+		return false;
+	}
+
+	strcpy( m_Delimiter, "\r\n--" );
+	strcat( m_Delimiter, boundary );
+	m_nDelimiterLength = 4 + l;
+
+	m_pHandler = pHandler;
+	m_pParam = pParam;
+
+	// the body starts with the first boundary, i.e. without the leading CRLF of the delimiter
+	m_State = StatePreamble;
+	m_nMatched = 2;
+	return true;
+}
+
+boolean CMultipartParser::emit( const u8 *pData, unsigned length )
+{
+	if ( m_State != StateData || length == 0 )
+		return true;
+	return m_pHandler( MULTIPART_PART_DATA, pData, length, m_pParam );
+}
+
+boolean CMultipartParser::Put( const u8 *pData, unsigned length )
+{
+	unsigned i = 0;
+	while ( i < length )
+	{
+		if ( m_State == StateDone )
+			return true;		// epilogue is ignored
+		if ( m_State == StateError )
+			return false;
+
+		if ( m_State == StateBoundaryEnd )
+		{
+			char c = pData[ i++ ];
+			if ( m_nBoundaryEnd == 0 && ( c == ' ' || c == '\t' ) )
+				continue;		// transport padding
+			m_BoundaryEnd[ m_nBoundaryEnd++ ] = c;
+			if ( m_nBoundaryEnd < 2 )
+				continue;
+
+			if ( m_BoundaryEnd[ 0 ] == '-' && m_BoundaryEnd[ 1 ] == '-' )
+				m_State = StateDone; else
+			if ( m_BoundaryEnd[ 0 ] == '\r' && m_BoundaryEnd[ 1 ] == '\n' )
+			{
+				m_State = StateHeader;
+				m_nHeaderLength = 0;
+			} else
+				m_State = StateError;
+			continue;
+		}
+
+		if ( m_State == StateHeader )
+		{
+			if ( m_nHeaderLength >= MULTIPART_MAX_HEADER - 1 )
+			{
+				m_State = StateError;
+				continue;
+			}
+			m_Header[ m_nHeaderLength++ ] = pData[ i++ ];
+			if ( m_nHeaderLength >= 4 && memcmp( &m_Header[ m_nHeaderLength - 4 ], "\r\n\r\n", 4 ) == 0 )
+			{
+				m_Header[ m_nHeaderLength - 4 ] = 0;
+				m_State = StateData;
+				m_nMatched = 0;
+				if ( !m_pHandler( MULTIPART_PART_BEGIN, (const u8 *)m_Header, m_nHeaderLength - 4, m_pParam ) )
+					m_State = StateError;
+			}
+			continue;
+		}
+
+		// preamble or data: look for the delimiter, everything else is passed on in runs
+		unsigned run = i;
+		while ( i < length )
+		{
+			u8 c = pData[ i ];
+			if ( c == (u8)m_Delimiter[ m_nMatched ] )
+			{
+				i++;
+				if ( ++m_nMatched == m_nDelimiterLength )
+					break;
+				continue;
+			}
+
+			if ( m_nMatched > 0 )
+			{
+				// the bytes held back weren't a delimiter after all. As the boundary contains no CR
+				// the only possible new start of a delimiter is this byte
+				unsigned held = m_nMatched;
+				m_nMatched = 0;
+				if ( held <= i - run )
+				{
+					// all of them are part of this piece
+					continue;
+				}
+				// some of them came with the previous piece
+				unsigned previous = held - ( i - run );
+				if ( !emit( (const u8 *)m_Delimiter, previous ) )
+				{
+					m_State = StateError;
+					return false;
+				}
+				continue;
+			}
+			i++;
+		}
+
+		if ( m_nMatched == m_nDelimiterLength )
+		{
+			// data up to the delimiter, some of the delimiter bytes may have come with the previous piece
+			unsigned inPiece = i - run;
+			if ( inPiece >= m_nDelimiterLength && !emit( &pData[ run ], inPiece - m_nDelimiterLength ) )
+			{
+				m_State = StateError;
+				return false;
+			}
+			if ( m_State == StateData && !m_pHandler( MULTIPART_PART_END, 0, 0, m_pParam ) )
+			{
+				m_State = StateError;
+				return false;
+			}
+			m_State = StateBoundaryEnd;
+			m_nBoundaryEnd = 0;
+			m_nMatched = 0;
+			continue;
+		}
+
+		// end of this piece, bytes which may start a delimiter are held back
+		unsigned inPiece = i - run;
+		unsigned heldInPiece = m_nMatched < inPiece ? m_nMatched : inPiece;
+		if ( !emit( &pData[ run ], inPiece - heldInPiece ) )
+		{
+			m_State = StateError;
+			return false;
+		}
+	}
+	return m_State != StateError;
+}
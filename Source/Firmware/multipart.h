@@ -0,0 +1,94 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ multipart.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - incremental parser for multipart/form-data request bodies
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _multipart_h
+#define _multipart_h
+
+#include <circle/types.h>
+
+#define MULTIPART_MAX_BOUNDARY		72		// RFC 2046
+#define MULTIPART_MAX_HEADER		1024
+
+// events passed to the handler
+#define MULTIPART_PART_BEGIN		1		// pData is the part header (null-terminated)
+#define MULTIPART_PART_DATA			2
+#define MULTIPART_PART_END			3
+
+// returns false to abort parsing
+typedef boolean TMultipartHandler( unsigned event, const u8 *pData, unsigned length, void *pParam );
+
+//
+// splits a multipart/form-data body into its parts while it arrives in pieces of any size,
+// i.e. the body never has to be kept in memory: the data of a part is passed on in runs
+// as long as the pieces, only bytes which may belong to a boundary are held back.
+//
+class CMultipartParser
+{
+public:
+	CMultipartParser();
+
+	// 'boundary' as in the Content-Type header (without quotes)
+	boolean Init( const char *boundary, TMultipartHandler *pHandler, void *pParam );
+
+	// returns false on a malformed body or if the handler aborted
+	boolean Put( const u8 *pData, unsigned length );
+
+	// true after the closing boundary
+	boolean IsComplete() const { return m_State == StateDone; }
+
+private:
+	enum TState
+	{
+		StatePreamble,
+		StateBoundaryEnd,		// "--" (end) or "\r\n" (next part) after a boundary
+		StateHeader,
+		StateData,
+		StateDone,
+		StateError
+	};
+
+	boolean emit( const u8 *pData, unsigned length );
+
+	TMultipartHandler *m_pHandler;
+	void *m_pParam;
+
+	TState m_State;
+	char m_Delimiter[ 4 + MULTIPART_MAX_BOUNDARY + 1 ];		// "\r\n--" boundary
+	unsigned m_nDelimiterLength;
+	unsigned m_nMatched;		// bytes of the delimiter matched so far
+	char m_BoundaryEnd[ 2 ];
+	unsigned m_nBoundaryEnd;
+	char m_Header[ MULTIPART_MAX_HEADER ];
+	unsigned m_nHeaderLength;
+};
+
+#endif
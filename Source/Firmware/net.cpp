@@ -33,6 +33,7 @@
 
 #include "net.h"
 #include "helpers.h"
+#include "sdcache.h"
 
 #ifndef IS264
 #include "c64screen.h"
@@ -124,12 +125,15 @@ CSidekickNet::CSidekickNet(
 #else
 		m_useWLAN (false),
 #endif
-		m_DNSClient(0),
+		m_DNSCache(0),
 #ifdef WITH_TLS
 		m_TLSSupport(0),
 #endif
+		m_HTTPPool(0),
+		m_NetWorker(0),
 		m_pBBSSocket(0),
 		m_WebServer(0),
+		m_UploadServer(0),
 		m_pUSBSerial(0),
 		m_pUSBMidi(0),
 		m_isFSMounted( false ),
@@ -148,7 +152,6 @@ CSidekickNet::CSidekickNet(
 		m_isRebootRequested( false ),
 		m_isReturnToMenuRequested( false ),
 		m_networkActionStatusMsg( (char * ) ""),
-		m_sktpScreenContent( (unsigned char * ) ""),
 		m_sktpSessionID( (char * ) ""),
 		m_isSktpScreenActive( false ),
 		m_wasSktpScreenFreshlyEntered( false ),
@@ -169,15 +172,22 @@ CSidekickNet::CSidekickNet(
 		m_skipSktpRefresh(0),
 		m_sktpRefreshTimeout(0),
 		m_sktpRefreshWaiting(false),
-		m_sktpScreenPosition(0),
 		m_sktpResponseLength(0),
 		m_sktpResponseType(0),
+		m_sktpParseState(SKTP_PARSE_DONE),
+		m_sktpRingStart(0),
+		m_sktpRingFill(0),
+		m_sktpTGASize(0),
+		m_sktpTGAFill(0),
+		m_sktpFrameId(0),
 		m_sktpKey(0),
 		m_sktpSession(0),
 		m_sktpScreenErrorCode(0),
 		m_videoFrameCounter(1),
 		m_sysMonHeapFree(0),
 		m_sysMonCPUTemp(0),
+		m_isBenchmarkQueued(false),
+		m_isBenchmarkRunning(false),
 		m_loglevel(2),
 		m_CSDBDownloadSavePath((char *) ""), 
 		m_currentKernelRunning((char *) "m"),
@@ -185,10 +195,8 @@ CSidekickNet::CSidekickNet(
 		m_modemCommand( (char * ) ""),
 		m_modemCommandLength(0),
 		m_modemEmuType(0),
-		m_modemOutputBufferLength(0),
-		m_modemOutputBufferPos(0),
-		m_modemInputBufferLength(0),
-		m_modemInputBufferPos(0),
+		m_modemSendLength(0),
+		m_modemSendSince(0),
 		m_socketPort(0),
 		m_baudRate(1200),
 		m_PRGLaunchTweakValue(4)
@@ -200,13 +208,14 @@ CSidekickNet::CSidekickNet(
 	m_pTimer->SetTimeZone (nTimeZone);
 	
 	m_modemCommand[0] = '\0';
-	m_modemInputBuffer[0] = '\0';
-	m_modemOutputBuffer[0] = '\0';
 	m_socketHost[0] = '\0';
 	
 	m_CSDBDownloadPath[0] = '\0';
 	m_CSDBDownloadExtension[0] = '\0';
 	m_CSDBDownloadFilename[0] = '\0';
+
+	m_benchResult.valid = false;
+	m_benchResult.error[0] = '\0';
 }
 
 void CSidekickNet::setErrorMsgC64( char * msg, boolean sticky = true ){ 
@@ -317,12 +326,23 @@ boolean CSidekickNet::Initialize()
 	//net connection is up and running now
 	m_isActive = true;
 
-	m_DNSClient = new CDNSClient (m_Net);
+	//shared resolver cache, configured hosts are kept resolved in the background
+	m_DNSCache = new CDNSCache (m_Net);
+	m_DNSCache->Prefetch( NTPServer );
+	m_DNSCache->Prefetch( netSktpHostName );
+	if ( m_modemEmuType != 0 )
+		prefetchModemShortcuts();
 
 #ifdef WITH_TLS
 	m_TLSSupport = new CTLSSimpleSupport (m_Net);
+	m_HTTPPool = new CHTTPConnectionPool (m_Net, m_TLSSupport);
+#else
+	m_HTTPPool = new CHTTPConnectionPool (m_Net);
 #endif
 
+	//downloads and sktp requests are executed by the worker task, the menu keeps running meanwhile
+	m_NetWorker = new CNetWorker (this);
+
 	bool success = false;
 	
 	m_CSDB.hostName = CSDB_HOST;
@@ -397,6 +417,7 @@ void CSidekickNet::usbPnPUpdate()
 				);
 				if (m_modemEmuType == 0){
 					m_modemEmuType = SK_MODEM_USERPORT_USB;
+					prefetchModemShortcuts();
 					setModemEmuBaudrate(m_baudRate);
 				}
 			}
@@ -418,6 +439,8 @@ void CSidekickNet::EnableWebserver(){
 	if (m_loglevel > 1)
 		logger->Write ("CSidekickNet::Initialize", LogNotice, "Starting webserver.");
 	m_WebServer = new CWebServer (m_Net, 80, KERNEL_MAX_SIZE + 2000, 0, this);
+	// the upload form posts to this port, files are streamed instead of buffered by the daemon
+	m_UploadServer = new CUploadServer (m_Net, NET_UPLOAD_PORT, this);
 }
 
 boolean CSidekickNet::isWebserverRunning(){
@@ -579,12 +602,12 @@ boolean CSidekickNet::disableActiveNetwork(){
 	
 	/*
 	logger->Write( "CSidekickNet", LogNotice, 
-		"disableActiveNetwork: Now deleting instance of CDNSClient."
+		"disableActiveNetwork: Now deleting instance of CDNSCache."
 	);
 	logger->Write ("CSidekickNet", LogNotice, getSysMonInfo(1));
 	
-	delete m_DNSClient;
-	m_DNSClient = 0;
+	delete m_DNSCache;
+	m_DNSCache = 0;
 
 	logger->Write( "CSidekickNet", LogNotice, 
 		"disableActiveNetwork: Now deleting instance of CNetSubSystem."
@@ -609,7 +632,7 @@ boolean CSidekickNet::disableActiveNetwork(){
 	);
 	
 	m_TLSSupport = 0;
-	m_DNSClient = 0;
+	m_DNSCache = 0;
 	m_Net = 0;
 	m_USBHCI = 0;
 	*/
@@ -761,6 +784,21 @@ void CSidekickNet::queueFrameRequest()
 	m_queueDelay = 0;
 }
 
+void CSidekickNet::queueNetworkBenchmark()
+{
+	if ( m_isBenchmarkRunning )
+		return;
+	m_isBenchmarkQueued = true;
+	m_benchResult.valid = false;
+	m_benchResult.error[0] = '\0';
+	m_queueDelay = 0;
+}
+
+boolean CSidekickNet::isNetworkBenchmarkRunning()
+{
+	return m_isBenchmarkQueued || m_isBenchmarkRunning;
+}
+
 void CSidekickNet::queueSktpKeypress( int key )
 {
 	if ( !isAnyNetworkActionQueued())
@@ -789,7 +827,7 @@ void CSidekickNet::setSktpRefreshTimeout( unsigned timeout )
 	m_sktpRefreshTimeout = timeout;
 }
 
-void CSidekickNet::queuedSktpRefreshAllowed()
+boolean CSidekickNet::queuedSktpRefreshAllowed()
 {
 	//refesh when user didn't press a key
 	//this has to be quick for multiplayer games (value 4)
@@ -802,9 +840,9 @@ void CSidekickNet::queuedSktpRefreshAllowed()
 		m_skipSktpRefresh = 0;
 		m_sktpRefreshTimeout = 0;
 		m_sktpKey = 0;
-		updateSktpScreenContent();
-		m_isMenuScreenUpdateNeeded = true;
+		return true;
 	}
+	return false;
 }
 
 char * CSidekickNet::getCSDBDownloadFilename(){
@@ -850,9 +888,9 @@ u8 CSidekickNet::getCSDBDownloadLaunchType(){
 		//with the new d2ef approach available within Sidekick we try to launch the D64
 		//as an dynamically created EF crt!
 		type = 99;
-		extern int createD2EF( unsigned char *diskimage, int imageSize, unsigned char *cart, int build, int mode, int autostart );
+		extern int createD2EFCached( CLogger *logger, unsigned char *diskimage, int imageSize, unsigned char *cart, u32 cartMaxSize, int build, int mode, int autostart );
 		unsigned char *cart = new unsigned char[ 1024 * 1027 ];
-		u32 crtSize = createD2EF( prgDataLaunch, prgSizeLaunch, cart, 2, 0, true );
+		u32 crtSize = createD2EFCached( logger, prgDataLaunch, prgSizeLaunch, cart, 1024 * 1027, 2, 0, true );
 		memcpy( &prgDataLaunch[0], cart, crtSize );
 		prgSizeLaunch = crtSize;
 		//this is only an irrelevant dummy name ending wih crt that will be used to try to load a tga file
@@ -867,32 +905,8 @@ u8 CSidekickNet::getCSDBDownloadLaunchType(){
 	else if ( strcmp( m_CSDBDownloadExtension, "sid" ) == 0)
 	{
 #ifndef IS264
-		//FIXME: This was just copied from c64screen.cpp. Put this into a method.
-		Psid64 *psid64 = new Psid64();
-
-		psid64->setVerbose(false);
-		psid64->setUseGlobalComment(false);
-		psid64->setBlankScreen(false);
-		psid64->setNoDriver(false);
-
-		if ( !psid64->load( prgDataLaunch, prgSizeLaunch ) )
-		{
-			//return false;
-		}
-		//logger->Write( "exec", LogNotice, "psid loaded" );
-
-		// convert the PSID file
-		if ( !psid64->convert() ) 
-		{
-			//return false;
-		}
-		//logger->Write( "exec", LogNotice, "psid converted, prg size %d", psid64->m_programSize );
-
-		memcpy( &prgDataLaunch[0], psid64->m_programData, psid64->m_programSize );
-		prgSizeLaunch = psid64->m_programSize;
-
-		delete psid64;
-		//FIXME: End of copy
+		extern u32 convertPSIDCached( CLogger *logger, const char *fileName, unsigned char *sidData, u32 sidSize, unsigned char *prg, u32 prgMaxSize );
+		prgSizeLaunch = convertPSIDCached( logger, NULL, prgDataLaunch, prgSizeLaunch, prgDataLaunch, 65536 + 2 );
 		type = 41;
 #else
 		type = 0; //unused, we only save the file (on Sidekick 264)
@@ -921,6 +935,21 @@ boolean CSidekickNet::isUsbUserportModemConnected(){
 }
 
 void CSidekickNet::handleQueuedNetworkAction()
+{
+	//the menu kernels call this with FIQs disabled, during a benchmark we record how long it takes
+	if ( !m_isBenchmarkRunning )
+	{
+		processQueuedNetworkAction();
+		return;
+	}
+	unsigned start = CTimer::GetClockTicks();
+	processQueuedNetworkAction();
+	unsigned duration = CTimer::GetClockTicks() - start;
+	if ( duration > m_benchResult.fiqOffMax )
+		m_benchResult.fiqOffMax = duration;
+}
+
+void CSidekickNet::processQueuedNetworkAction()
 {
 	//boolean isRunning = IsStillRunning();
 	boolean isRunning = IsRunning();
@@ -935,6 +964,7 @@ void CSidekickNet::handleQueuedNetworkAction()
 		}
 
 		handleModemEmulation( false );
+		m_HTTPPool->CloseIdle();
 	
 		unsigned repeats = 3; //lan, test time update in system information
 		if ( usesWLAN()){
@@ -990,6 +1020,15 @@ void CSidekickNet::handleQueuedNetworkAction()
 	}
 	else if (isRunning)
 	{
+		handleNetworkResults();
+
+		//one request at a time, the next one is posted when the worker has finished,
+		//nothing is posted while an upload is being received into prgDataLaunch
+		if (m_NetWorker->IsBusy() || (m_UploadServer != 0 && m_UploadServer->IsBusy()))
+		{
+			m_pScheduler->Yield (); //the worker only proceeds while we yield
+			return;
+		}
 
 		if (m_isCSDBDownloadQueued)
 		{
@@ -997,9 +1036,15 @@ void CSidekickNet::handleQueuedNetworkAction()
 				logger->Write( "handleQueuedNetworkAction", LogNotice, "m_CSDBDownloadPath: %s", m_CSDBDownloadPath);
 			}
 			m_isCSDBDownloadQueued = false;
-			getCSDBBinaryContent();
+			m_NetWorker->Post( NET_REQUEST_DOWNLOAD );
 			//m_isSktpKeypressQueued = false;
 		}
+		else if (m_isBenchmarkQueued)
+		{
+			m_isBenchmarkQueued = false;
+			m_isBenchmarkRunning = true;
+			m_NetWorker->Post( NET_REQUEST_BENCHMARK );
+		}
 		/*
 	
 		else if (m_isCSDBDownloadSavingQueued)
@@ -1014,21 +1059,48 @@ void CSidekickNet::handleQueuedNetworkAction()
 		//handle keypress anyway even if we have downloaded or saved something
 		else if (m_isSktpKeypressQueued)
 		{
-			updateSktpScreenContent();
 			m_isSktpKeypressQueued = false;
+			m_NetWorker->Post( NET_REQUEST_SKTP_UPDATE );
 		}
 		else if (m_sktpRefreshWaiting)
 		{
-			if( m_sktpKey == 0)
-				queuedSktpRefreshAllowed();
+			if( m_sktpKey == 0){
+				if ( queuedSktpRefreshAllowed())
+					m_NetWorker->Post( NET_REQUEST_SKTP_REFRESH );
+			}
 			else{
-				updateSktpScreenContent();
 				m_isSktpKeypressQueued = false;
+				m_NetWorker->Post( NET_REQUEST_SKTP_UPDATE );
 			}
 		}
 	}
 }
 
+void CSidekickNet::handleNetworkResults()
+{
+	u8 result;
+	while ( m_NetWorker->GetResult( &result ))
+	{
+		u8 request = result & ~NET_RESULT_OK;
+		if ( m_loglevel > 2 || !(result & NET_RESULT_OK))
+			logger->Write( "handleNetworkResults", LogNotice, "Request %u finished %s", request, (result & NET_RESULT_OK) ? "ok" : "with error");
+
+		//the worker has painted the sktp screen (or failed), the menu renders it right away
+		if ( request == NET_REQUEST_SKTP_UPDATE || request == NET_REQUEST_SKTP_REFRESH )
+		{
+			sktpShowScreen();
+			m_isMenuScreenUpdateNeeded = true;
+		}
+		else if ( request == NET_REQUEST_DOWNLOAD )
+			m_isMenuScreenUpdateNeeded = true;
+		else if ( request == NET_REQUEST_BENCHMARK )
+		{
+			m_isBenchmarkRunning = false;
+			m_isMenuScreenUpdateNeeded = true;
+		}
+	}
+}
+
 boolean CSidekickNet::checkForSaveableDownload(){
 	if (m_isCSDBDownloadSavingQueued)
 	{
@@ -1051,7 +1123,9 @@ boolean CSidekickNet::isAnyNetworkActionQueued()
 			m_isFrameQueued || 
 			m_isSktpKeypressQueued || 
 			m_isCSDBDownloadQueued || 
-			m_isCSDBDownloadSavingQueued;
+			m_isCSDBDownloadSavingQueued ||
+			m_isBenchmarkQueued ||
+			(m_NetWorker != 0 && m_NetWorker->IsBusy());
 }
 
 void CSidekickNet::saveDownload2SD()
@@ -1132,6 +1206,23 @@ void CSidekickNet::prepareLaunchOfUpload( char * ext, char * filename, u8 mode,
 	
 }
 
+const char * CSidekickNet::getKernelImageFilename()
+{
+#ifndef IS264
+	#if RASPPI >= 4
+		return "SD:rpi4_kernel_sk64_net.img";
+	#else
+		return !kernelSupportsWLAN() ? "SD:kernel_sk64_ethernet.img" : "SD:kernel_sk64_net.img";
+	#endif
+#else
+	#if RASPPI >= 4
+		return usesWLAN() ? "SD:rpi4_kernel_sk264_wlan.img" : "SD:rpi4_kernel_sk264_net.img";
+	#else
+		return usesWLAN() ? "SD:kernel_sk264_wlan.img" : "SD:kernel_sk264_net.img";
+	#endif
+#endif
+}
+
 void CSidekickNet::cleanupDownloadData()
 {
   clearErrorMsg(); //on c64screen, kernel menu
@@ -1284,26 +1375,19 @@ CNetConfig * CSidekickNet::GetNetConfig(){
 CIPAddress CSidekickNet::getIPForHost( const char * host, bool & success )
 {
 	assert (m_isActive);
-	success = false;
-	unsigned attempts = 0;
 	CIPAddress ip;
-	while ( attempts < 3)
+	//answered from the cache if possible, this includes recent failures
+	success = m_DNSCache->Resolve (host, &ip);
+	if (!success)
 	{
-		attempts++;
-		if (!m_DNSClient->Resolve (host, &ip))
-		{
-			if (m_loglevel > 2)
-				logger->Write ("getIPForHost", LogWarning, "Cannot resolve: %s",host);
-		}
-		else
-		{
-			CString IPString;
-			ip.Format (&IPString);
-			success = true;
-			if (m_loglevel > 2)
-				logger->Write ("getIPForHost", LogNotice, "Resolved %s as %s",host, (const char* ) IPString);
-			break;
-		}
+		if (m_loglevel > 2)
+			logger->Write ("getIPForHost", LogWarning, "Cannot resolve: %s",host);
+	}
+	else if (m_loglevel > 2)
+	{
+		CString IPString;
+		ip.Format (&IPString);
+		logger->Write ("getIPForHost", LogNotice, "Resolved %s as %s",host, (const char* ) IPString);
 	}
 	return ip;
 }
@@ -1346,41 +1430,143 @@ void CSidekickNet::drawTGAImageOnTFT(){
 	tftParseTGA( tempTGA, prgDataLaunch, &w, &h, false, prgSizeLaunch );
 	tftLoadBackgroundTGAMemory( tempTGA, 240, 240, false);
 	tftCopyBackground2Framebuffer();
-	tftInitImm();
-	tftSendFramebuffer16BitImm( tftFrameBuffer );
+	if ( !tftIsFrameKnown() )
+		tftInitImm();
+	tftUpdateFramebuffer16BitImm( tftFrameBuffer );
 	//buggy: tftSplashScreenMemory( (u8*) prgDataLaunch, prgSizeLaunch );
 	cleanupDownloadData();
 	//requireCacheWellnessTreatment();
 }
 
+// identifies a cached download, has to match on lookup
+typedef struct
+{
+	u32 magic;
+	u32 port;
+	u64 urlHash;
+} __attribute__((packed)) NET_DOWNLOAD_CACHE_HEADER;
+
+// appended to the downloaded content in the cache entry
+typedef struct
+{
+	THTTPValidators validators;
+	u32 fetched;		// CTimer::GetTime() of the download
+	u32 totalLength;	// size of the resource, larger than the content if the download has been interrupted
+	u32 complete;
+} __attribute__((packed)) NET_DOWNLOAD_CACHE_TRAILER;
+
+static SDCACHE downloadCache = SDCACHE_INIT( NET_DOWNLOAD_CACHE_FOLDER, NET_DOWNLOAD_CACHE_MAX_ENTRIES, NET_DOWNLOAD_CACHE_MAX_SIZE );
+
 void CSidekickNet::getCSDBBinaryContent( ){
 	assert (m_isActive);
 	u32 iFileLength = 0;
-	if ( HTTPGet ( m_CSDBDownloadHost, (char *) m_CSDBDownloadPath, (char *) prgDataLaunch, iFileLength)){
-		prgSizeLaunch = iFileLength;
-		m_isDownloadReady = true;
+
+	NET_DOWNLOAD_CACHE_HEADER header;
+	memset( &header, 0, sizeof( header ) );
+	header.magic = 0x32444e53;	// "SND2"
+	header.port = m_CSDBDownloadHost.port;
+	header.urlHash = sdCacheHash( m_CSDBDownloadHost.hostName, strlen( m_CSDBDownloadHost.hostName ) );
+	header.urlHash = sdCacheHash( m_CSDBDownloadPath, strlen( m_CSDBDownloadPath ), header.urlHash );
+	u32 key = (u32)( header.urlHash ^ ( header.urlHash >> 32 ) );
+
+	NET_DOWNLOAD_CACHE_TRAILER trailer;
+	memset( &trailer, 0, sizeof( trailer ) );
+	const u32 maxEntrySize = nDocMaxSize;
+	u32 entrySize = 0;
+	boolean isCached = sdCacheRead( logger, &downloadCache, key, &header, sizeof( header ), prgDataLaunch, &entrySize, maxEntrySize ) &&
+		entrySize >= sizeof( trailer );
+	u32 received = 0;
+	if ( isCached )
+	{
+		iFileLength = entrySize - sizeof( trailer );
+		memcpy( &trailer, &prgDataLaunch[ iFileLength ], sizeof( trailer ) );
+
+		unsigned now = CTimer::Get()->GetTime();
+		if ( !trailer.complete )
+		{
+			//an interrupted download, only the rest is requested (unless the file has changed meanwhile)
+			isCached = false;
+			received = iFileLength;
+			if (m_loglevel > 1)
+				logger->Write( "getCSDBBinaryContent", LogNotice, "Resuming download at %u of %u bytes", received, trailer.totalLength);
+		}
+		else if ( now >= trailer.fetched && now - trailer.fetched < NET_DOWNLOAD_CACHE_FRESH )
+		{
+			if (m_loglevel > 2)
+				logger->Write( "getCSDBBinaryContent", LogNotice, "Using cached download (%u bytes)", iFileLength);
+			prgSizeLaunch = iFileLength;
+			m_isDownloadReady = true;
+			requireCacheWellnessTreatment();
+			return;
+		}
+	}
+
+	//revalidate a cached download, on 304 the buffer is left untouched
+	u32 total = trailer.totalLength;
+	unsigned status = HTTPGetResumable ( m_CSDBDownloadHost, (char *) m_CSDBDownloadPath, prgDataLaunch, nDocMaxSize - sizeof( trailer ), received, total, &trailer.validators);
+	if ( status == 304 && isCached )
+	{
+		if (m_loglevel > 2)
+			logger->Write( "getCSDBBinaryContent", LogNotice, "Cached download is still valid (%u bytes)", iFileLength);
+	}
+	else if ( status == 200 )
+	{
+		iFileLength = received;
+		trailer.fetched = CTimer::Get()->GetTime();
+		trailer.totalLength = received;
+		trailer.complete = 1;
+		memcpy( &prgDataLaunch[ iFileLength ], &trailer, sizeof( trailer ) );
+		sdCacheWrite( logger, &downloadCache, key, &header, sizeof( header ), prgDataLaunch, iFileLength + sizeof( trailer ) );
 		if (m_loglevel > 3)
 			logger->Write( "getCSDBBinaryContent", LogNotice, "memcpy finished.");
-		requireCacheWellnessTreatment();
 	}
-	else if (m_CSDBDownloadHost.port == 443)
-		setErrorMsgC64((char*)"          HTTPS request failed          ", false);
-		//                    "012345678901234567890123456789012345XXXX"
-		
+	else if ( status == 0 && isCached &&
+		sdCacheRead( logger, &downloadCache, key, &header, sizeof( header ), prgDataLaunch, &entrySize, maxEntrySize ) )
+	{
+		//no response at all, we're probably offline: the cached version is better than nothing
+		if (m_loglevel > 1)
+			logger->Write( "getCSDBBinaryContent", LogWarning, "Server not reachable, using cached download (%u bytes)", iFileLength);
+	}
 	else
-		setErrorMsgC64((char*)"           HTTP request failed          ", false);
-		//                    "012345678901234567890123456789012345XXXX"
+	{
+		if ( status == 0 && received > 0 && !isCached )
+		{
+			//keep what we have got so far, the next attempt continues from here
+			trailer.fetched = CTimer::Get()->GetTime();
+			trailer.totalLength = total;
+			trailer.complete = 0;
+			memcpy( &prgDataLaunch[ received ], &trailer, sizeof( trailer ) );
+			sdCacheWrite( logger, &downloadCache, key, &header, sizeof( header ), prgDataLaunch, received + sizeof( trailer ) );
+			if (m_loglevel > 1)
+				logger->Write( "getCSDBBinaryContent", LogWarning, "Download interrupted at %u of %u bytes, kept for resuming", received, total);
+		}
+		if (m_CSDBDownloadHost.port == 443)
+			setErrorMsgC64((char*)"          HTTPS request failed          ", false);
+			//                    "012345678901234567890123456789012345XXXX"
+		else
+			setErrorMsgC64((char*)"           HTTP request failed          ", false);
+			//                    "012345678901234567890123456789012345XXXX"
+		if (m_loglevel > 2)
+			logger->Write( "getCSDBBinaryContent", LogNotice, "HTTPS Document length: %i", received);
+		return;
+	}
+
+	prgSizeLaunch = iFileLength;
+	m_isDownloadReady = true;
+	requireCacheWellnessTreatment();
 	if (m_loglevel > 2)
 		logger->Write( "getCSDBBinaryContent", LogNotice, "HTTPS Document length: %i", iFileLength);
 }
 
 void CSidekickNet::resetSktpSession(){
 	m_sktpSession	= 0;
+	m_sktpFrameId = 0;
 }
 
 void CSidekickNet::redrawSktpScreen(){
 	if (m_sktpSession == 1)
 		m_sktpSession	= 2;
+	m_sktpFrameId = 0;
 }
 
 boolean CSidekickNet::isSktpRedrawNeeded(){
@@ -1405,7 +1591,8 @@ boolean CSidekickNet::launchSktpSession(){
 			urlSuffix.Append(netSktpHostPassword);
 		}
 	}
-	urlSuffix.Append("&sktpv=5&type=");
+	//frames=1 announces that we can decode compressed (delta) frames, chunk type 9
+	urlSuffix.Append("&sktpv=5&frames=1&type=");
 	#ifndef IS264
 	if (m_isC128)
 		urlSuffix.Append("128");
@@ -1424,6 +1611,7 @@ boolean CSidekickNet::launchSktpSession(){
 		else if ( m_sktpResponseLength > 25 && m_sktpResponseLength < 34){
 			m_sktpSessionID = pResponseBuffer;
 			m_sktpSessionID[m_sktpResponseLength] = '\0';
+			m_sktpFrameId = 0;
 			if (m_loglevel > 2)
 				logger->Write( "launchSktpSession", LogNotice, "Got session id: %s", m_sktpSessionID);
 		}
@@ -1452,9 +1640,17 @@ CString CSidekickNet::getSktpPath( unsigned key )
 	if ( m_sktpSession == 2) //redraw
 	{
 		m_sktpSession = 1;
+		m_sktpFrameId = 0;
 		path.Append( "&redraw=1" );
 		//logger->Write( "getSktpPath", LogNotice, "Enforce sktp page redraw.");
 	}
+	else if ( m_sktpFrameId != 0 )
+	{
+		//acknowledge the last frame, the server may send a delta against it
+		Number.Format ("%u", m_sktpFrameId);
+		path.Append( "&ack=" );
+		path.Append( Number );
+	}
 	return path;
 }
 
@@ -1652,48 +1848,22 @@ void CSidekickNet::updateSktpScreenContent(){
 		m_sktpSession = 1;
 	}
 
-	//we need more than 233KB so that we can put in a tga image if we need to...
-	char pResponseBuffer[1024 * 500 + 1]; //maybe turn this into member var when creating new sktp class?
-	if (HTTPGet ( m_SKTPServer, getSktpPath( m_sktpKey ), pResponseBuffer, m_sktpResponseLength))
+	//the response is decoded and painted while it is being received
+	resetSktpParser();
+	if (HTTPGetStream ( m_SKTPServer, getSktpPath( m_sktpKey ), sktpBodyHandler, this, m_sktpResponseLength))
 	{
-		if ( m_sktpResponseLength > 0 )
+		if ( m_sktpParseState != SKTP_PARSE_DONE && m_sktpRingFill > 0 )
+			logger->Write( "updateSktpScreenContent", LogWarning, "Incomplete sktp chunk at end of response (%u bytes)", m_sktpRingFill);
+
+		if ( m_sktpResponseType == 3) // no session or session expired
 		{
-			//logger->Write( "updateSktpScreenContent", LogNotice, "HTTP Document m_sktpResponseLength: %i", m_sktpResponseLength);
-			m_sktpResponseType = pResponseBuffer[0];
-			//logger->Write( "updateSktpScreenContent", LogNotice, "response type : %i", m_sktpResponseType);
-			if ( m_sktpResponseType == 2) // url for binary download, e. g. csdb
-			{
-				parseSKTPDownloadCommand(pResponseBuffer,1);
-				m_sktpResponseLength = 1;
-				m_sktpScreenContent = (unsigned char * ) pResponseBuffer;
-				m_sktpScreenPosition = 1;
-				m_isCSDBDownloadQueued = true;
-				m_queueDelay = 0;
-				if (m_bSaveCSDBDownload2SD)
-					setSavePath("!downloads");
-				else
-					m_CSDBDownloadSavePath = (char *)"";
-				
-				//m_sktpResponseType = 1; //just to clear the screen
-			}
-			if ( m_sktpResponseType == 3) // no session or session expired
-			{
-				m_sktpScreenErrorCode = 7; //will not do anything
-				logger->Write( "updateSktpScreenContent", LogNotice, "Notice: Session has expired, starting new SKTP session");
-				m_sktpSession = 0;
-				m_sktpKey = 0; //keypress is out of context with a new session
-				updateSktpScreenContent();
-				return;
-			}
-			else
-			{
-				m_sktpScreenContent = (unsigned char * ) pResponseBuffer;
-				m_sktpScreenPosition = 1;
-				//m_isMenuScreenUpdateNeeded = true;
-			}
+			m_sktpScreenErrorCode = 7; //will not do anything
+			logger->Write( "updateSktpScreenContent", LogNotice, "Notice: Session has expired, starting new SKTP session");
+			m_sktpSession = 0;
+			m_sktpKey = 0; //keypress is out of context with a new session
+			updateSktpScreenContent();
+			return;
 		}
-		//logger->Write( "updateSktpScreenContent", LogNotice, "HTTP Document content: '%s'", m_sktpScreenContent);
-		
 	}
 	else
 	{
@@ -1751,160 +1921,371 @@ void CSidekickNet::setSavePath(char * subfolder)
 	
 }
 
-boolean CSidekickNet::IsSktpScreenContentEndReached()
+void CSidekickNet::resetSktpParser()
 {
-	return m_sktpScreenPosition >= m_sktpResponseLength;
+	m_sktpParseState = SKTP_PARSE_RESPONSE_TYPE;
+	m_sktpResponseType = 255;
+	m_sktpRingStart = 0;
+	m_sktpRingFill = 0;
+	m_sktpTGASize = 0;
+	m_sktpTGAFill = 0;
 }
 
-boolean CSidekickNet::IsSktpScreenToBeCleared()
+boolean CSidekickNet::sktpBodyHandler( const u8 *pData, unsigned length, void *pParam )
 {
-	return m_sktpResponseType == 0;
+	return ((CSidekickNet *) pParam)->feedSktpParser( pData, length );
 }
 
-boolean CSidekickNet::IsSktpScreenUnchanged()
+u8 CSidekickNet::peekSktpRing( unsigned offset )
 {
-	return m_sktpResponseType == 2; //2 is the http download
+	return m_sktpRing[ (m_sktpRingStart + offset) & (SKTP_RING_SIZE - 1) ];
 }
 
-void CSidekickNet::ResetSktpScreenContentChunks()
+void CSidekickNet::copyFromSktpRing( u8 * pDest, unsigned offset, unsigned length )
 {
-	m_sktpScreenPosition = 1;
+	for (unsigned i = 0; i < length; i++)
+		pDest[i] = peekSktpRing( offset + i );
 }
 
-
-u8 CSidekickNet::GetSktpScreenContentChunkType()
+boolean CSidekickNet::feedSktpParser( const u8 *pData, unsigned length )
 {
-	if ( m_sktpScreenPosition >= m_sktpResponseLength )
-		return 255; //end reached
-	return m_sktpScreenContent[ m_sktpScreenPosition ];
-}
+	while ( length > 0 )
+	{
+		if ( m_sktpParseState == SKTP_PARSE_TGA )
+		{
+			//tga image data goes directly to its destination
+			unsigned n = m_sktpTGASize - m_sktpTGAFill;
+			if ( n > length ) n = length;
+			memcpy( &prgDataLaunch[ m_sktpTGAFill ], pData, n );
+			m_sktpTGAFill += n;
+			pData += n;
+			length -= n;
+			if ( m_sktpTGAFill == m_sktpTGASize )
+				showSktpTGAImage();
+			continue;
+		}
 
-boolean CSidekickNet::getSKTPBorderBGColorCharset( u8 &borderColor, u8 &bgColor)
-{
-		borderColor = m_sktpScreenContent[ ++m_sktpScreenPosition ] -1;
-		bgColor = m_sktpScreenContent[ ++m_sktpScreenPosition ] -1;
-		boolean charLower = (m_sktpScreenContent[ ++m_sktpScreenPosition ] == 1);
-		m_sktpScreenPosition++;
-		return charLower;
-}
+		if ( m_sktpParseState == SKTP_PARSE_DONE )
+			return true; //the rest of the response is ignored
 
-void CSidekickNet::enableSktpRefreshTimeout(){
-	//logger->Write( "enableSktpRefreshTimeout", LogNotice, "enabled");
-	m_sktpScreenContent[m_sktpScreenPosition] = 88; //destroy refresh chunk in case it is parsed a second time
-	u8 timeout = m_sktpScreenContent[ ++m_sktpScreenPosition ];
-	setSktpRefreshTimeout( timeout < 1 ? 1 : timeout); //minimum value
-	m_sktpScreenPosition++;
-}
+		unsigned n = SKTP_RING_SIZE - m_sktpRingFill;
+		if ( n > length ) n = length;
+		for (unsigned i = 0; i < n; i++)
+			m_sktpRing[ (m_sktpRingStart + m_sktpRingFill + i) & (SKTP_RING_SIZE - 1) ] = pData[i];
+		m_sktpRingFill += n;
+		pData += n;
+		length -= n;
 
-void CSidekickNet::prepareDownloadOfTGAImage(){
-	if ( screenType == 1 ){
-		parseSKTPDownloadCommand((char*)m_sktpScreenContent, m_sktpScreenPosition+1);
-		m_isCSDBDownloadQueued = true;
-		m_queueDelay = 4;
+		//decode and paint everything which is complete
+		while ( parseSktpChunk() ) {}
+
+		if ( m_sktpRingFill == SKTP_RING_SIZE && m_sktpParseState != SKTP_PARSE_DONE )
+		{
+			logger->Write( "feedSktpParser", LogError, "sktp chunk exceeds ring buffer");
+			return false;
+		}
 	}
-	//m_sktpResponseType = 2; //suggest that the content is unchanged
-	m_sktpScreenContent[m_sktpScreenPosition] = 88; //destroy tga chunk in case it is parsed a second time
-	m_sktpScreenPosition = m_sktpResponseLength;
+	return true;
 }
 
-void CSidekickNet::updateTGAImageFromSKTPChunk()
+/*
+	response types:
+	0 screen, clear before painting
+	1 screen, paint over the current one
+	2 url for binary download, e. g. csdb
+	3 no session or session expired
+
+	chunk types:
+	0 normal chunk
+	1 char repeat chunk
+	2 screencode chunk
+	3 meta screen refresh
+	4 colors (border, background) & charset
+	5 vertical repeat chunk
+	6 paintbrush chunk
+	7 tga image file url/name to be shown on color tft display
+	8 tga image content
+	9 compressed frame (full screen or delta against an acknowledged frame)
+*/
+boolean CSidekickNet::parseSktpChunk()
 {
-	m_sktpScreenContent[m_sktpScreenPosition] = 88; //destroy tga chunk in case it is parsed a second time
-	prgSizeLaunch = 
-		m_sktpScreenContent[ ++m_sktpScreenPosition ] * 65536 +
-		m_sktpScreenContent[ ++m_sktpScreenPosition ] * 256 +
-		m_sktpScreenContent[ ++m_sktpScreenPosition ];
-	
-	if ( prgSizeLaunch > 1024 * 350)
+	if ( m_sktpParseState == SKTP_PARSE_RESPONSE_TYPE )
 	{
-		logger->Write( "updateTGAImageFromSKTPChunk", LogNotice, "prgSizeLaunch too big: %u", prgSizeLaunch);
-		return;
+		if ( m_sktpRingFill < 1 )
+			return false;
+		m_sktpResponseType = peekSktpRing( 0 );
+		m_sktpRingStart++;
+		m_sktpRingFill--;
+		if ( m_sktpResponseType == 2 )
+			m_sktpParseState = SKTP_PARSE_DOWNLOAD;
+		else if ( m_sktpResponseType == 3 )
+			m_sktpParseState = SKTP_PARSE_DONE;
+		else
+		{
+			sktpBeginScreen( m_sktpResponseType == 0 );
+			m_sktpParseState = SKTP_PARSE_CHUNKS;
+		}
+		return true;
 	}
 
-	memcpy( prgDataLaunch, &m_sktpScreenContent[ m_sktpScreenPosition +1], prgSizeLaunch);
-	prgDataLaunch[prgSizeLaunch+1] = '\0';
-	extern unsigned char tempTGA[ 256 * 256 * 4 ];
-	int w = 0, h = 0;
-	tftParseTGA( tempTGA, prgDataLaunch, &w, &h, false, prgSizeLaunch );
-	tftLoadBackgroundTGAMemory( tempTGA, 240, 240, false);
-	tftCopyBackground2Framebuffer();
-	tftInitImm();
-	tftSendFramebuffer16BitImm( tftFrameBuffer );
+	if ( m_sktpParseState == SKTP_PARSE_DOWNLOAD )
+	{
+		//url length, filename length, save flag, url, filename
+		if ( m_sktpRingFill < 3 )
+			return false;
+		unsigned chunkLength = 3 + peekSktpRing( 0 ) + peekSktpRing( 1 );
+		if ( m_sktpRingFill < chunkLength )
+			return false;
+		copyFromSktpRing( m_sktpScreenContentChunk, 0, chunkLength );
+		parseSKTPDownloadCommand( (char *) m_sktpScreenContentChunk, 0 );
+		m_isCSDBDownloadQueued = true;
+		m_queueDelay = 0;
+		if (m_bSaveCSDBDownload2SD)
+			setSavePath("!downloads");
+		else
+			m_CSDBDownloadSavePath = (char *)"";
+		m_sktpParseState = SKTP_PARSE_DONE;
+		return false;
+	}
 
-//	m_sktpScreenPosition += prgSizeLaunch;
-	m_sktpScreenPosition = m_sktpResponseLength;
+	if ( m_sktpParseState != SKTP_PARSE_CHUNKS || m_sktpRingFill < 1 )
+		return false;
 
-}
+	u8 type = peekSktpRing( 0 );
+	unsigned chunkLength = 0;
 
-unsigned char * CSidekickNet::GetSktpScreenContentChunk( u16 & startPos, u8 &color, boolean &inverse, u8 &repeat )
-{
-	repeat = 0;
-	startPos = 0;
-	color = 0;
-	inverse = false;
-	if ( m_sktpScreenPosition >= m_sktpResponseLength ){
-		//logger->Write( "GetSktpScreenContentChunk", LogNotice, "End reached.");
-		m_sktpScreenPosition = 1;
-		return (unsigned char *) '\0';
-	}
-	u8 type = m_sktpScreenContent[ m_sktpScreenPosition ];
-	u16 scrLength = 0;
-	
-	if (type < 3 || type >= 5)
+	if ( type == 0 || type == 1 || type == 2 || type == 5 || type == 6 )
 	{
-		scrLength = m_sktpScreenContent[ m_sktpScreenPosition + 1]; // this is only the lsb
-		u16 byteLength= 0;
-		u8 startPosL = m_sktpScreenContent[ m_sktpScreenPosition + 2 ];//screen pos x/y
-		u8 startPosM = m_sktpScreenContent[ m_sktpScreenPosition + 3 ]&3;//screen pos x/y
+		if ( m_sktpRingFill < 5 )
+			return false;
+		u8 header[ 5 ];
+		copyFromSktpRing( header, 0, 5 );
+
+		u16 scrLength = header[ 1 ]; // this is only the lsb
 		if (type < 3 || type == 6)
-		{
-			scrLength += ((m_sktpScreenContent[ m_sktpScreenPosition + 3 ]&16)+ 
-									 (m_sktpScreenContent[ m_sktpScreenPosition + 3 ]&32)) *16; //msb bits
-		}
-		color        = m_sktpScreenContent[ m_sktpScreenPosition + 4 ];// this is gap in case 6
+			scrLength += ((header[ 3 ]&16) + (header[ 3 ]&32)) * 16; //msb bits
+		u16 startPos = (header[ 3 ]&3) * 256 + header[ 2 ];//screen pos x/y
+		u8 color = header[ 4 ];// this is gap in case 6
 		if ( type != 6)
-			color = color&127;//0-15 for c64, 0-127 for c264, this is gap in case 6
-		inverse    = m_sktpScreenContent[ m_sktpScreenPosition + 4 ]>>7;//test bit 8
-		startPos = startPosM * 256 + startPosL;//screen pos x/y
-		
+			color = color&127;//0-15 for c64, 0-127 for c264
+		boolean inverse = header[ 4 ]>>7;//test bit 8
+
 		//some plausibilty checks of the values
 		if (scrLength > 1000) scrLength = 1000;
 		if (startPos > 999) startPos = 999;
 		if (startPos + scrLength > 1001) scrLength = 1001 - startPos;
 
-		byteLength = scrLength;
-		
-		if ( type == 0 || type == 2)
+		unsigned byteLength = scrLength;
+		if ( type == 1 )
+			byteLength = 1;
+		else if ( type >= 5 )
+			byteLength = scrLength + 1;
+
+		chunkLength = 5 + byteLength;
+		if ( m_sktpRingFill < chunkLength )
+			return false;
+
+		u8 repeat = 1;
+		if ( type == 0 || type == 2 )
+			copyFromSktpRing( m_sktpScreenContentChunk, 5, scrLength );
+		else if ( type == 1 ) //repeat one single character for scrLength times
+			memset( m_sktpScreenContentChunk, peekSktpRing( 5 ), scrLength );
+		else //vertical repeat, paintbrush
 		{
-			memcpy( m_sktpScreenContentChunk, &m_sktpScreenContent[ m_sktpScreenPosition + 5], byteLength);
+			repeat = peekSktpRing( 5 );
+			copyFromSktpRing( m_sktpScreenContentChunk, 6, scrLength );
 		}
-		else if ( type == 1) //repeat one single character for scrLength times
+		m_sktpScreenContentChunk[scrLength] = '\0';
+
+		sktpPaintChunk( type, startPos, color, inverse, repeat, (char *) m_sktpScreenContentChunk );
+	}
+	else if ( type == 3 )
+	{
+		chunkLength = 2;
+		if ( m_sktpRingFill < chunkLength )
+			return false;
+		u8 timeout = peekSktpRing( 1 );
+		setSktpRefreshTimeout( timeout < 1 ? 1 : timeout); //minimum value
+	}
+	else if ( type == 4 )
+	{
+		chunkLength = 4;
+		if ( m_sktpRingFill < chunkLength )
+			return false;
+		sktpSetColorsAndCharset( peekSktpRing( 1 ) - 1, peekSktpRing( 2 ) - 1, peekSktpRing( 3 ) == 1 );
+	}
+	else if ( type == 9 )
+	{
+		//flags, frame id (2 bytes), base frame id (2 bytes), compressed length (2 bytes)
+		if ( m_sktpRingFill < 8 )
+			return false;
+		chunkLength = 8 + peekSktpRing( 6 ) + peekSktpRing( 7 ) * 256;
+		if ( chunkLength > SKTP_RING_SIZE )
 		{
-			byteLength = 1;
-			char fillChar = m_sktpScreenContent[ m_sktpScreenPosition + 5 ];
-			for (unsigned i = 0; i < scrLength; i++)
-				m_sktpScreenContentChunk[i] = fillChar;
+			logger->Write( "parseSktpChunk", LogError, "sktp frame too big: %u", chunkLength);
+			m_sktpParseState = SKTP_PARSE_DONE;
+			return false;
+		}
+		if ( m_sktpRingFill < chunkLength )
+			return false;
+		if ( !parseSktpFrame( chunkLength ) )
+		{
+			//we can't show this one, request a full frame with the next update
+			m_sktpFrameId = 0;
+			redrawSktpScreen();
+			setSktpRefreshTimeout( 1 );
+		}
+	}
+	else if ( type == 7 )
+	{
+		//same layout as the download command, nothing is painted after it
+		if ( m_sktpRingFill < 4 )
+			return false;
+		chunkLength = 4 + peekSktpRing( 1 ) + peekSktpRing( 2 );
+		if ( m_sktpRingFill < chunkLength )
+			return false;
+		if ( screenType == 1 ){
+			copyFromSktpRing( m_sktpScreenContentChunk, 0, chunkLength );
+			parseSKTPDownloadCommand( (char *) m_sktpScreenContentChunk, 1 );
+			m_isCSDBDownloadQueued = true;
+			m_queueDelay = 4;
 		}
-		else if (type >= 5) //paintbrush
+		m_sktpParseState = SKTP_PARSE_DONE;
+	}
+	else if ( type == 8 )
+	{
+		//3 bytes size, followed by the image which bypasses the ring buffer
+		if ( m_sktpRingFill < 4 )
+			return false;
+		m_sktpTGASize = peekSktpRing( 1 ) * 65536 + peekSktpRing( 2 ) * 256 + peekSktpRing( 3 );
+		m_sktpTGAFill = 0;
+		m_sktpRingStart += 4;
+		m_sktpRingFill -= 4;
+		if ( m_sktpTGASize > 1024 * 350)
 		{
-			repeat = m_sktpScreenContent[ m_sktpScreenPosition + 5 ];
-			memcpy( m_sktpScreenContentChunk, &m_sktpScreenContent[ m_sktpScreenPosition + 6], byteLength);
-			byteLength = byteLength + 1;
-		}	
+			logger->Write( "parseSktpChunk", LogNotice, "tga image too big: %u", m_sktpTGASize);
+			m_sktpParseState = SKTP_PARSE_DONE;
+			return false;
+		}
+		m_sktpParseState = SKTP_PARSE_TGA;
+		unsigned n = m_sktpRingFill < m_sktpTGASize ? m_sktpRingFill : m_sktpTGASize;
+		copyFromSktpRing( prgDataLaunch, 0, n );
+		m_sktpTGAFill = n;
+		m_sktpRingStart += n;
+		m_sktpRingFill -= n;
+		if ( m_sktpTGAFill == m_sktpTGASize )
+			showSktpTGAImage();
+		return false;
+	}
+	else
+	{
+		//in case of unknown chunk types we stop as we don't know how long they are
+		logger->Write( "parseSktpChunk", LogWarning, "sktp screen early exit, chunk type %u", type);
+		m_sktpParseState = SKTP_PARSE_DONE;
+		return false;
+	}
+
+	m_sktpRingStart += chunkLength;
+	m_sktpRingFill -= chunkLength;
+	return m_sktpParseState == SKTP_PARSE_CHUNKS;
+}
 
-		//logger->Write( "GetSktpScreenContentChunk", LogNotice, "Chunk parsed: length=%u, startPos=%u, color=%u ",scrLength, startPos, color);
-		m_sktpScreenPosition += 5+byteLength;//begin of next chunk
+/*
+	compressed frame layout (chunk type 9):
+	0    9
+	1    flags, bit 0 set: delta frame, XORed with the frame given as base
+	2-3  frame id (lsb first), 0 is never used
+	4-5  base frame id (only for delta frames)
+	6-7  length of the compressed data
+	8-   compressed data, SKTP_FRAME_SIZE bytes when decompressed
+
+	compressed data is a sequence of tokens:
+	0x00-0x7f  literal run, followed by token+1 bytes
+	0x80-0xff  match of (token & 0x7f) + 3 bytes, followed by the distance (2 bytes, lsb first)
+*/
+unsigned CSidekickNet::sktpDecompress( const u8 *pSrc, unsigned srcLength, u8 *pDest, unsigned destLength )
+{
+	unsigned s = 0, d = 0;
+	while ( s < srcLength )
+	{
+		u8 token = pSrc[ s++ ];
+		if ( token < 0x80 )
+		{
+			unsigned n = token + 1;
+			if ( s + n > srcLength || d + n > destLength )
+				return 0;
+			memcpy( &pDest[ d ], &pSrc[ s ], n );
+			s += n;
+			d += n;
+		}
+		else
+		{
+			unsigned n = ( token & 0x7f ) + 3;
+			if ( s + 2 > srcLength )
+				return 0;
+			unsigned distance = pSrc[ s ] + pSrc[ s + 1 ] * 256;
+			s += 2;
+			if ( distance == 0 || distance > d || d + n > destLength )
+				return 0;
+			//byte by byte as source and destination may overlap
+			for ( unsigned i = 0; i < n; i++, d++ )
+				pDest[ d ] = pDest[ d - distance ];
+		}
 	}
-	m_sktpScreenContentChunk[scrLength] = '\0';
-  return m_sktpScreenContentChunk;
+	return d;
 }
 
-boolean CSidekickNet::HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead )
+boolean CSidekickNet::parseSktpFrame( unsigned chunkLength )
+{
+	u8 flags = peekSktpRing( 1 );
+	u16 frameId = peekSktpRing( 2 ) + peekSktpRing( 3 ) * 256;
+	u16 baseId = peekSktpRing( 4 ) + peekSktpRing( 5 ) * 256;
+	boolean isDelta = flags & 1;
+
+	if ( isDelta && ( m_sktpFrameId == 0 || baseId != m_sktpFrameId ) )
+	{
+		logger->Write( "parseSktpFrame", LogWarning, "delta frame %u against unknown base %u (have %u)", frameId, baseId, m_sktpFrameId);
+		return false;
+	}
+
+	//compressed data and the decompressed frame both fit into the chunk buffer
+	u8 * pCompressed = m_sktpScreenContentChunk;
+	u8 * pDecompressed = &m_sktpScreenContentChunk[ SKTP_RING_SIZE ];
+	copyFromSktpRing( pCompressed, 8, chunkLength - 8 );
+	if ( sktpDecompress( pCompressed, chunkLength - 8, pDecompressed, SKTP_FRAME_SIZE ) != SKTP_FRAME_SIZE )
+	{
+		logger->Write( "parseSktpFrame", LogWarning, "could not decompress frame %u", frameId);
+		return false;
+	}
+
+	if ( isDelta )
+		for ( unsigned i = 0; i < SKTP_FRAME_SIZE; i++ )
+			m_sktpFrame[ i ] ^= pDecompressed[ i ];
+	else
+		memcpy( m_sktpFrame, pDecompressed, SKTP_FRAME_SIZE );
+	m_sktpFrameId = frameId;
+
+	sktpPaintFrame( m_sktpFrame, &m_sktpFrame[ SKTP_FRAME_SIZE / 2 ] );
+	return true;
+}
+
+void CSidekickNet::showSktpTGAImage()
+{
+	m_sktpParseState = SKTP_PARSE_DONE;
+	prgSizeLaunch = m_sktpTGASize;
+	prgDataLaunch[prgSizeLaunch+1] = '\0';
+	extern unsigned char tempTGA[ 256 * 256 * 4 ];
+	int w = 0, h = 0;
+	tftParseTGA( tempTGA, prgDataLaunch, &w, &h, false, prgSizeLaunch );
+	tftLoadBackgroundTGAMemory( tempTGA, 240, 240, false);
+	tftCopyBackground2Framebuffer();
+	if ( !tftIsFrameKnown() )
+		tftInitImm();
+	tftUpdateFramebuffer16BitImm( tftFrameBuffer );
+}
+
+boolean CSidekickNet::resolveHTTPTarget (remoteHTTPTarget & target)
 {
-	assert (pBuffer != 0);
-	unsigned nLength = nDocMaxSize;
-	if (m_loglevel > 3)
-		logger->Write( "HTTPGet", LogNotice, target.logPrefix, path );
 	//check if we need to resolve the target
 	if ( !target.valid)
 	{
@@ -1925,29 +2306,233 @@ boolean CSidekickNet::HTTPGet (remoteHTTPTarget & target, const char * path, cha
 			return false;
 		}
 	}
+	else
+	{
+		//cheap when answered from the DNS cache, picks up address changes after the cache entry expired
+		CIPAddress ip;
+		if ( m_DNSCache->Resolve( target.hostName, &ip ) )
+			target.ipAddress = ip;
+	}
+	return true;
+}
+
+boolean CSidekickNet::HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead )
+{
+	return HTTPGetConditional( target, path, pBuffer, nLengthRead, 0 ) == 200;
+}
+
+unsigned CSidekickNet::HTTPGetConditional (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead, THTTPValidators * pValidators )
+{
+	assert (pBuffer != 0);
+	unsigned nLength = nDocMaxSize;
+	if (m_loglevel > 3)
+		logger->Write( "HTTPGet", LogNotice, target.logPrefix, path );
+	if ( !resolveHTTPTarget( target ))
+		return 0;
 	
 #ifdef WITH_TLS	
-	CHTTPClient client( m_TLSSupport, target.ipAddress, target.port, target.hostName, target.port == 443 );
-	CircleMbedTLS::THTTPStatus Status = client.Get (path, (u8 *) pBuffer, &nLength);
-	if (Status != CircleMbedTLS::HTTPOK)
+	boolean useTLS = target.port == 443;
 #else
-	CHTTPClient client( m_Net, target.ipAddress, target.port, target.hostName );
-	::THTTPStatus Status = client.Get (path, (u8 *) pBuffer, &nLength);
-	if (Status != ::HTTPOK)
-	
-#endif	
-
+	boolean useTLS = false;
+#endif
+	//connections are kept open between requests, see httppool.h
+	unsigned Status = m_HTTPPool->Get( target.ipAddress, target.port, target.hostName, useTLS, path, (u8 *) pBuffer, &nLength, pValidators );
+	if (Status == 304 && pValidators != 0)
+	{
+		nLengthRead = 0;
+		return Status;
+	}
+	if (Status != 200)
 	{
 		if (m_loglevel > 0)
 			logger->Write( "HTTPGet", LogError, "Failed with status %u, >%s<", Status, path);
-		return false;
+		return Status;
 	}
 	assert (nLength <= nDocMaxSize);
 	pBuffer[nLength] = '\0';
 	nLengthRead = nLength;
+	return Status;
+}
+
+boolean CSidekickNet::HTTPGetStream (remoteHTTPTarget & target, const char * path, THTTPBodyHandler *pHandler, void *pParam, unsigned & nLengthRead )
+{
+	if (m_loglevel > 3)
+		logger->Write( "HTTPGetStream", LogNotice, target.logPrefix, path );
+	if ( !resolveHTTPTarget( target ))
+		return false;
+	
+#ifdef WITH_TLS	
+	boolean useTLS = target.port == 443;
+#else
+	boolean useTLS = false;
+#endif
+	unsigned nLength = 0;
+	unsigned Status = m_HTTPPool->Get( target.ipAddress, target.port, target.hostName, useTLS, path, pHandler, pParam, &nLength );
+	if (Status != 200)
+	{
+		if (m_loglevel > 0)
+			logger->Write( "HTTPGetStream", LogError, "Failed with status %u, >%s<", Status, path);
+		return false;
+	}
+	nLengthRead = nLength;
+	return true;
+}
+
+boolean CSidekickNet::downloadChunkHandler( const u8 *pData, unsigned length, void *pParam )
+{
+	TDownloadProgress * progress = (TDownloadProgress *) pParam;
+
+	//the pool has set the range to what the server actually sends (offset 0 on a complete response)
+	if ( progress->firstCall )
+	{
+		progress->position = progress->pRange->offset;
+		progress->firstCall = false;
+	}
+	if ( progress->position + length > progress->maxSize )
+	{
+		progress->tooLarge = true;
+		return false;
+	}
+	memcpy( progress->pBuffer + progress->position, pData, length );
+	progress->position += length;
+
+	if ( CTimer::GetClockTicks() - progress->lastReport >= NET_DOWNLOAD_PROGRESS_US )
+		progress->pNet->reportDownloadProgress( progress, progress->pRange->total );
 	return true;
 }
 
+void CSidekickNet::reportDownloadProgress( TDownloadProgress * progress, u32 total )
+{
+	unsigned now = CTimer::GetClockTicks();
+	unsigned elapsed = now - progress->startTicks;
+	u32 bytesPerSecond = elapsed > 0 ? (u32)( (u64)( progress->position - progress->startPosition ) * 1000000 / elapsed ) : 0;
+	progress->lastReport = now;
+
+	CString msg;
+	if ( total > 0 )
+		msg.Format( " Downloading %u/%u kb, %u kb/s", progress->position / 1024, total / 1024, bytesPerSecond / 1024 );
+	else
+		msg.Format( " Downloading %u kb, %u kb/s", progress->position / 1024, bytesPerSecond / 1024 );
+
+	//the status line is 40 chars wide
+	unsigned l = msg.GetLength();
+	if ( l > 40 ) l = 40;
+	memset( m_downloadStatusMsg, ' ', 40 );
+	memcpy( m_downloadStatusMsg, (const char *) msg, l );
+	m_downloadStatusMsg[40] = '\0';
+
+	m_networkActionStatusMsg = m_downloadStatusMsg;
+	setErrorMsgC64( m_downloadStatusMsg, false );
+}
+
+//downloads in parts with HTTP Range requests and continues after a failure where it stopped,
+//'received' is the number of bytes already in pBuffer (from an interrupted download) and the length on return.
+//Returns 200 when complete, 304 if the validators still match, otherwise the failing status (0 = no response)
+unsigned CSidekickNet::HTTPGetResumable (remoteHTTPTarget & target, const char * path, u8 *pBuffer, u32 maxSize, u32 & received, u32 & total, THTTPValidators * pValidators )
+{
+	TDownloadProgress progress;
+	progress.pNet = this;
+	progress.pBuffer = pBuffer;
+	progress.maxSize = maxSize;
+	progress.tooLarge = false;
+	progress.startPosition = received;
+	progress.startTicks = progress.lastReport = CTimer::GetClockTicks();
+
+#ifdef WITH_TLS	
+	boolean useTLS = target.port == 443;
+#else
+	boolean useTLS = false;
+#endif
+
+	unsigned status = 0;
+	unsigned failures = 0;
+	for ( ;; )
+	{
+		THTTPRange range = { received, NET_DOWNLOAD_CHUNK_SIZE, 0 };
+		progress.pRange = &range;
+		progress.firstCall = true;
+		progress.position = received;
+
+		unsigned nLength = 0;
+		status = 0;
+		if ( resolveHTTPTarget( target ))
+			status = m_HTTPPool->Get( target.ipAddress, target.port, target.hostName, useTLS, path, downloadChunkHandler, &progress, &nLength, &range, pValidators );
+
+		if ( status == 304 )
+			break;
+
+		if ( status == 200 || status == 206 )
+		{
+			received = progress.firstCall ? range.offset : progress.position;
+			failures = 0;
+			if ( status == 200 )
+			{
+				//the server doesn't support ranges or the file has changed: this was the whole file
+				total = received;
+				break;
+			}
+			total = range.total;
+			if ( ( total > 0 && received >= total ) || ( total == 0 && nLength < NET_DOWNLOAD_CHUNK_SIZE ) )
+			{
+				total = received;
+				status = 200;
+				break;
+			}
+			if ( total > 0 && total > maxSize )
+			{
+				logger->Write( "HTTPGetResumable", LogError, "Download too large (%u bytes), >%s<", total, path);
+				status = 413;
+				break;
+			}
+			continue;
+		}
+
+		if ( status == 416 && received > 0 && range.total == received )
+		{
+			//nothing left, an interrupted download which was complete after all
+			total = received;
+			status = 200;
+			break;
+		}
+		if ( status == 416 && received == 0 && range.total == 0 )
+		{
+			//a range starting at 0 is only unsatisfiable for an empty resource ("bytes */0")
+			total = 0;
+			status = 200;
+			break;
+		}
+
+		//a response with bytes of this part before the connection broke is kept
+		if ( status == 0 && !progress.firstCall )
+			received = progress.position;
+		if ( progress.tooLarge )
+		{
+			logger->Write( "HTTPGetResumable", LogError, "Download exceeds %u bytes, >%s<", maxSize, path);
+			break;
+		}
+		if ( status == 416 && received > 0 && ++failures <= NET_DOWNLOAD_RETRIES )
+		{
+			//the file has become shorter, start from scratch
+			received = 0;
+			if ( pValidators != 0 )
+				pValidators->eTag[0] = pValidators->lastModified[0] = '\0';
+		}
+		//any other 416 from the start won't change with another try
+		else if ( status != 0 || ++failures > NET_DOWNLOAD_RETRIES )
+		{
+			if (m_loglevel > 0)
+				logger->Write( "HTTPGetResumable", LogError, "Failed with status %u at %u bytes, >%s<", status, received, path);
+			break;
+		}
+		if (m_loglevel > 1)
+			logger->Write( "HTTPGetResumable", LogWarning, "Download interrupted at %u bytes, resuming (%u)", received, failures);
+		m_pScheduler->MsSleep( 250 * failures );
+	}
+
+	m_networkActionStatusMsg = (char *) "";
+	return status;
+}
+
 void CSidekickNet::updateSystemMonitor( size_t freeSpace, unsigned CpuTemp)
 {
 	m_sysMonHeapFree = freeSpace;
@@ -1975,6 +2560,48 @@ CString CSidekickNet::getSysMonInfo( unsigned details )
 	return m_sysMonInfo;
 }
 
+boolean CSidekickNet::runNetworkBenchmark()
+{
+	//the sktp host is the peer, e.g. Source/SKTPTestServer which answers the benchmark requests
+	m_benchResult.fiqOffMax = 0;
+	if ( !resolveHTTPTarget( m_SKTPServer ))
+	{
+		m_benchResult.valid = false;
+		strcpy( m_benchResult.error, "SKTP host not resolved" );
+		return false;
+	}
+	logger->Write( "runNetworkBenchmark", LogNotice, "Benchmark against %s:%u (%s)", (const char *) m_SKTPServer.hostName, m_SKTPServer.port, usesWLAN() ? "WLAN" : "ethernet");
+
+	CNetBenchmark benchmark( m_Net, m_HTTPPool );
+	boolean success = benchmark.Run( m_SKTPServer.ipAddress, m_SKTPServer.port, m_SKTPServer.hostName, &m_benchResult );
+	m_benchResult.cpuTemp = m_sysMonCPUTemp;
+	m_benchResult.heapFree = m_sysMonHeapFree;
+	return success;
+}
+
+//one line of the benchmark results for the network screen and the web interface
+CString CSidekickNet::getNetworkBenchmarkInfo( unsigned line )
+{
+	CString info = "";
+	if ( isNetworkBenchmarkRunning() )
+	{
+		if ( line == 0 )
+			info = "Benchmark is running...";
+	}
+	else if ( !m_benchResult.valid )
+	{
+		if ( line == 0 && m_benchResult.error[0] != '\0' )
+			info.Format( "Benchmark failed: %s", m_benchResult.error );
+	}
+	else if ( line == 0 )
+		info.Format( "Latency %u/%u/%u ms min/avg/max", m_benchResult.latencyMin / 1000, m_benchResult.latencyAvg / 1000, m_benchResult.latencyMax / 1000 );
+	else if ( line == 1 )
+		info.Format( "TCP down %u kb/s, up %u kb/s", m_benchResult.downloadRate / 1024, m_benchResult.uploadRate / 1024 );
+	else if ( line == 2 )
+		info.Format( "FIQ off max %u ms, CPU %02u'C", m_benchResult.fiqOffMax / 1000, m_benchResult.cpuTemp );
+	return info;
+}
+
 void CSidekickNet::requireCacheWellnessTreatment(){
 	m_kMenu->doCacheWellnessTreatment();
 }
@@ -2067,44 +2694,29 @@ void CSidekickNet::cleanUpModemEmuSocket()
 	m_modemCommand[0] = '\0';
 	m_socketHost[0] = '\0';
 
-	m_modemInputBufferPos = 0;
-	m_modemInputBufferLength = 0;
-	m_modemInputBuffer[0] = '\0';
-
-	m_modemOutputBufferPos = 0;
-	m_modemOutputBufferLength = 0;
-	m_modemOutputBuffer[0] = '\0';
-
+	//the bus emulation may still read from the buffers, drop the data from the respective side
+	m_modemInputBuffer.Discard();
+	m_wicInputBuffer.Discard();
+	m_modemOutputBuffer.Skip();
+	m_modemSendLength = 0;
 }
 
 int CSidekickNet::readCharFromFrontend( unsigned char * buffer)
 {
-		if ( m_modemEmuType == SK_MODEM_USERPORT_USB )
-		{
-			return m_pUSBSerial->Read(buffer, 1);
-		}
-		else if ( m_modemEmuType == SK_MODEM_SWIFTLINK || m_modemEmuType == SK_WIC64_EXP_EMULATION)
-		{
-			if (m_modemOutputBufferLength > 0)
-			{
-				if ( m_modemOutputBufferPos == m_modemOutputBufferLength)
-				{
-					m_modemOutputBufferLength = 0;
-					m_modemOutputBufferPos = 0;
-					//m_modemOutputBuffer = (char * ) "";
-					//m_modemOutputBuffer[0] = '\0';
-					logger->Write ("CSidekickNet", LogNotice, "readCharFromFrontend - resetting m_modemOutputBuffer to empty string");
-				}
-				else{
-					buffer[0] = m_modemOutputBuffer[m_modemOutputBufferPos++];
-					
-//					logger->Write ("CSidekickNet", LogNotice, "readCharFromFrontend - got '%u' (%c)from m_modemOutputBuffer",buffer[0], (buffer[0] > 31 && buffer[0] <126) ? buffer[0]:126 );
-					return 1;
-				}
-			}
-		}
-		buffer[0] = '0';
-		return 0;
+	return readCharsFromFrontend( buffer, 1 );
+}
+
+int CSidekickNet::readCharsFromFrontend( unsigned char * buffer, unsigned maxLength)
+{
+	if ( m_modemEmuType == SK_MODEM_USERPORT_USB )
+	{
+		return m_pUSBSerial->Read(buffer, maxLength);
+	}
+	else if ( m_modemEmuType == SK_MODEM_SWIFTLINK || m_modemEmuType == SK_WIC64_EXP_EMULATION)
+	{
+		return m_modemOutputBuffer.Read( buffer, maxLength );
+	}
+	return 0;
 }
 
 int CSidekickNet::writeCharsToFrontend( unsigned char * buffer, unsigned length)
@@ -2113,52 +2725,86 @@ int CSidekickNet::writeCharsToFrontend( unsigned char * buffer, unsigned length)
 	{
 		return m_pUSBSerial->Write(buffer, length);
 	}
-	else if ( m_modemEmuType == SK_MODEM_SWIFTLINK || m_modemEmuType == SK_WIC64_EXP_EMULATION )
+	else if ( m_modemEmuType == SK_WIC64_EXP_EMULATION )
 	{
-			if ( m_modemInputBufferLength > 0 && m_modemInputBufferPos == m_modemInputBufferLength )
-			{
-				m_modemInputBufferPos = 0;
-				m_modemInputBufferLength = 0;
-				m_modemInputBuffer[0] = '\0';
-				logger->Write ("CSidekickNet", LogNotice, "writeCharsToFrontend - resetting m_modemInputBuffer to empty string");
-			}
-			//char * tmp;
-			//memcpy( tmp, &buffer[0], length );
-		  //strcat( m_modemInputBuffer, tmp );
-			logger->Write ("CSidekickNet", LogNotice, "writeCharsToFrontend - adding %u to %u chars", length, m_modemInputBufferLength);
-			
-			//FIXME: add sanity length check
-			for ( unsigned c = 0; c < length; c++)
+		//the bus emulation is not running while a WiC64 response is queued, so nothing drains the buffer
+		unsigned written = m_wicInputBuffer.Write( buffer, length );
+		if ( written < length )
+			logger->Write ("CSidekickNet", LogWarning, "writeCharsToFrontend - WiC64 buffer overrun, dropped %u chars", length - written);
+		return written;
+	}
+	else if ( m_modemEmuType == SK_MODEM_SWIFTLINK )
+	{
+		#ifdef DEBUG_MODEM_EMULATION
+		logger->Write ("CSidekickNet", LogNotice, "writeCharsToFrontend - adding %u to %u chars", length, m_modemInputBuffer.Fill());
+		#endif
+		//the bus emulation drains the buffer while we wait, give up if the C64 stops reading
+		unsigned written = 0, lastProgress = m_pTimer->GetUptime();
+		while ( written < length )
+		{
+			unsigned n = m_modemInputBuffer.Write( &buffer[written], length - written );
+			written += n;
+			if ( n > 0 )
+				lastProgress = m_pTimer->GetUptime();
+			else if ( m_pTimer->GetUptime() - lastProgress > 2 )
 			{
-				m_modemInputBuffer[m_modemInputBufferLength] = buffer[c];
-				m_modemInputBufferLength++;
+				logger->Write ("CSidekickNet", LogWarning, "writeCharsToFrontend - buffer overrun, dropped %u chars", length - written);
+				break;
 			}
-			m_modemInputBuffer[m_modemInputBufferLength]  = '\0';
-			//strcat( m_modemInputBuffer, buffer );
-			//m_modemInputBufferLength += length;
-			return length;
+			else
+				m_pScheduler->Yield ();
+		}
+		return written;
 	}
-	buffer[0] = '0';
 	return 0;
 }
 
-unsigned char CSidekickNet::getCharFromInputBuffer()
+int CSidekickNet::putCharToFrontend( u8 c )
 {
-	if (m_modemInputBufferLength == 0 || m_modemInputBufferPos >= m_modemInputBufferLength ){
-			return 0;
+	return writeCharsToFrontend( &c, 1 );
+}
+
+//sends the chars collected from the C64 once enough are pending or the oldest has waited long enough
+boolean CSidekickNet::flushModemSendBuffer( boolean force )
+{
+	if ( m_modemSendLength == 0 )
+		return true;
+	if ( !force && m_modemSendLength < MODEM_SEND_BATCH && CTimer::GetClockTicks() - m_modemSendSince < MODEM_SEND_COALESCE_US )
+		return true;
+
+	int x = m_pBBSSocket->Send (m_modemSendBuffer, m_modemSendLength, 0); //MSG_DONTWAIT);
+	m_modemSendLength = 0;
+	if (x < 0 )
+	{
+		logger->Write ("CSidekickNet", LogNotice, "ERROR - error on socket send");
+		return false;
 	}
-	unsigned char payload = m_modemInputBuffer[m_modemInputBufferPos++];
+	if ( m_modemEmuType == SK_MODEM_SWIFTLINK)
+		m_isBBSSocketFirstReceive = true;
+	return true;
+}
+
+//called by the bus emulation (FIQ)
+unsigned char CSidekickNet::getCharFromInputBuffer()
+{
+	u8 payload = 0;
+	if ( m_modemEmuType == SK_WIC64_EXP_EMULATION )
+		m_wicInputBuffer.Get( &payload );
+	else
+		m_modemInputBuffer.Get( &payload );
 	return payload;
 }
 
 bool CSidekickNet::areCharsInInputBuffer()
 {
-	return ( m_modemInputBufferLength > 0 && m_modemInputBufferPos < m_modemInputBufferLength );
+	if ( m_modemEmuType == SK_WIC64_EXP_EMULATION )
+		return !m_wicInputBuffer.IsEmpty();
+	return !m_modemInputBuffer.IsEmpty();
 }
 
 bool CSidekickNet::areCharsInOutputBuffer()
 {
-	return ( m_modemOutputBufferLength > 0 && m_modemOutputBufferPos < m_modemOutputBufferLength );
+	return !m_modemOutputBuffer.IsEmpty();
 }
 
 void CSidekickNet::launchWiCCommand( u8 cmd, u8 cmdState ){
@@ -2219,18 +2865,23 @@ void CSidekickNet::launchWiCCommand( u8 cmd, u8 cmdState ){
 			{
 				if ( m_sktpResponseLength > 0 )
 				{
-					m_modemInputBufferPos = 0;
-					m_modemInputBufferLength = 0;
-					m_modemInputBuffer[0] = '\0';
+					//the FIQ is disconnected while the command is processed
+					m_wicInputBuffer.Clear();
 
+					//the WiC64 protocol has a 16 bit length field
+					if ( m_sktpResponseLength > 65535 )
+					{
+						logger->Write ("launchWiCCommand", LogWarning, "response of %u bytes truncated to 65535", m_sktpResponseLength );
+						m_sktpResponseLength = 65535;
+					}
 					u8 lsb = (m_sktpResponseLength) % 256;
 					u8 msb = (m_sktpResponseLength) / 256;
 					logger->Write ("launchWiCCommand", LogNotice, "payload length %u msb: %u lsb: %u payload '%s'",m_sktpResponseLength,msb,lsb, pResponseBuffer  );
 					if (m_sktpResponseLength == 1)
 						logger->Write ("launchWiCCommand", LogNotice, "Disclosing payload: '%s' %i", pResponseBuffer[0],pResponseBuffer[0] );
-					i= writeCharsToFrontend( (unsigned char *)65, 1); //dummy byte
-					i= writeCharsToFrontend( (unsigned char *)msb, 1);
-					i= writeCharsToFrontend( (unsigned char *)lsb, 1);
+					i= putCharToFrontend( 65 ); //dummy byte
+					i= putCharToFrontend( msb );
+					i= putCharToFrontend( lsb );
 					i= writeCharsToFrontend( (unsigned char *)pResponseBuffer, m_sktpResponseLength);
 					//i= writeCharsToFrontend( (unsigned char *)66, 1); //dummy byte
 				}
@@ -2244,9 +2895,9 @@ void CSidekickNet::launchWiCCommand( u8 cmd, u8 cmdState ){
 			GetNetConfig()->GetIPAddress ()->Format (&strHelper);
 			unsigned l = sprintf( (char* )tmp, strHelper );
 			//logger->Write ("CSidekickNet", LogNotice, "get ip: sh:'%s', tmp:'%s'", strHelper, tmp );
-			i= writeCharsToFrontend( (unsigned char *)65, 1); //dummy byte
-			i= writeCharsToFrontend( (unsigned char *)0, 1);
-			i= writeCharsToFrontend( (unsigned char *)l, 1);
+			i= putCharToFrontend( 65 ); //dummy byte
+			i= putCharToFrontend( 0 );
+			i= putCharToFrontend( l );
 			i = writeCharsToFrontend(tmp, l);
 		}
 		else if (cmd == 8) // set default server
@@ -2265,9 +2916,9 @@ void CSidekickNet::launchWiCCommand( u8 cmd, u8 cmdState ){
 		else if (cmd == 10) // get connected wlan name
 		{
 			logger->Write ("launchWiCCommand", LogNotice, "processing wic command 10: get connected wlan name: '%s'",m_modemCommand);
-			i= writeCharsToFrontend( (unsigned char *)65, 1); //dummy byte
-			i= writeCharsToFrontend( (unsigned char *)0, 1);
-			i= writeCharsToFrontend( (unsigned char *)12, 1);
+			i= putCharToFrontend( 65 ); //dummy byte
+			i= putCharToFrontend( 0 );
+			i= putCharToFrontend( 12 );
 			i= writeCharsToFrontend((unsigned char *)"sidekickwlan", 12);
 		}
 		else{
@@ -2293,7 +2944,7 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 	//	usbPnPUpdate(); //still try to detect usb modem hot plugged
 
 	if ( m_modemEmuType == SK_WIC64_EXP_EMULATION ){
-		if (strcmp( m_currentKernelRunning, "m" ) == 0 && (m_modemInputBufferLength + m_modemOutputBufferLength + m_modemCommandLength) >0 )
+		if (strcmp( m_currentKernelRunning, "m" ) == 0 && (!m_wicInputBuffer.IsEmpty() || !m_modemOutputBuffer.IsEmpty() || m_modemCommandLength > 0) )
 			cleanUpModemEmuSocket();
 		handleWiC64ExpEmulation(silent);
 		return;
@@ -2334,36 +2985,33 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 		bool noCarrier = false;
 
 		int x = 0;
-		int fromFrontend = readCharFromFrontend( inputChar );
-		if ( fromFrontend > 0 )
+		int fromFrontend = readCharsFromFrontend( inputChar, MODEM_SEND_BATCH - m_modemSendLength );
+		for ( int c = 0; c < fromFrontend; c++ )
 		{
-			
-			if ( fromFrontend == 1 && inputChar[0] == '+')
+			if ( inputChar[c] == '+' )
 				m_BBSSocketDisconnectPlusCount++;
 			else
-				m_BBSSocketDisconnectPlusCount=0;
-			if ( m_BBSSocketDisconnectPlusCount >= 3)
-			{
-				logger->Write ("CSidekickNet", LogNotice, "+++ hanging up");
-				int a = writeCharsToFrontend((unsigned char *)"hanging up\r", 11);
-				cleanUpModemEmuSocket();
-				return;
-			}
-			else
-			{
-				//if ( !silent)
-					logger->Write ("CSidekickNet", LogNotice, "Terminal: sent %i chars to modem", fromFrontend);
-//				m_pScheduler->Yield ();
-				x = m_pBBSSocket->Send (inputChar, fromFrontend, 0); //MSG_DONTWAIT);
-				if (x < 0 )
-				{
-					logger->Write ("CSidekickNet", LogNotice, "ERROR - error on socket send");
-					noCarrier = true;
-				}
-				if ( m_modemEmuType == SK_MODEM_SWIFTLINK)
-					m_isBBSSocketFirstReceive = true;
-			}
+				m_BBSSocketDisconnectPlusCount = 0;
+		}
+		if ( m_BBSSocketDisconnectPlusCount >= 3)
+		{
+			logger->Write ("CSidekickNet", LogNotice, "+++ hanging up");
+			int a = writeCharsToFrontend((unsigned char *)"hanging up\r", 11);
+			cleanUpModemEmuSocket();
+			return;
+		}
+		if ( fromFrontend > 0 )
+		{
+			#ifdef DEBUG_MODEM_EMULATION
+			logger->Write ("CSidekickNet", LogNotice, "Terminal: sent %i chars to modem", fromFrontend);
+			#endif
+			if ( m_modemSendLength == 0 )
+				m_modemSendSince = CTimer::GetClockTicks();
+			memcpy( &m_modemSendBuffer[m_modemSendLength], inputChar, fromFrontend );
+			m_modemSendLength += fromFrontend;
 		}
+		if ( !flushModemSendBuffer( false ) )
+			noCarrier = true;
 
 //m_isBBSSocketFirstReceive = false;
 		
@@ -2380,6 +3028,9 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 		while (again)
 		{
 			attempts++;
+			//leave the data in the socket (and let TCP throttle the sender) while the C64 is still busy
+			if ( m_modemInputBuffer.Free() < MODEM_RECEIVE_MIN )
+				break;
 			x = m_pBBSSocket->Receive ( buffer, bsize -2, m_isBBSSocketFirstReceive ? 0 : MSG_DONTWAIT);
 			m_pScheduler->Yield ();
 			m_pScheduler->Yield ();
@@ -2387,7 +3038,9 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			if (x > 0)
 			{
 				int a = writeCharsToFrontend(buffer, x);
+				#ifdef DEBUG_MODEM_EMULATION
 				logger->Write ("CSidekickNet", LogNotice, "Terminal: wrote %u chars to frontend", x);
+				#endif
 				harvest += x;
 			}
 			else if (x < 0 )
@@ -2421,8 +3074,10 @@ void CSidekickNet::handleModemEmulation( bool silent = false)
 			m_isBBSSocketFirstReceive = false;
 			
 		}
+		#ifdef DEBUG_MODEM_EMULATION
 		if (harvest > 0) 
 			logger->Write ("CSidekickNet", LogNotice, "Terminal: %u attempts. harvest %u", attempts, harvest);
+		#endif
 
 		if ( noCarrier )
 		{
@@ -2780,63 +3435,65 @@ void CSidekickNet::SocketConnectIP( CIPAddress bbsIP, unsigned port )
 	}
 }
 
+//modem phonebook: keyword (as dialed with atd), host, port, baud rate (0: unchanged),
+//prefetch: keep the host resolved in the DNS cache (not for hosts which only resolve in some LAN)
+typedef struct {
+	const char * keyword;
+	const char * host;
+	unsigned port;
+	unsigned baudRate;
+	boolean prefetch;
+} modemShortcut;
+
+static const modemShortcut modemShortcuts[] = {
+	//Quantum Link / QLink
+	{ "t 5551212", "q-link.net", 5190, 1200, true },
+	{ "t5551212",  "q-link.net", 5190, 1200, true },
+	//BTX: btx.hanse.de or 195.201.94.166, could be two different instances
+	{ "t01910", "static.166.94.201.195.clients.your-server.de", 20000, 2400, true }, // Plus/4 online
+	{ "190",    "static.166.94.201.195.clients.your-server.de", 20000, 1200, true },
+	{ "btx",    "static.166.94.201.195.clients.your-server.de", 20000, 1200, true },
+	{ "@habitat", "neohabitat.demo.spi.ne", 1986, 1200, true },
+	{ "@qw", "ryzentux", 64128, 0, false },
+	{ "@rf", "rapidfire.hopto.org", 64128, 0, true },
+	{ "@ro", "raveolution.hopto.org", 64128, 0, true },
+	{ "@rc", "bbs.retrocampus.com", 6510, 0, true },
+	{ "@cm", "coffeemud.net", 2323, 0, true },
+	{ "@dnsfail", "doesnotexist246789.hopto.org.bla", 64128, 0, false } //test dns resolve fail
+};
+
+#define MODEM_SHORTCUTS (sizeof( modemShortcuts ) / sizeof( modemShortcuts[ 0 ] ))
+
 boolean CSidekickNet::checkShortcut( char * keyword, bool silent )
 {
-	boolean found = true;
 	logger->Write ("CSidekickNet", LogNotice, "keyword: '%s'", keyword);
-	//unsigned key = atoi(keyword);
-	//shortcuts for btx, qlink, habitat
-	//Quantum Link / QLink
-	if (strcmp(keyword, "t 5551212") == 0 ||
-					strcmp(keyword, "t5551212") == 0 )
-	{
-		setModemEmuBaudrate(1200);
-		SocketConnect("q-link.net", 5190, silent);
-	}
-	//BTX
-	else if (
-		strcmp(keyword, "t01910") == 0 || 
-		strcmp(keyword, "190") == 0 || 
-		strcmp(keyword, "btx") == 0
-	){
-		if (strcmp(keyword, "t01910") == 0 )
-			setModemEmuBaudrate(2400); // Plus/4 online
-		else
-			setModemEmuBaudrate(1200);
-		
-		//btx.hanse.de or 195.201.94.166, could be two different instances
-		//static const u8 btx[] = {195, 201, 94, 166}; //lazy, avoiding resolve
-		//CIPAddress BTXIPAddress;
-		//BTXIPAddress.Set(btx);
-		//SocketConnectIP(BTXIPAddress, 20000);
-		SocketConnect("static.166.94.201.195.clients.your-server.de", 20000, silent);
-	}
-	else if (strcmp(keyword, "@habitat") == 0)
-	{
-		setModemEmuBaudrate(1200);
-		SocketConnect("neohabitat.demo.spi.ne", 1986, silent);
-	}
-	else if (strcmp(keyword, "@qw") == 0)
-		SocketConnect("ryzentux", 64128, silent);
-	else if (strcmp(keyword, "@rf") == 0)
-		SocketConnect("rapidfire.hopto.org", 64128, silent);
-	else if (strcmp(keyword, "@ro") == 0)
-		SocketConnect("raveolution.hopto.org", 64128, silent);
-	else if (strcmp(keyword, "@rc") == 0)
-		SocketConnect("bbs.retrocampus.com", 6510, silent);
-	else if (strcmp(keyword, "@cm") == 0)
-		SocketConnect("coffeemud.net", 2323, silent);
-	else if (strcmp(keyword, "@dnsfail") == 0)
-		SocketConnect("doesnotexist246789.hopto.org.bla", 64128, silent); //test dns resolve fail
-	else
-		found = false;
-	return found;
+	for (unsigned i = 0; i < MODEM_SHORTCUTS; i++)
+	{
+		if (strcmp(keyword, modemShortcuts[i].keyword) == 0)
+		{
+			if ( modemShortcuts[i].baudRate != 0 )
+				setModemEmuBaudrate( modemShortcuts[i].baudRate );
+			SocketConnect( (char *) modemShortcuts[i].host, modemShortcuts[i].port, silent);
+			return true;
+		}
+	}
+	return false;
+}
+
+//dialing a phonebook entry doesn't have to wait for DNS as its host is kept resolved
+void CSidekickNet::prefetchModemShortcuts()
+{
+	if ( m_DNSCache == 0 )
+		return;
+	for (unsigned i = 0; i < MODEM_SHORTCUTS; i++)
+		if ( modemShortcuts[i].prefetch )
+			m_DNSCache->Prefetch( modemShortcuts[i].host );
 }
 
+//called by the bus emulation (FIQ), chars are dropped if the main loop doesn't keep up
 void CSidekickNet::addToModemOutputBuffer( unsigned char mchar)
 {
-	m_modemOutputBuffer[m_modemOutputBufferLength++] = mchar;
-	m_modemOutputBuffer[m_modemOutputBufferLength] = '\0';
+	m_modemOutputBuffer.Put( mchar );
 }
 
 unsigned CSidekickNet::getModemEmuType(){
@@ -2845,6 +3502,8 @@ unsigned CSidekickNet::getModemEmuType(){
 
 void CSidekickNet::setModemEmuType( unsigned type ){
 	m_modemEmuType = type;
+	if ( type != 0 )
+		prefetchModemShortcuts();
 }
 
 bool CSidekickNet::isModemSocketConnected(){
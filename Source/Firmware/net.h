@@ -49,6 +49,12 @@
 #include <SDCard/emmc.h>
 
 #include "webserver.h"
+#include "httppool.h"
+#include "dnscache.h"
+#include "ringbuffer.h"
+#include "networker.h"
+#include "netbench.h"
+#include "uploadserver.h"
 
 #ifndef WITHOUT_STDLIB
 #include <circle_glue.h>
@@ -76,6 +82,45 @@ class CKernelMenu;
 
 extern CLogger *logger;
 
+//implemented by the menu screen (c64screen.cpp/264screen.cpp): the streaming SKTP
+//parser paints each chunk into a private screen as soon as it has been received,
+//sktpShowScreen hands the finished screen to the menu
+extern void sktpBeginScreen( boolean clear );
+extern void sktpPaintChunk( u8 type, u16 pos, u8 color, boolean inverse, u8 repeat, char * content );
+extern void sktpSetColorsAndCharset( u8 borderColor, u8 bgColor, boolean lowerCharset );
+extern void sktpPaintFrame( const u8 * screen, const u8 * color );
+extern void sktpShowScreen();
+
+//size of the ring buffer of the SKTP parser, power of two and larger than the largest chunk (6 + 1000 bytes)
+#define SKTP_RING_SIZE 4096
+
+// modem emulation (Swiftlink, WiC64): ring buffers between the bus emulation and the socket
+#define MODEM_OUTPUT_BUFFER_SIZE	1024	// C64 -> socket
+#define MODEM_INPUT_BUFFER_SIZE		8192	// socket -> C64
+#define WIC64_INPUT_BUFFER_SIZE		131072	// HTTP response -> C64, holds the largest WiC64 response (64 KB) plus its header
+// chars typed on the C64 are sent when this many are pending or the oldest one has waited MODEM_SEND_COALESCE_US
+#define MODEM_SEND_BATCH			256
+#define MODEM_SEND_COALESCE_US		4000
+// CSocket::Receive needs a buffer of at least FRAME_BUFFER_SIZE, we don't receive unless this much fits
+#define MODEM_RECEIVE_MIN			1600
+//#define DEBUG_MODEM_EMULATION
+#define SKTP_FRAME_SIZE 2000 // 1000 screen codes followed by 1000 colors
+
+// downloads (CSDb, HVSC, ...) are cached on the SD card, keyed by URL; entries younger than
+// NET_DOWNLOAD_CACHE_FRESH seconds are used right away, older ones are revalidated with the server
+#define NET_DOWNLOAD_CACHE_FOLDER		"SD:C64/NETCACHE"
+#define NET_DOWNLOAD_CACHE_MAX_ENTRIES	128
+#define NET_DOWNLOAD_CACHE_MAX_SIZE		(64*1024*1024)
+#define NET_DOWNLOAD_CACHE_FRESH		3600
+
+// downloads are requested in parts of this size (HTTP Range); after a failure the download continues where
+// it stopped, NET_DOWNLOAD_RETRIES times in a row. Interrupted downloads are kept in the download cache and resumed
+// when they are requested again
+#define NET_DOWNLOAD_CHUNK_SIZE			(256*1024)
+#define NET_DOWNLOAD_RETRIES			5
+// interval of the progress updates on the status line (microseconds)
+#define NET_DOWNLOAD_PROGRESS_US		500000
+
 #ifdef WITH_TLS
 using namespace CircleMbedTLS;
 #endif
@@ -109,13 +154,19 @@ public:
 	bool isSKTPRefreshWaiting();
 	void cancelSKTPRefresh();
 	void setSktpRefreshTimeout( unsigned timeout);
-	void queuedSktpRefreshAllowed();
+	boolean queuedSktpRefreshAllowed();
 	void handleQueuedNetworkAction();
+	void processQueuedNetworkAction();
 	void drawTGAImageOnTFT();
 	void getCSDBBinaryContent();
 	boolean isLibOpenMPTFileType( char *);
 	u8 getCSDBDownloadLaunchType();
 	boolean isAnyNetworkActionQueued();
+	void handleNetworkResults();
+	void queueNetworkBenchmark();
+	boolean isNetworkBenchmarkRunning();
+	boolean runNetworkBenchmark();
+	CString getNetworkBenchmarkInfo( unsigned );
 	void saveDownload2SD();
 	void cleanupDownloadData();
 	boolean checkForFinishedDownload();
@@ -123,23 +174,12 @@ public:
 	boolean isDownloadReadyForLaunch();
 	boolean RaspiHasOnlyWLAN();
 	void setSavePath(char*);
-	boolean IsSktpScreenContentEndReached();
-	boolean IsSktpScreenToBeCleared();
-	boolean IsSktpScreenUnchanged();
 	char * getNetworkActionStatusMessage();
-  unsigned char * getSktpScreenContent(){ return m_sktpScreenContent; };
-	u8 GetSktpScreenContentChunkType();
-	boolean getSKTPBorderBGColorCharset( u8 &borderColor, u8 &bgColor);
-	void enableSktpRefreshTimeout();
-	void prepareDownloadOfTGAImage();
-	void updateTGAImageFromSKTPChunk();
-	unsigned char * GetSktpScreenContentChunk( u16 & startPos, u8 &color, boolean & inverse, u8 &repeat );
 	CString getTimeString();
 	CString getUptime();
 	CNetConfig * GetNetConfig();
 	CString getRaspiModelName();
 	CString getSysMonInfo( unsigned );
-	void ResetSktpScreenContentChunks();
 	void setErrorMsgC64( char *, boolean );
 	void resetSktpSession();
 	boolean launchSktpSession();
@@ -160,6 +200,7 @@ public:
 	void requireCacheWellnessTreatment();
 	//void getNetRAM( u8 *, u32 *);
 	void prepareLaunchOfUpload( char *, char *, u8, char * );
+	const char * getKernelImageFilename();
 	CString getBaudrate();
 	CString getPRGLaunchTweakValueAsString();
 	u8 getPRGLaunchTweakValue();
@@ -211,17 +252,50 @@ private:
 	boolean Prepare ();
 	void EnableWebserver();
 	CIPAddress getIPForHost( const char *, bool & );
+	boolean resolveHTTPTarget (remoteHTTPTarget & target);
 	boolean HTTPGet (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead);
+	unsigned HTTPGetConditional (remoteHTTPTarget & target, const char * path, char *pBuffer, unsigned & nLengthRead, THTTPValidators * pValidators);
+	boolean HTTPGetStream (remoteHTTPTarget & target, const char * path, THTTPBodyHandler *pHandler, void *pParam, unsigned & nLengthRead);
+
+	typedef struct {
+		CSidekickNet * pNet;
+		u8 * pBuffer;
+		u32 maxSize;
+		THTTPRange * pRange;
+		boolean firstCall;
+		boolean tooLarge;
+		u32 position;
+		u32 startPosition;
+		unsigned startTicks;
+		unsigned lastReport;
+	} TDownloadProgress;
+
+	unsigned HTTPGetResumable (remoteHTTPTarget & target, const char * path, u8 *pBuffer, u32 maxSize, u32 & received, u32 & total, THTTPValidators * pValidators);
+	static boolean downloadChunkHandler( const u8 *pData, unsigned length, void *pParam );
+	void reportDownloadProgress( TDownloadProgress * progress, u32 total );
+	static boolean sktpBodyHandler( const u8 *pData, unsigned length, void *pParam );
+	static unsigned sktpDecompress( const u8 *pSrc, unsigned srcLength, u8 *pDest, unsigned destLength );
+	boolean parseSktpFrame( unsigned chunkLength );
+	void resetSktpParser();
+	boolean feedSktpParser( const u8 *pData, unsigned length );
+	boolean parseSktpChunk();
+	u8 peekSktpRing( unsigned offset );
+	void copyFromSktpRing( u8 * pDest, unsigned offset, unsigned length );
+	void showSktpTGAImage();
 	boolean parseURL( remoteHTTPTarget &, char *, u16);
 	void usbPnPUpdate();
 	void cleanUpModemEmuSocket();
 	int readCharFromFrontend( unsigned char * );
+	int readCharsFromFrontend( unsigned char *, unsigned maxLength);
 	int writeCharsToFrontend( unsigned char *, unsigned length);
+	int putCharToFrontend( u8 );
+	boolean flushModemSendBuffer( boolean force );
 	void handleModemEmulationCommandMode( bool );
 	void SendErrorResponse();
 	void SocketConnect( char *, unsigned, bool );
 	void SocketConnectIP( CIPAddress, unsigned );
 	boolean checkShortcut( char *, bool);
+	void prefetchModemShortcuts();
 	void setModemEmuBaudrate( unsigned );
 	boolean IsStillRunning ( void );
 
@@ -242,12 +316,15 @@ private:
 #ifdef WITH_WLAN
 	CWPASupplicant    * m_WPASupplicant;	
 #endif
-  CDNSClient        * m_DNSClient;
+  CDNSCache         * m_DNSCache;
 #ifdef WITH_TLS	
 	CTLSSimpleSupport * m_TLSSupport;
 #endif	
+	CHTTPConnectionPool * m_HTTPPool;
+	CNetWorker        * m_NetWorker;
 	//CActLED							m_ActLED;
 	CWebServer        * m_WebServer;
+	CUploadServer     * m_UploadServer;
 	CUSBSerialDevice * volatile m_pUSBSerial;
 	CUSBMIDIDevice * volatile m_pUSBMidi;
 	CDeviceNameService	* m_DeviceNameService;
@@ -269,7 +346,7 @@ private:
 	boolean m_isRebootRequested;
 	boolean m_isReturnToMenuRequested;
 	char * m_networkActionStatusMsg;
-	unsigned char * m_sktpScreenContent;
+	char m_downloadStatusMsg[41];
 	char * m_sktpSessionID;
 	char m_CSDBDownloadPath[256];
 	char m_CSDBDownloadExtension[4];
@@ -285,9 +362,18 @@ private:
 	unsigned m_skipSktpRefresh;
 	unsigned m_sktpRefreshTimeout;
 	boolean  m_sktpRefreshWaiting;
-	unsigned m_sktpScreenPosition;
 	unsigned m_sktpResponseLength;
 	unsigned m_sktpResponseType;
+	//streaming SKTP parser: the response is fed into the ring buffer and decoded chunk by chunk
+	enum { SKTP_PARSE_RESPONSE_TYPE, SKTP_PARSE_CHUNKS, SKTP_PARSE_DOWNLOAD, SKTP_PARSE_TGA, SKTP_PARSE_DONE } m_sktpParseState;
+	u8       m_sktpRing[ SKTP_RING_SIZE ];
+	unsigned m_sktpRingStart;
+	unsigned m_sktpRingFill;
+	unsigned m_sktpTGASize;
+	unsigned m_sktpTGAFill;
+	//last complete frame received, the server sends delta frames against it
+	u8       m_sktpFrame[ SKTP_FRAME_SIZE ];
+	u16      m_sktpFrameId;
 	unsigned m_sktpKey;
 	unsigned m_sktpSession;
  	unsigned m_sktpScreenErrorCode;
@@ -304,18 +390,21 @@ private:
 	unsigned m_videoFrameCounter;
 	size_t m_sysMonHeapFree;
 	unsigned m_sysMonCPUTemp;
+	boolean m_isBenchmarkQueued;
+	volatile boolean m_isBenchmarkRunning;
+	TNetBenchmarkResult m_benchResult;
 	unsigned m_loglevel;
 	char * m_currentKernelRunning;
 	signed m_oldSecondsLeft;
 	char * m_modemCommand;
 	unsigned m_modemCommandLength;
 	unsigned m_modemEmuType;
-	unsigned char m_modemOutputBuffer[512];
-	unsigned char m_modemInputBuffer[8192];
-	unsigned m_modemOutputBufferLength;
-	unsigned m_modemOutputBufferPos;
-	unsigned m_modemInputBufferLength;
-	unsigned m_modemInputBufferPos;
+	CRingBuffer<MODEM_OUTPUT_BUFFER_SIZE> m_modemOutputBuffer;
+	CRingBuffer<MODEM_INPUT_BUFFER_SIZE> m_modemInputBuffer;
+	CRingBuffer<WIC64_INPUT_BUFFER_SIZE> m_wicInputBuffer;
+	unsigned char m_modemSendBuffer[MODEM_SEND_BATCH];
+	unsigned m_modemSendLength;
+	unsigned m_modemSendSince;
 	char m_socketHost[256];
 	unsigned m_socketPort;
 	unsigned m_baudRate;
@@ -0,0 +1,200 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ netbench.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - network throughput and latency benchmark
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "netbench.h"
+#include <circle/net/socket.h>
+#include <circle/net/in.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+
+extern CLogger *logger;
+
+// payload per Send() call of the upload test, stays below the TCP segment size
+#define NET_BENCH_SEND_CHUNK	1024
+
+CNetBenchmark::CNetBenchmark( CNetSubSystem *pNet, CHTTPConnectionPool *pPool )
+:	m_pNet( pNet ),
+	m_pPool( pPool ),
+	m_nPort( 0 ),
+	m_pHostName( 0 )
+{
+}
+
+CNetBenchmark::~CNetBenchmark()
+{
+}
+
+unsigned CNetBenchmark::rate( unsigned bytes, unsigned us )
+{
+	if ( us == 0 ) us = 1;
+	return (unsigned)( (u64)bytes * 1000000 / us );
+}
+
+boolean CNetBenchmark::Run( CIPAddress &ipAddress, unsigned port, const char *hostName, TNetBenchmarkResult *pResult )
+{
+	m_IPAddress.Set( ipAddress );
+	m_nPort = port;
+	m_pHostName = hostName;
+
+	pResult->valid = false;
+	pResult->error[ 0 ] = 0;
+
+	if ( !measureLatency( pResult ) || !measureDownload( pResult ) || !measureUpload( pResult ) )
+	{
+		logger->Write( "NetBenchmark", LogWarning, "Benchmark against %s:%u failed: %s", hostName, port, pResult->error );
+		return false;
+	}
+
+	pResult->valid = true;
+	logger->Write( "NetBenchmark", LogNotice, "Latency %u/%u/%u us, download %u B/s, upload %u B/s",
+		pResult->latencyMin, pResult->latencyAvg, pResult->latencyMax, pResult->downloadRate, pResult->uploadRate );
+	return true;
+}
+
+boolean CNetBenchmark::measureLatency( TNetBenchmarkResult *pResult )
+{
+	u8 buffer[ 64 ];
+	unsigned total = 0;
+	pResult->latencyMin = ~0u;
+	pResult->latencyMax = 0;
+
+	// the first request opens the connection and is not counted
+	for ( unsigned i = 0; i <= NET_BENCH_LATENCY_REQUESTS; i++ )
+	{
+		unsigned length = sizeof( buffer );
+		unsigned start = CTimer::GetClockTicks();
+		unsigned status = m_pPool->Get( m_IPAddress, m_nPort, m_pHostName, false, NET_BENCH_PATH "?bytes=0", buffer, &length );
+		unsigned us = CTimer::GetClockTicks() - start;
+
+		if ( status != 200 )
+		{
+			strcpy( pResult->error, status == 0 ? "No response" : "Peer lacks " NET_BENCH_PATH );
+			return false;
+		}
+		if ( i == 0 )
+			continue;
+
+		total += us;
+		if ( us < pResult->latencyMin ) pResult->latencyMin = us;
+		if ( us > pResult->latencyMax ) pResult->latencyMax = us;
+	}
+	pResult->latencyAvg = total / NET_BENCH_LATENCY_REQUESTS;
+	return true;
+}
+
+boolean CNetBenchmark::countBody( const u8 *pData, unsigned length, void *pParam )
+{
+	*(unsigned *)pParam += length;
+	return true;
+}
+
+boolean CNetBenchmark::measureDownload( TNetBenchmarkResult *pResult )
+{
+	CString path;
+	path.Format( NET_BENCH_PATH "?bytes=%u", NET_BENCH_DOWNLOAD_SIZE );
+
+	unsigned received = 0, length = 0;
+	unsigned start = CTimer::GetClockTicks();
+	unsigned status = m_pPool->Get( m_IPAddress, m_nPort, m_pHostName, false, path, countBody, &received, &length );
+	unsigned us = CTimer::GetClockTicks() - start;
+
+	if ( status != 200 || received != NET_BENCH_DOWNLOAD_SIZE )
+	{
+		strcpy( pResult->error, "Download test failed" );
+		return false;
+	}
+	pResult->downloadRate = rate( received, us );
+	return true;
+}
+
+boolean CNetBenchmark::measureUpload( TNetBenchmarkResult *pResult )
+{
+	// the pool only knows GET, the upload is a POST on a connection of its own
+	CSocket socket( m_pNet, IPPROTO_TCP );
+	if ( socket.Connect( m_IPAddress, m_nPort ) < 0 )
+	{
+		strcpy( pResult->error, "Cannot connect for upload" );
+		return false;
+	}
+
+	CString request;
+	request.Format( "POST " NET_BENCH_PATH " HTTP/1.1\r\nHost: %s\r\nContent-Type: application/octet-stream\r\n"
+		"Content-Length: %u\r\nConnection: close\r\n\r\n", m_pHostName, NET_BENCH_UPLOAD_SIZE );
+	if ( socket.Send( (const char *)request, request.GetLength(), 0 ) != (int)request.GetLength() )
+	{
+		strcpy( pResult->error, "Upload test failed" );
+		return false;
+	}
+
+	u8 chunk[ NET_BENCH_SEND_CHUNK ];
+	for ( unsigned i = 0; i < NET_BENCH_SEND_CHUNK; i++ )
+		chunk[ i ] = (u8)i;
+
+	unsigned start = CTimer::GetClockTicks();
+	for ( unsigned sent = 0; sent < NET_BENCH_UPLOAD_SIZE; )
+	{
+		unsigned n = NET_BENCH_UPLOAD_SIZE - sent;
+		if ( n > NET_BENCH_SEND_CHUNK ) n = NET_BENCH_SEND_CHUNK;
+		if ( socket.Send( chunk, n, 0 ) != (int)n )
+		{
+			strcpy( pResult->error, "Upload test failed" );
+			return false;
+		}
+		sent += n;
+	}
+
+	// the peer answers after it has received the whole body
+	char response[ 128 ];
+	unsigned fill = 0;
+	while ( fill < sizeof( response ) - 1 )
+	{
+		int n = socket.Receive( &response[ fill ], sizeof( response ) - 1 - fill, 0 );
+		if ( n <= 0 )
+			break;
+		fill += n;
+		response[ fill ] = 0;
+		if ( strstr( response, "\r\n\r\n" ) != 0 )
+			break;
+	}
+	unsigned us = CTimer::GetClockTicks() - start;
+	response[ fill ] = 0;
+
+	if ( strncmp( response, "HTTP/1.1 200", 12 ) != 0 && strncmp( response, "HTTP/1.0 200", 12 ) != 0 )
+	{
+		strcpy( pResult->error, "Upload not acknowledged" );
+		return false;
+	}
+	pResult->uploadRate = rate( NET_BENCH_UPLOAD_SIZE, us );
+	return true;
+}
@@ -0,0 +1,93 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ netbench.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - network throughput and latency benchmark
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _netbench_h
+#define _netbench_h
+
+#include <circle/net/netsubsystem.h>
+#include <circle/net/ipaddress.h>
+#include <circle/types.h>
+#include "httppool.h"
+
+// the peer has to answer these requests, see Source/SKTPTestServer (sktpserver)
+// GET  NET_BENCH_PATH?bytes=n  -> n bytes of data
+// POST NET_BENCH_PATH          -> reads the body, answers with an empty 200 response
+#define NET_BENCH_PATH				"/bench"
+
+#define NET_BENCH_LATENCY_REQUESTS	20
+#define NET_BENCH_DOWNLOAD_SIZE		( 1024 * 1024 )
+#define NET_BENCH_UPLOAD_SIZE		( 512 * 1024 )
+
+typedef struct {
+	boolean valid;
+	char error[ 40 ];
+	// HTTP request latency on a kept-alive connection (us)
+	unsigned latencyMin, latencyAvg, latencyMax;
+	// TCP throughput (bytes/s)
+	unsigned downloadRate, uploadRate;
+	// longest time the menu spent in handleQueuedNetworkAction (with FIQs disabled) during the benchmark (us)
+	unsigned fiqOffMax;
+	// taken from updateSystemMonitor after the benchmark
+	unsigned cpuTemp;
+	unsigned heapFree;
+} TNetBenchmarkResult;
+
+//
+// measures what the network stack delivers while the menu keeps running: request latency and
+// download throughput through the connection pool, upload throughput over a plain TCP socket.
+// Only plain HTTP is used, the TLS handshake and encryption would dominate the results.
+//
+class CNetBenchmark
+{
+public:
+	CNetBenchmark( CNetSubSystem *pNet, CHTTPConnectionPool *pPool );
+	~CNetBenchmark();
+
+	// fills in the latency and throughput fields, returns false (and sets 'error') if a test failed
+	boolean Run( CIPAddress &ipAddress, unsigned port, const char *hostName, TNetBenchmarkResult *pResult );
+
+private:
+	boolean measureLatency( TNetBenchmarkResult *pResult );
+	boolean measureDownload( TNetBenchmarkResult *pResult );
+	boolean measureUpload( TNetBenchmarkResult *pResult );
+
+	static boolean countBody( const u8 *pData, unsigned length, void *pParam );
+	static unsigned rate( unsigned bytes, unsigned us );
+
+	CNetSubSystem *m_pNet;
+	CHTTPConnectionPool *m_pPool;
+	CIPAddress m_IPAddress;
+	unsigned m_nPort;
+	const char *m_pHostName;
+};
+
+#endif
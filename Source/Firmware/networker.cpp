@@ -0,0 +1,110 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ networker.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - network worker task executing downloads and SKTP requests for the menu
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "networker.h"
+#include "net.h"
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+
+extern CLogger *logger;
+
+// the worker looks for new requests this often while idle (ms)
+#define NET_WORKER_POLL_MS	10
+
+CNetWorker::CNetWorker( CSidekickNet *pNet )
+:	m_pNet( pNet ),
+	m_Busy( false )
+{
+}
+
+CNetWorker::~CNetWorker()
+{
+}
+
+boolean CNetWorker::Post( u8 request )
+{
+	if ( !m_Requests.Put( request ) )
+	{
+		logger->Write( "NetWorker", LogWarning, "Request queue full, dropping request %u", request );
+		return false;
+	}
+	return true;
+}
+
+boolean CNetWorker::GetResult( u8 *pResult )
+{
+	return m_Results.Get( pResult );
+}
+
+boolean CNetWorker::execute( u8 request )
+{
+	switch ( request )
+	{
+	case NET_REQUEST_DOWNLOAD:
+		m_pNet->getCSDBBinaryContent();
+		return true;
+
+	case NET_REQUEST_SKTP_UPDATE:
+	case NET_REQUEST_SKTP_REFRESH:
+		m_pNet->updateSktpScreenContent();
+		return m_pNet->getSKTPErrorCode() == 0;
+
+	case NET_REQUEST_BENCHMARK:
+		return m_pNet->runNetworkBenchmark();
+
+	default:
+		logger->Write( "NetWorker", LogWarning, "Unknown request %u", request );
+		return false;
+	}
+}
+
+void CNetWorker::Run( void )
+{
+	for ( ;; )
+	{
+		u8 request;
+		if ( !m_Requests.Get( &request ) )
+		{
+			CScheduler::Get()->MsSleep( NET_WORKER_POLL_MS );
+			continue;
+		}
+
+		// IsBusy() must not report idle between taking the request and finishing it
+		m_Busy = true;
+		boolean success = execute( request );
+
+		// the menu collects the results on every pass, so this can only fail if it stopped doing so
+		if ( !m_Results.Put( success ? ( request | NET_RESULT_OK ) : request ) )
+			logger->Write( "NetWorker", LogWarning, "Result queue full, dropping result %u", request );
+		m_Busy = false;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ networker.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - network worker task executing downloads and SKTP requests for the menu
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _networker_h
+#define _networker_h
+
+#include <circle/sched/task.h>
+#include <circle/types.h>
+#include "ringbuffer.h"
+
+// requests (menu -> worker)
+#define NET_REQUEST_DOWNLOAD		1
+#define NET_REQUEST_SKTP_UPDATE		2
+#define NET_REQUEST_SKTP_REFRESH	3
+#define NET_REQUEST_BENCHMARK		4
+
+// results (worker -> menu) echo the request, this bit is set if it succeeded
+#define NET_RESULT_OK				0x80
+
+#define NET_WORKER_QUEUE_SIZE		16
+
+class CSidekickNet;
+
+//
+// executes the blocking network requests of the menu (downloads, SKTP screens) in its own task.
+// Requests and results are single byte messages exchanged via two ring buffers, the menu posts
+// a request and continues rendering and handling the C64 while the worker waits for the sockets.
+//
+class CNetWorker : public CTask
+{
+public:
+	CNetWorker( CSidekickNet *pNet );
+	~CNetWorker();
+
+	// menu side, returns false if the request queue is full
+	boolean Post( u8 request );
+	// menu side, returns false if there is no result
+	boolean GetResult( u8 *pResult );
+	// true while requests are queued or being executed
+	boolean IsBusy() const { return !m_Requests.IsEmpty() || m_Busy; }
+
+	void Run( void );
+
+private:
+	boolean execute( u8 request );
+
+	CSidekickNet *m_pNet;
+	CRingBuffer<NET_WORKER_QUEUE_SIZE> m_Requests;
+	CRingBuffer<NET_WORKER_QUEUE_SIZE> m_Results;
+	volatile boolean m_Busy;
+};
+
+#endif
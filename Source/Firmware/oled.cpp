@@ -42,54 +42,96 @@ void oledClear()
 	memset( oledFrameBuffer, 0, 128 * 64 / 8 );
 }
 
-static u32 sfb_j, sfb_y, sfb_x;
+//
+// the frame buffer is sent in spans of changed bytes: oledSentFrameBuffer holds what the display shows,
+// a span is started with ssd1306_setpos (page/column) and continues through unchanged bytes if this
+// needs fewer I2C bits than addressing the next change (in horizontal addressing mode the column 
+// wraps to the next page).
+//
+#define OLED_BITS_BYTE		9								// 8 data bits + ack
+#define OLED_BITS_SPAN		( 5 * OLED_BITS_BYTE + 2 * 2 + 2 * OLED_BITS_BYTE + 2 * 2 )	// setpos transaction, data header, start/stop conditions
+#define OLED_MAX_SPANS		64
+
+static u8 oledSentFrameBuffer[ 128 * 64 / 8 ];
+static bool oledSentValid = false;
+
+static u16 sfb_spanStart[ OLED_MAX_SPANS ], sfb_spanEnd[ OLED_MAX_SPANS ];
+static u32 sfb_nSpans = 0, sfb_span = 0, sfb_j = 0;
+static bool sfb_inSpan = false;
 
 void sendFramebufferStart()
 {
-	sfb_j = sfb_y = sfb_x = 0;
+	sfb_nSpans = sfb_span = 0;
+	sfb_inSpan = false;
+
+	if ( oledSentValid )
+	{
+		s32 start = -1, end = -1;
+		for ( u32 i = 0; i <= 128 * 64 / 8; i++ )
+		{
+			if ( i < 128 * 64 / 8 && oledFrameBuffer[ i ] == oledSentFrameBuffer[ i ] )
+				continue;
+
+			// close the current span if the gap costs more than a new one
+			if ( start >= 0 && ( i == 128 * 64 / 8 || ( i - end - 1 ) * OLED_BITS_BYTE > OLED_BITS_SPAN ) )
+			{
+				if ( sfb_nSpans == OLED_MAX_SPANS )
+					break;
+				sfb_spanStart[ sfb_nSpans ] = start;
+				sfb_spanEnd[ sfb_nSpans ++ ] = end;
+				start = -1;
+			}
+			if ( i < 128 * 64 / 8 )
+			{
+				if ( start < 0 ) start = i;
+				end = i;
+			}
+		}
+
+		u32 bits = 0;
+		for ( u32 i = 0; i < sfb_nSpans; i++ )
+			bits += OLED_BITS_SPAN + ( sfb_spanEnd[ i ] - sfb_spanStart[ i ] + 1 ) * OLED_BITS_BYTE;
+
+		if ( start < 0 && bits < OLED_BITS_SPAN + 128 * 64 / 8 * OLED_BITS_BYTE )
+			return;
+	}
+
+	// display content unknown or too many changes
+	sfb_nSpans = 1;
+	sfb_spanStart[ 0 ] = 0;
+	sfb_spanEnd[ 0 ] = 128 * 64 / 8 - 1;
 }
 
 bool sendFramebufferDone()
 {
-	return (sfb_y == 8);
+	return ( sfb_span == sfb_nSpans );
 }
 
 void sendFramebufferNext( u32 nBytes )
 {
-	if( sfb_y == 8 ) return;
+	if ( sfb_span == sfb_nSpans ) return;
 
-	if ( sfb_x == 0 /*&& sfb_y == 0*/ )
+	if ( !sfb_inSpan )
 	{
-		//ssd1306_setpos( 0, sfb_y );
-
-		extern void ssd1306_send_command_start(void);
-		extern void ssd1306_send_command_stop(void);
-		ssd1306_send_command_start();
-		u32 col = 0;
-		ssd1306_send_command( 0xb0 | sfb_y );
-		ssd1306_send_command( 0x00 | (col & 0xf) );
-		ssd1306_send_command( 0x10 | (col >> 4) );
-	  //ssd1306_send_command( 0x81 );
-	  //ssd1306_send_command( 0xcf );
-		ssd1306_send_command_stop();
-
+		sfb_inSpan = true;
+		sfb_j = sfb_spanStart[ sfb_span ];
+		ssd1306_setpos( sfb_j & 127, sfb_j >> 7 );
 		ssd1306_send_data_start();
 	}
 
-	for ( u32 i = 0; i < nBytes; i++ )
+	for ( u32 i = 0; i < nBytes && sfb_j <= sfb_spanEnd[ sfb_span ]; i++ )
 	{
-		//ssd1306_send_data_start();
-		ssd1306_send_byte( oledFrameBuffer[ sfb_j ++ ] );
-		//ssd1306_send_data_stop();
-		sfb_x ++;
+		u8 v = oledFrameBuffer[ sfb_j ];
+		ssd1306_send_byte( v );
+		oledSentFrameBuffer[ sfb_j ++ ] = v;
 	}
 
-	if ( sfb_x == 128 )
+	if ( sfb_j > sfb_spanEnd[ sfb_span ] )
 	{
-		sfb_x = 0; sfb_y ++;
-
-		if ( sfb_y == 8 )
-			ssd1306_send_data_stop();
+		ssd1306_send_data_stop();
+		sfb_inSpan = false;
+		if ( ++ sfb_span == sfb_nSpans )
+			oledSentValid = true;
 	}
 }
 
@@ -104,6 +146,8 @@ void sendFramebuffer()
 			ssd1306_send_byte( oledFrameBuffer[ j++ ] );
 	}
 	ssd1306_send_data_stop();
+	memcpy( oledSentFrameBuffer, oledFrameBuffer, 128 * 64 / 8 );
+	oledSentValid = true;
 }
 
 
@@ -123,6 +167,7 @@ void splashScreen2( const u8 *fb )
 	//SendCommand(SSD1306_CMD_SET_COLUMN_HIGH | (col >> 4));	// 0x10 column address upper bits
 
 	flushI2CBuffer( true );
+	oledSentValid = false;	// written with a column offset
 
 	for ( int y = 0; y < 64 / 8; y++ )
 	{
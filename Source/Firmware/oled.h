@@ -67,6 +67,7 @@ static inline void oledClearPixel( u32 x, u32 y )
 extern void oledClear();
 extern void oledSetContrast( u8 c );
 extern void sendFramebuffer();
+// incremental transfer, only the bytes changed since the last transfer are sent
 extern void sendFramebufferStart();
 extern void sendFramebufferNext( u32 nBytes = 1 );
 extern bool sendFramebufferDone();
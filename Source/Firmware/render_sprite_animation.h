@@ -64,6 +64,27 @@
 	}													\
 	state = ( ofs << 8 ) | rle; }
 
+//
+// mask a decoded row of the animation with the dilated menu text, then distribute it to the 8 sprites
+//
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#define MASK_AND_DISTRIBUTE_ROW( y, row )											\
+	{ const u8 *rowMask = &framebuffer[ 8 + minsk( 199, ( (y) + 6*8 + 1 ) ) * 320/8 ];	\
+	vst1q_u8( &row[ 0 ], vbicq_u8( vld1q_u8( &row[ 0 ] ), vld1q_u8( &rowMask[ 0 ] ) ) );	\
+	vst1_u8( &row[ 16 ], vbic_u8( vld1_u8( &row[ 16 ] ), vld1_u8( &rowMask[ 16 ] ) ) );	\
+	u8 *dst = &bitmap[ ((y) / 21) * 8 * 64 + ((y) % 21) * 3 ];						\
+	for ( int bx = 0; bx < 8; bx++, dst += 64 )										\
+	{ dst[ 0 ] = row[ bx * 3 + 0 ]; dst[ 1 ] = row[ bx * 3 + 1 ]; dst[ 2 ] = row[ bx * 3 + 2 ]; } }
+#else
+#define MASK_AND_DISTRIBUTE_ROW( y, row )											\
+	{ const u8 *rowMask = &framebuffer[ 8 + minsk( 199, ( (y) + 6*8 + 1 ) ) * 320/8 ];	\
+	for ( int x = 0; x < 192 / 8; x++ )												\
+		row[ x ] &= ~rowMask[ x ];													\
+	u8 *dst = &bitmap[ ((y) / 21) * 8 * 64 + ((y) % 21) * 3 ];						\
+	for ( int bx = 0; bx < 8; bx++, dst += 64 )										\
+	{ dst[ 0 ] = row[ bx * 3 + 0 ]; dst[ 1 ] = row[ bx * 3 + 1 ]; dst[ 2 ] = row[ bx * 3 + 2 ]; } }
+#endif
+
 //
 // here comes the animation handling
 //
@@ -73,47 +94,116 @@ static int curFrame = 0;
 static int firstD = 1;
 
 if ( firstD )
+{
 	memset( bitmap, 0, 64 * 64 );
+	animationRedraw = true;
+}
 firstD = 0;
 
-for ( int y = 0; y < 147; y++ )
+if ( animationDeltaFrames )
 {
-	for ( int x = 0; x < 192 / 8; x++ )
-	{
-		unsigned int pixelState = animationState[ x + y * 192 / 8 ];
-		int ofs, rle, retVal;
+	//
+	// delta-frame animation: the XOR delta of a transition is used in both directions
+	// and only the bytes which change are touched
+	//
+	const u8 *d = &animationDeltaData[ animationDeltaOfs[ ( animDir > 0 ) ? curFrame : curFrame - 1 ] ];
+	u32 pos = 0;
 
-		if ( animDir > 0 )
-			FORWARD( pixelState ) else
-			BACKWARD( pixelState )
-
-		animationState[ x + y * 192 / 8 ] = pixelState;
+	while ( pos < ANIMATION_FRAME_BYTES )
+	{
+		u32 op = *(d++), n = ( op & 63 ) + 1;
+		switch ( op >> 6 )
+		{
+		case 0: pos += n; break;
+		case 3: pos += n * 64; break;
+		case 1: 
+			for ( ; n && pos < ANIMATION_FRAME_BYTES; n--, pos++ )
+			{
+				animationFrame[ pos ] ^= *(d++);
+				animationRowDirty[ pos / ( 192 / 8 ) ] = 1;
+			}
+			break;
+		case 2:
+			for ( u8 v = *(d++); n && pos < ANIMATION_FRAME_BYTES; n--, pos++ )
+			{
+				animationFrame[ pos ] ^= v;
+				animationRowDirty[ pos / ( 192 / 8 ) ] = 1;
+			}
+			break;
+		}
+	}
 
-		retVal &= ~framebuffer[ x + 8 + minsk( 199, ( y + 6*8 + 1 )) * 320/8 ];
+	// rows are updated if the animation or the menu text (mask) has changed there
+	for ( int y = 0; y < 147; y++ )
+	{
+		if ( !animationRedraw && !animationRowDirty[ y ] && !screenBitmapRowChanged[ minsk( 199, y + 6*8 + 1 ) ] )
+			continue;
 
-		int bx = (x * 8) / 24;
-		int byteX = ( (x * 8) % 24 ) / 8;
-		bitmap[ (y / 21) * 8 * 64 + bx * 64 + (y % 21) * 3 + byteX ] = retVal & 255;
+		u8 row[ 192 / 8 ];
+		memcpy( row, &animationFrame[ y * 192 / 8 ], 192 / 8 );
+		MASK_AND_DISTRIBUTE_ROW( y, row )
+		animationRowDirty[ y ] = 0;
 	}
-}
+	memset( screenBitmapRowChanged, 0, sizeof( screenBitmapRowChanged ) );
+	animationRedraw = false;
 
-if ( skinValues.SKIN_BACKGROUND_GFX_LOOP == 1 )
-{
-	curFrame ++;
-	if ( curFrame == 127 ) 
+	if ( skinValues.SKIN_BACKGROUND_GFX_LOOP == 1 )
 	{
-		curFrame = 0;
-		memcpy( animationState, animationStateInitial, (192 * 147 / 8)*4 );
+		if ( ++curFrame == (int)animationDeltaFrames ) 
+			curFrame = 0;
+	} else
+	{
+		if ( animDir > 0 )
+		{
+			if ( ++curFrame == (int)animationDeltaFrames - 1 )
+				animDir = -animDir;
+		} else
+		{
+			if ( --curFrame == 0 )
+				animDir = -animDir;
+		} 
 	}
 } else
 {
-	if ( animDir > 0 )
+	for ( int y = 0; y < 147; y++ )
+	{
+		u32 *rowState = &animationState[ y * 192 / 8 ];
+		u8 row[ 192 / 8 ];
+
+		for ( int x = 0; x < 192 / 8; x++ )
+		{
+			unsigned int pixelState = rowState[ x ];
+			int ofs, rle, retVal;
+
+			if ( animDir > 0 )
+				FORWARD( pixelState ) else
+				BACKWARD( pixelState )
+
+			rowState[ x ] = pixelState;
+			row[ x ] = retVal;
+		}
+
+		MASK_AND_DISTRIBUTE_ROW( y, row )
+	}
+
+	if ( skinValues.SKIN_BACKGROUND_GFX_LOOP == 1 )
 	{
-		if ( ++curFrame == 127 )
-			animDir = -animDir;
+		curFrame ++;
+		if ( curFrame == 127 ) 
+		{
+			curFrame = 0;
+			memcpy( animationState, animationStateInitial, (192 * 147 / 8)*4 );
+		}
 	} else
 	{
-		if ( --curFrame == 0 )
-			animDir = -animDir;
-	} 
+		if ( animDir > 0 )
+		{
+			if ( ++curFrame == 127 )
+				animDir = -animDir;
+		} else
+		{
+			if ( --curFrame == 0 )
+				animDir = -animDir;
+		} 
+	}
 }
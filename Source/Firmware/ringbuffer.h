@@ -0,0 +1,159 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ ringbuffer.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - bounded lock-free ring buffer between the bus emulation (FIQ) and the main loop
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _ringbuffer_h
+#define _ringbuffer_h
+
+#include <circle/types.h>
+#include <circle/synchronize.h>
+
+//
+// single producer / single consumer: the producer only moves the head, the consumer only the tail,
+// so no locking is needed between the FIQ handler and the main loop. SIZE has to be a power of two.
+//
+template <unsigned SIZE>
+class CRingBuffer
+{
+public:
+	CRingBuffer() : m_Head( 0 ), m_Tail( 0 ), m_DiscardMark( 0 ), m_DiscardRequest( 0 ), m_DiscardDone( 0 ) {}
+
+	// only call while neither side is active
+	void Clear() { m_Head = m_Tail = m_DiscardMark = 0; m_DiscardDone = m_DiscardRequest; }
+
+	unsigned Fill() const { return m_Head - m_Tail; }
+	unsigned Free() const { return SIZE - Fill(); }
+
+	// bytes dropped with Discard() but not skipped by the consumer yet count as empty
+	boolean IsEmpty() const
+	{
+		u32 tail = m_Tail;
+		if ( m_DiscardRequest != m_DiscardDone && m_DiscardMark - tail <= SIZE )
+			tail = m_DiscardMark;
+		return m_Head == tail;
+	}
+
+	// producer side: everything written so far is dropped, the consumer may be active meanwhile
+	// (it skips the bytes with its next Get/Read, until then they still occupy the buffer)
+	void Discard()
+	{
+		m_DiscardMark = m_Head;
+		DataMemBarrier();
+		m_DiscardRequest = m_DiscardRequest + 1;
+	}
+
+	// consumer side: drops everything written so far
+	void Skip()
+	{
+		consumerTail();
+		u32 head = m_Head;
+		DataMemBarrier();
+		m_Tail = head;
+	}
+
+	// producer side, returns false (and drops the byte) if the buffer is full
+	boolean Put( u8 c )
+	{
+		u32 head = m_Head;
+		if ( head - m_Tail >= SIZE )
+			return false;
+		m_Buffer[ head & ( SIZE - 1 ) ] = c;
+		DataMemBarrier();
+		m_Head = head + 1;
+		return true;
+	}
+
+	// producer side, returns the number of bytes which fit
+	unsigned Write( const u8 *pData, unsigned length )
+	{
+		u32 head = m_Head;
+		unsigned n = SIZE - ( head - m_Tail );
+		if ( n > length ) n = length;
+		for ( unsigned i = 0; i < n; i++ )
+			m_Buffer[ ( head + i ) & ( SIZE - 1 ) ] = pData[ i ];
+		DataMemBarrier();
+		m_Head = head + n;
+		return n;
+	}
+
+	// consumer side, returns false if the buffer is empty
+	boolean Get( u8 *pc )
+	{
+		u32 tail = consumerTail();
+		if ( tail == m_Head )
+			return false;
+		DataMemBarrier();
+		*pc = m_Buffer[ tail & ( SIZE - 1 ) ];
+		// the byte has to be read before the producer may overwrite it
+		DataMemBarrier();
+		m_Tail = tail + 1;
+		return true;
+	}
+
+	// consumer side, returns the number of bytes read
+	unsigned Read( u8 *pData, unsigned maxLength )
+	{
+		u32 tail = consumerTail();
+		unsigned n = m_Head - tail;
+		if ( n > maxLength ) n = maxLength;
+		DataMemBarrier();
+		for ( unsigned i = 0; i < n; i++ )
+			pData[ i ] = m_Buffer[ ( tail + i ) & ( SIZE - 1 ) ];
+		DataMemBarrier();
+		m_Tail = tail + n;
+		return n;
+	}
+
+private:
+	// applies a pending Discard() of the producer
+	u32 consumerTail()
+	{
+		u32 tail = m_Tail;
+		u32 request = m_DiscardRequest;
+		if ( request != m_DiscardDone )
+		{
+			DataMemBarrier();
+			u32 mark = m_DiscardMark;
+			// the mark may be behind the tail if the bytes have been read in the meantime
+			if ( mark - tail <= SIZE )
+				m_Tail = tail = mark;
+			m_DiscardDone = request;
+		}
+		return tail;
+	}
+
+	u8 m_Buffer[ SIZE ];
+	volatile u32 m_Head, m_Tail;
+	volatile u32 m_DiscardMark, m_DiscardRequest;	// written by the producer
+	volatile u32 m_DiscardDone;						// written by the consumer
+};
+
+#endif
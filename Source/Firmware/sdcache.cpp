@@ -0,0 +1,275 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sdcache.cpp
+
+ Sidekick64 - A framework for interfacing 8-Bit Commodore computers (C64/C128,C16/Plus4,VC20) and a Raspberry Pi Zero 2 or 3A+/3B+
+            - size-bounded LRU cache of generated files on the SD card
+ Copyright (c) 2019-2022 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <circle/util.h>
+#include "sdcache.h"
+
+#define SDCACHE_DRIVE			"SD:"
+#define SDCACHE_MAX_HEADER		256
+
+static const u32 indexMagic = 0x31434453;	// "SDC1"
+
+#ifndef WITH_NET
+static FATFS sdCacheFileSystem;
+#endif
+
+static bool mountCacheDrive( CLogger *logger )
+{
+#ifndef WITH_NET
+	if ( f_mount( &sdCacheFileSystem, SDCACHE_DRIVE, 1 ) != FR_OK )
+	{
+		logger->Write( "sdcache", LogWarning, "Cannot mount drive: %s", SDCACHE_DRIVE );
+		return false;
+	}
+#endif
+	return true;
+}
+
+static void unmountCacheDrive( CLogger *logger )
+{
+#ifndef WITH_NET
+	if ( f_mount( 0, SDCACHE_DRIVE, 0 ) != FR_OK )
+		logger->Write( "sdcache", LogWarning, "Cannot unmount drive: %s", SDCACHE_DRIVE );
+#endif
+}
+
+u64 sdCacheHash( const void *data, u32 size, u64 h )
+{
+	const u8 *p = (const u8 *)data;
+	while ( size-- )
+	{
+		h ^= *p++;
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+static void entryFilename( SDCACHE *cache, u32 key, char *filename )
+{
+	sprintf( filename, "%s/%08x.bin", cache->folder, key );
+}
+
+// expects the drive to be mounted
+static void loadIndex( SDCACHE *cache )
+{
+	if ( cache->loaded )
+		return;
+
+	cache->loaded = true;
+	cache->nEntries = 0;
+	cache->tick = 0;
+
+	f_mkdir( cache->folder );
+
+	char filename[ 256 ];
+	sprintf( filename, "%s/index.bin", cache->folder );
+
+	FIL file;
+	if ( f_open( &file, filename, FA_READ | FA_OPEN_EXISTING ) != FR_OK )
+		return;
+
+	u32 head[ 3 ], nBytesRead;
+	if ( f_read( &file, head, sizeof( head ), &nBytesRead ) == FR_OK && nBytesRead == sizeof( head ) &&
+		 head[ 0 ] == indexMagic && head[ 1 ] <= SDCACHE_MAX_ENTRIES )
+	{
+		u32 bytes = head[ 1 ] * sizeof( SDCACHE_ENTRY );
+		if ( f_read( &file, cache->entry, bytes, &nBytesRead ) == FR_OK && nBytesRead == bytes )
+		{
+			cache->nEntries = head[ 1 ];
+			cache->tick = head[ 2 ];
+		}
+	}
+
+	f_close( &file );
+}
+
+// expects the drive to be mounted
+static void saveIndex( CLogger *logger, SDCACHE *cache )
+{
+	char filename[ 256 ];
+	sprintf( filename, "%s/index.bin", cache->folder );
+
+	FIL file;
+	if ( f_open( &file, filename, FA_WRITE | FA_CREATE_ALWAYS ) != FR_OK )
+	{
+		logger->Write( "sdcache", LogWarning, "Cannot write index: %s", filename );
+		return;
+	}
+
+	u32 head[ 3 ] = { indexMagic, cache->nEntries, cache->tick }, nBytesWritten;
+	f_write( &file, head, sizeof( head ), &nBytesWritten );
+	f_write( &file, cache->entry, cache->nEntries * sizeof( SDCACHE_ENTRY ), &nBytesWritten );
+	f_close( &file );
+}
+
+static s32 findEntry( SDCACHE *cache, u32 key )
+{
+	for ( u32 i = 0; i < cache->nEntries; i++ )
+		if ( cache->entry[ i ].key == key )
+			return i;
+	return -1;
+}
+
+// expects the drive to be mounted
+static void removeEntry( SDCACHE *cache, u32 idx )
+{
+	char filename[ 256 ];
+	entryFilename( cache, cache->entry[ idx ].key, filename );
+	f_unlink( filename );
+
+	cache->entry[ idx ] = cache->entry[ -- cache->nEntries ];
+}
+
+bool sdCacheRead( CLogger *logger, SDCACHE *cache, u32 key, const void *header, u32 headerSize, u8 *data, u32 *size, u32 maxSize )
+{
+	if ( headerSize > SDCACHE_MAX_HEADER || !mountCacheDrive( logger ) )
+		return false;
+
+	loadIndex( cache );
+
+	bool hit = false;
+	s32 idx = findEntry( cache, key );
+
+	if ( idx >= 0 )
+	{
+		char filename[ 256 ];
+		entryFilename( cache, key, filename );
+
+		FIL file;
+		if ( f_open( &file, filename, FA_READ | FA_OPEN_EXISTING ) == FR_OK )
+		{
+			u8 storedHeader[ SDCACHE_MAX_HEADER ];
+			u32 fileSize = (u32)f_size( &file ), nBytesRead;
+
+			if ( fileSize >= headerSize && fileSize - headerSize <= maxSize &&
+				 f_read( &file, storedHeader, headerSize, &nBytesRead ) == FR_OK && nBytesRead == headerSize &&
+				 memcmp( storedHeader, header, headerSize ) == 0 )
+			{
+				*size = fileSize - headerSize;
+				hit = f_read( &file, data, *size, &nBytesRead ) == FR_OK && nBytesRead == *size;
+			}
+
+			f_close( &file );
+		}
+
+		if ( hit )
+		{
+			cache->entry[ idx ].lastUsed = ++ cache->tick;
+		} else
+		{
+			// stale or colliding entry, it will be replaced on the next write
+			removeEntry( cache, idx );
+		}
+
+		saveIndex( logger, cache );
+	}
+
+	unmountCacheDrive( logger );
+
+	return hit;
+}
+
+bool sdCacheWrite( CLogger *logger, SDCACHE *cache, u32 key, const void *header, u32 headerSize, const u8 *data, u32 size )
+{
+	u32 entrySize = headerSize + size;
+
+	if ( entrySize > cache->maxTotalSize || !mountCacheDrive( logger ) )
+		return false;
+
+	loadIndex( cache );
+
+	s32 idx = findEntry( cache, key );
+	if ( idx >= 0 )
+		removeEntry( cache, idx );
+
+	// evict least recently used entries until the new one fits
+	while ( cache->nEntries > 0 )
+	{
+		u32 totalSize = entrySize;
+		u32 oldest = 0;
+		for ( u32 i = 0; i < cache->nEntries; i++ )
+		{
+			totalSize += cache->entry[ i ].size;
+			if ( cache->entry[ i ].lastUsed < cache->entry[ oldest ].lastUsed )
+				oldest = i;
+		}
+
+		if ( totalSize <= cache->maxTotalSize && cache->nEntries < cache->maxEntries )
+			break;
+
+		removeEntry( cache, oldest );
+	}
+
+	char filename[ 256 ];
+	entryFilename( cache, key, filename );
+
+	bool ok = false;
+	FIL file;
+	if ( f_open( &file, filename, FA_WRITE | FA_CREATE_ALWAYS ) == FR_OK )
+	{
+		u32 nBytesWritten1 = 0, nBytesWritten2 = 0;
+		ok = f_write( &file, header, headerSize, &nBytesWritten1 ) == FR_OK &&
+			 f_write( &file, data, size, &nBytesWritten2 ) == FR_OK &&
+			 nBytesWritten1 == headerSize && nBytesWritten2 == size;
+		f_close( &file );
+
+		if ( ok )
+		{
+			SDCACHE_ENTRY *e = &cache->entry[ cache->nEntries ++ ];
+			e->key = key;
+			e->size = entrySize;
+			e->lastUsed = ++ cache->tick;
+		} else
+			f_unlink( filename );
+	} else
+		logger->Write( "sdcache", LogWarning, "Cannot write cache file: %s", filename );
+
+	saveIndex( logger, cache );
+	unmountCacheDrive( logger );
+
+	return ok;
+}
+
+void sdCacheRemove( CLogger *logger, SDCACHE *cache, u32 key )
+{
+	if ( !mountCacheDrive( logger ) )
+		return;
+
+	loadIndex( cache );
+
+	s32 idx = findEntry( cache, key );
+	if ( idx >= 0 )
+	{
+		removeEntry( cache, idx );
+		saveIndex( logger, cache );
+	}
+
+	unmountCacheDrive( logger );
+}
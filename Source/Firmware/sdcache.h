@@ -0,0 +1,76 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sdcache.h
+
+ Sidekick64 - A framework for interfacing 8-Bit Commodore computers (C64/C128,C16/Plus4,VC20) and a Raspberry Pi Zero 2 or 3A+/3B+
+            - size-bounded LRU cache of generated files on the SD card
+ Copyright (c) 2019-2022 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _sdcache_h
+#define _sdcache_h
+
+#include "helpers.h"
+
+//
+// each cache lives in its own folder: one file per entry ("%08x.bin", named after the 32-bit key)
+// plus "index.bin" which stores sizes and LRU-ticks of all entries.
+// Every entry file starts with a caller-defined header (e.g. full content hash, size, parameters)
+// which has to match on lookup, i.e. key collisions or stale files are simply treated as misses.
+//
+#define SDCACHE_MAX_ENTRIES	256
+
+typedef struct
+{
+	u32 key;
+	u32 size;		// size of the entry file incl. header
+	u32 lastUsed;
+} __attribute__((packed)) SDCACHE_ENTRY;
+
+typedef struct
+{
+	const char *folder;		// e.g. "SD:C64/D2EF", without trailing separator
+	u32 maxEntries;			// <= SDCACHE_MAX_ENTRIES
+	u32 maxTotalSize;		// in bytes, over all entry files
+
+	bool loaded;
+	u32 nEntries, tick;
+	SDCACHE_ENTRY entry[ SDCACHE_MAX_ENTRIES ];
+} SDCACHE;
+
+#define SDCACHE_INIT( FOLDER, MAXENTRIES, MAXSIZE ) { FOLDER, MAXENTRIES, MAXSIZE, false, 0, 0, {} }
+
+// FNV-1a, 'h' is either SDCACHE_HASH_SEED or the result of a previous call (to hash several buffers)
+#define SDCACHE_HASH_SEED	0xcbf29ce484222325ull
+extern u64 sdCacheHash( const void *data, u32 size, u64 h = SDCACHE_HASH_SEED );
+
+// returns true and the data (without header) if an entry with 'key' and identical header exists
+extern bool sdCacheRead( CLogger *logger, SDCACHE *cache, u32 key, const void *header, u32 headerSize, u8 *data, u32 *size, u32 maxSize );
+
+// stores an entry, evicting the least recently used ones to stay within the cache's bounds
+extern bool sdCacheWrite( CLogger *logger, SDCACHE *cache, u32 key, const void *header, u32 headerSize, const u8 *data, u32 size );
+
+// removes an entry (if present)
+extern void sdCacheRemove( CLogger *logger, SDCACHE *cache, u32 key );
+
+#endif
@@ -70,25 +70,31 @@ void delay( u32 d )
 
 u32 lastBit = 0;
 
-// send a byte to the display
+// last frame transmitted to the display (see compositor below)
+static unsigned char tftSentFrame12Bit[ 240 * 240 * 3 / 2 ];
+
+// the compositor knows the display content only while all transfers go through the full frame functions or the compositor itself
+static u8 tftSentFrameValid = 0;
+
+// send a byte to the display, the drain generates the clock and data transitions (see latch.h)
 void tftSendData( u8 d )
 {
-	for ( u8 bit = 0x80; bit; bit >>= 1 )
-	{
-		TFT_SCK_LOW
-
-		if ( ( d & bit ) && lastBit == 0 )
-		{
-			TFT_SDA_HIGH
-			lastBit = 1;
-		} else
-		if ( !( d & bit ) && lastBit == 1 )
-		{
-			TFT_SDA_LOW
-			lastBit = 0;
-		}
+	put4BitByte( d );
+	lastBit = d & 1;	// SDA after the last bit, for the immediate functions
+}
 
-		TFT_SCK_HIGH
+// send n bytes, runs of equal bytes are queued as one event
+void tftSendDataRun( const u8 *p, u32 n )
+{
+	while ( n > 0 )
+	{
+		u32 run = 1;
+		while ( run < n && run < 256 && p[ run ] == p[ 0 ] )
+			run ++;
+		put4BitByte( p[ 0 ], run );
+		lastBit = p[ 0 ] & 1;
+		p += run;
+		n -= run;
 	}
 }
 
@@ -182,6 +188,7 @@ static const u8 negGamma[] = { 0xD0, 0x00, 0x02, 0x07, 0x0A, 0x28, 0x31, 0x54, 0
 
 void tftInitDisplay() 
 {
+	tftSentFrameValid = 0;
 	TFT_SDA_LOW
 	lastBit = 0;
 
@@ -237,6 +244,7 @@ void tftSetPartial( u8 s, u8 e )
 
 void tftInitDisplayImm() 
 {
+	tftSentFrameValid = 0;
 	TFTimm_SDA_LOW
 	TFT_SDA_LOW
 	lastBit = 0;
@@ -353,6 +361,7 @@ unsigned short rgb16to12( unsigned short c )
 
 void setPixel( u32 x, u32 y, u32 c )
 {
+	tftSentFrameValid = 0;
 	tftCommand2x( CASET, y, y );
 	tftCommand2x( RASET, x, x );
 	tftCommand( RAMWR, c >> 8, c & 0xff );
@@ -360,6 +369,13 @@ void setPixel( u32 x, u32 y, u32 c )
 
 void setDoubleWPixel12( u32 x, u32 y, u32 c )
 {
+	// a pixel pair is recorded in the compositor's copy, so the visualizations can mix both
+	if ( ( y & 1 ) == 0 && x < 240 && y < 240 )
+	{
+		u8 *p = &tftSentFrame12Bit[ x * 240 * 3 / 2 + y * 3 / 2 ];
+		p[ 0 ] = c & 0xff; p[ 1 ] = ( c >> 8 ) & 0xff; p[ 2 ] = ( c >> 16 ) & 0xff;
+	} else
+		tftSentFrameValid = 0;
 	tftCommand2x( CASET, y, y+1 );
 	tftCommand2x( RASET, x, x );
 	tftCommand( RAMWR, c & 0xff, (c >> 8) & 0xff, c >> 16 );
@@ -367,6 +383,7 @@ void setDoubleWPixel12( u32 x, u32 y, u32 c )
 
 void setDoubleVPixel12( u32 x, u32 y, u32 c )
 {
+	tftSentFrameValid = 0;
 	tftCommand2x( CASET, y, y );
 	tftCommand2x( RASET, x, x+1 );
 	tftCommand( RAMWR, c & 0xff, (c >> 8) & 0xff, c >> 16 ); 
@@ -374,6 +391,7 @@ void setDoubleVPixel12( u32 x, u32 y, u32 c )
 
 void setMultiplePixels( u32 x, u32 y, u32 nx, u32 ny, u16 *c )
 {
+	tftSentFrameValid = 0;
 	tftCommand2x( CASET, y, y + ny );
 	tftCommand2x( RASET, x, x + nx );
 	tftCommand( RAMWR ); 
@@ -387,6 +405,7 @@ void setMultiplePixels( u32 x, u32 y, u32 nx, u32 ny, u16 *c )
 
 void setMultiplePixels12( u32 x, u32 y, u32 nx, u32 ny, u16 *c )
 {
+	tftSentFrameValid = 0;
 	tftCommand2x( CASET, y, y + ny );
 	tftCommand2x( RASET, x, x + nx );
 	tftCommand( RAMWR ); 
@@ -402,6 +421,7 @@ void setMultiplePixels12( u32 x, u32 y, u32 nx, u32 ny, u16 *c )
 
 void setMultiplePixelsImm( u32 x, u32 y, u32 nx, u32 ny, u16 *c )
 {
+	tftSentFrameValid = 0;
 	tftCommand2xImm( CASET, y, y + ny );
 	tftCommand2xImm( RASET, x, x + nx );
 	tftCommandImm( RAMWR ); 
@@ -415,6 +435,7 @@ void setMultiplePixelsImm( u32 x, u32 y, u32 nx, u32 ny, u16 *c )
 
 void tftCopy2Framebuffer16BitImm( u32 x, u32 y, u32 w, u32 h, const u8 *raw )
 {
+	tftSentFrameValid = 0;
 	tftCommand2x( CASET, x, x + w - 1 );
 	tftCommand2x( RASET, y, y + h - 1 );
 	tftUse16BitColor();
@@ -431,8 +452,13 @@ void tftCopy2Framebuffer16BitImm( u32 x, u32 y, u32 w, u32 h, const u8 *raw )
 	}
 }
 
+static void tftConvert12Bit( unsigned char *dst, const u8 *raw );
+
 void tftSendFramebuffer16BitImm( const u8 *raw )
 {
+	tftConvert12Bit( tftSentFrame12Bit, raw );
+	tftSentFrameValid = 1;
+
 	tftCommand2xImm( CASET, 0, ysize - 1 );
 	tftCommand2xImm( RASET, 0, xsize - 1 );
 	tftCommandImm( 0x3A ); tftSendDataImm( 0x05 );
@@ -451,6 +477,9 @@ void tftSendFramebuffer16BitImm( const u8 *raw )
 
 void tftSendFramebuffer12BitImm( const u8 *raw )
 {
+	memcpy( tftSentFrame12Bit, raw, 240 * 240 * 3 / 2 );
+	tftSentFrameValid = 1;
+
 	tftCommand2x( CASET, 0, ysize - 1 );
 	tftCommand2x( RASET, 0, xsize - 1 );
 	tftUse12BitColor();
@@ -459,15 +488,8 @@ void tftSendFramebuffer12BitImm( const u8 *raw )
 	const u8 *p = raw;
 	for ( u32 j = 0; j < ysize; j++ )
 	{
-		for ( u32 i = 0; i < xsize; i += 2 )
-		{
-			tftSendData( p[0] );
-			tftSendData( p[1] );
-			tftSendData( p[2] );
-			p += 3;
-			//tftSendData( raw[ (i + j * 240)*3/2+1 ] );
-			//tftSendData( raw[ (i + j * 240)*2 ] );
-		}
+		tftSendDataRun( p, xsize * 3 / 2 );
+		p += xsize * 3 / 2;
 		flush4BitBuffer( true );
 	}
 	TFTimm_DC_LOW
@@ -513,7 +535,7 @@ int tftSplashScreenFile( const char *drive, const char *fn )
 
 int tftSplashScreenMemory( const u8 * temp, u32 size )
 {
-	tftInitDisplay();
+	tftInitDisplay();	// invalidates the compositor's copy
 	tftCommand2x( CASET, 0, ysize - 1 );
 	tftCommand2x( RASET, 0, xsize - 1 );
 	tftCommand( 0x3A ); tftSendData( 0x05 );
@@ -610,6 +632,7 @@ unsigned char tftSlideShow[ 240 * 240 * 2 * 32 ];
 unsigned char tftDirty[ (240/DIRTY_SIZE) * (240/DIRTY_SIZE) ];
 
 u32 nDirtyRegions, curDirtyRegion;
+static u8 tftDirtyPass = 0;		// the dirty regions are being sent by the compositor
 
 void tftClearDirty()
 {
@@ -618,6 +641,7 @@ void tftClearDirty()
 			tftDirty[ i + j * (240/DIRTY_SIZE) ] = 0;
 	nDirtyRegions = 0;
 	curDirtyRegion = 0;
+	tftDirtyPass = 0;
 }
 
 void tftPrepareDirtyUpdates()
@@ -649,7 +673,7 @@ bool tftIsDirtyRegion()
 }
 
 
-int tftUpdateNextDirtyRegions()
+int tftUpdateNextDirtyRegionsImm()
 {
 	if ( nDirtyRegions == 0 )
 		return 0;
@@ -669,37 +693,296 @@ int tftUpdateNextDirtyRegions()
 			*(dst++) = *(u16*)&tftFrameBuffer[ ((x+j) + (y+i) * 240) * 2 ];
 		}
 
-	setMultiplePixels12( x, y, DIRTY_SIZE-1, DIRTY_SIZE-1, c );
+	setMultiplePixelsImm( x, y, DIRTY_SIZE-1, DIRTY_SIZE-1, c );
 
 	tftDirty[ curDirtyRegion++ ] = 0;
 	nDirtyRegions --;
 	return 1;
 }
 
-int tftUpdateNextDirtyRegionsImm()
+//
+// dirty-rectangle compositor: the 12-bit frame is compared with the last frame sent to the display,
+// changed tiles are merged to windows (CASET/RASET) and only these are transmitted. Windows are merged
+// whenever the extra pixels cost fewer latch transitions than setting up another window.
+// The display is left in 16-bit color mode like after a full frame transfer.
+//
+#define TFT_TILE			8
+#define TFT_TILES			( 240 / TFT_TILE )
+#define TFT_MAX_WINDOWS		64
+
+// estimated 4-bit latch commands: SCK low/high per bit plus an SDA change on every other bit
+#define TFT_COST_BYTE		( 8 * 5 / 2 )
+#define TFT_COST_WINDOW		( 11 * TFT_COST_BYTE + 6 )		// CASET, RASET, RAMWR and DC changes
+#define TFT_COST_PAIR		( 3 * TFT_COST_BYTE )			// two 12-bit pixels
+// nibbles of a queued byte (put4BitByte), used to check the free space in the ring buffer
+#define TFT_MAX_COST_BYTE	3
+
+typedef struct
 {
-	if ( nDirtyRegions == 0 )
-		return 0;
+	u16 x0, y0, x1, y1;		// inclusive, x0 even and x1 odd (pixel pairs)
+} TFTWINDOW;
 
-	while ( tftDirty[ curDirtyRegion ] == 0 && curDirtyRegion < ((240/DIRTY_SIZE)*(240/DIRTY_SIZE)) )
-		curDirtyRegion ++;
-	
-	u32 x = ( curDirtyRegion % (240/DIRTY_SIZE) ) * DIRTY_SIZE;
-	u32 y = ( curDirtyRegion / (240/DIRTY_SIZE) ) * DIRTY_SIZE;
+static TFTWINDOW tftWindows[ TFT_MAX_WINDOWS ];
+static u32 tftNumWindows = 0, tftCurWindow = 0, tftCurRow = 0;
+static const u8 *tftCompositorFrame;
+static boolean tftFullFrame = false;
+static boolean tftStay12Bit = false;		// the display is kept in 12-bit mode (SID visualizations)
 
-	u16 c[ DIRTY_SIZE * DIRTY_SIZE ];
-	u16 *dst = &c[ 0 ];
+static u32 tftWindowCost( const TFTWINDOW *w )
+{
+	return TFT_COST_WINDOW + ( w->x1 - w->x0 + 1 ) / 2 * ( w->y1 - w->y0 + 1 ) * TFT_COST_PAIR;
+}
 
-	for ( u32 j = 0; j < DIRTY_SIZE; j++ )
-		for ( u32 i = 0; i < DIRTY_SIZE; i++ )
+static u32 tftWindowCost( u32 x0, u32 y0, u32 x1, u32 y1 )
+{
+	TFTWINDOW w = { (u16)x0, (u16)y0, (u16)x1, (u16)y1 };
+	return tftWindowCost( &w );
+}
+
+static boolean tftRowChanged( const u8 *fb, u32 y, u32 x0, u32 x1 )
+{
+	u32 o = y * 240 * 3 / 2 + x0 * 3 / 2;
+	return memcmp( &fb[ o ], &tftSentFrame12Bit[ o ], ( x1 - x0 + 1 ) * 3 / 2 ) != 0;
+}
+
+static boolean tftColumnChanged( const u8 *fb, u32 x, u32 y0, u32 y1 )
+{
+	// x is even, compares the pixel pair
+	for ( u32 y = y0; y <= y1; y++ )
+	{
+		u32 o = y * 240 * 3 / 2 + x * 3 / 2;
+		if ( fb[ o ] != tftSentFrame12Bit[ o ] || fb[ o + 1 ] != tftSentFrame12Bit[ o + 1 ] || fb[ o + 2 ] != tftSentFrame12Bit[ o + 2 ] )
+			return true;
+	}
+	return false;
+}
+
+static void tftAddWindow( u32 x0, u32 ty, u32 x1 )
+{
+	u32 y0 = ty * TFT_TILE, y1 = y0 + TFT_TILE - 1;
+
+	// try to extend a window ending in the tile row above, if the union is cheaper than both
+	s32 best = -1;
+	s32 bestGain = -1;
+	for ( u32 i = 0; i < tftNumWindows; i++ )
+	{
+		TFTWINDOW *w = &tftWindows[ i ];
+		if ( (u32)w->y1 + 1 != y0 )
+			continue;
+		u32 ux0 = minsk( (u32)w->x0, x0 ), ux1 = maxsk( (u32)w->x1, x1 );
+		s32 gain = (s32)tftWindowCost( w ) + (s32)tftWindowCost( x0, y0, x1, y1 ) - (s32)tftWindowCost( ux0, w->y0, ux1, y1 );
+		if ( gain >= 0 && gain > bestGain )
 		{
-			*(dst++) = *(u16*)&tftFrameBuffer[ ((x+j) + (y+i) * 240) * 2 ];
+			best = i;
+			bestGain = gain;
 		}
+	}
 
-	setMultiplePixelsImm( x, y, DIRTY_SIZE-1, DIRTY_SIZE-1, c );
+	if ( best >= 0 )
+	{
+		TFTWINDOW *w = &tftWindows[ best ];
+		w->x0 = minsk( (u32)w->x0, x0 );
+		w->x1 = maxsk( (u32)w->x1, x1 );
+		w->y1 = y1;
+		return;
+	}
 
-	tftDirty[ curDirtyRegion++ ] = 0;
-	nDirtyRegions --;
+	if ( tftNumWindows < TFT_MAX_WINDOWS )
+	{
+		TFTWINDOW *w = &tftWindows[ tftNumWindows++ ];
+		w->x0 = x0; w->y0 = y0; w->x1 = x1; w->y1 = y1;
+	} else
+		tftNumWindows = TFT_MAX_WINDOWS + 1;	// too many, the full frame is sent
+}
+
+// determines the windows to update, only the tiles set in 'tiles' are compared (all if 0), returns the number of windows
+static int tftCompositorPrepareTiles( const u8 *fb, const u8 *tiles, boolean stay12Bit )
+{
+	tftCompositorFrame = fb;
+	tftNumWindows = tftCurWindow = tftCurRow = 0;
+	tftFullFrame = false;
+	tftStay12Bit = stay12Bit;
+
+	if ( tftSentFrameValid )
+	{
+		u8 dirty[ TFT_TILES ];
+		for ( u32 ty = 0; ty < TFT_TILES && tftNumWindows <= TFT_MAX_WINDOWS; ty++ )
+		{
+			memset( dirty, 0, TFT_TILES );
+			for ( u32 y = ty * TFT_TILE; y < ( ty + 1 ) * TFT_TILE; y++ )
+				for ( u32 tx = 0; tx < TFT_TILES; tx++ )
+					if ( !dirty[ tx ] && ( tiles == 0 || tiles[ tx + ty * TFT_TILES ] ) && tftRowChanged( fb, y, tx * TFT_TILE, tx * TFT_TILE + TFT_TILE - 1 ) )
+						dirty[ tx ] = 1;
+
+			// runs of dirty tiles, clean gaps are included if this is cheaper than another window
+			s32 runStart = -1, runEnd = -1;
+			for ( u32 tx = 0; tx <= TFT_TILES; tx++ )
+			{
+				if ( tx < TFT_TILES && !dirty[ tx ] )
+					continue;
+				if ( runStart >= 0 && ( tx == TFT_TILES || ( tx - runEnd - 1 ) * TFT_TILE * TFT_TILE / 2 * TFT_COST_PAIR > TFT_COST_WINDOW ) )
+				{
+					tftAddWindow( runStart * TFT_TILE, ty, runEnd * TFT_TILE + TFT_TILE - 1 );
+					runStart = -1;
+				}
+				if ( tx < TFT_TILES )
+				{
+					if ( runStart < 0 ) runStart = tx;
+					runEnd = tx;
+				}
+			}
+		}
+
+		// shrink the windows to the pixels which actually changed
+		u32 cost = 0;
+		for ( u32 i = 0; i < tftNumWindows && tftNumWindows <= TFT_MAX_WINDOWS; i++ )
+		{
+			TFTWINDOW *w = &tftWindows[ i ];
+			while ( w->y0 < w->y1 && !tftRowChanged( fb, w->y0, w->x0, w->x1 ) ) w->y0++;
+			while ( w->y1 > w->y0 && !tftRowChanged( fb, w->y1, w->x0, w->x1 ) ) w->y1--;
+			while ( w->x0 + 1 < w->x1 && !tftColumnChanged( fb, w->x0, w->y0, w->y1 ) ) w->x0 += 2;
+			while ( w->x1 > w->x0 + 1 && !tftColumnChanged( fb, w->x1 - 1, w->y0, w->y1 ) ) w->x1 -= 2;
+			cost += tftWindowCost( w );
+		}
+
+		if ( tftNumWindows <= TFT_MAX_WINDOWS && cost < tftWindowCost( 0, 0, 239, 239 ) )
+			return tftNumWindows;
+	}
+
+	// unknown display content or too many changes: full frame
+	tftFullFrame = true;
+	tftNumWindows = 1;
+	tftWindows[ 0 ].x0 = tftWindows[ 0 ].y0 = 0;
+	tftWindows[ 0 ].x1 = ysize - 1;		// CASET and RASET as in tftSendFramebuffer12BitImm
+	tftWindows[ 0 ].y1 = xsize - 1;
+	return 1;
+}
+
+int tftCompositorPrepare( const u8 *fb )
+{
+	return tftCompositorPrepareTiles( fb, 0, false );
+}
+
+// queues the next part of the prepared windows if the 4-bit buffer has space, returns 0 when done
+int tftCompositorSendNext()
+{
+	while ( tftCurWindow < tftNumWindows )
+	{
+		TFTWINDOW *w = &tftWindows[ tftCurWindow ];
+		u32 bytes = ( w->x1 - w->x0 + 1 ) * 3 / 2;
+
+		if ( tftCurRow == 0 )
+		{
+			if ( bufferIsFreeI2C() < 16 * TFT_MAX_COST_BYTE )
+				return 1;
+			if ( tftCurWindow == 0 && !tftStay12Bit )
+				tftUse12BitColor();
+			tftCommand2x( CASET, w->x0, w->x1 );
+			tftCommand2x( RASET, w->y0, w->y1 );
+			tftCommand( RAMWR );
+			tftCurRow = w->y0 + 1;		// 0 marks a window without header
+		}
+
+		while ( tftCurRow <= (u32)w->y1 + 1 )
+		{
+			if ( bufferIsFreeI2C() < ( bytes + 4 ) * TFT_MAX_COST_BYTE )
+				return 1;
+			u32 o = ( tftCurRow - 1 ) * 240 * 3 / 2 + w->x0 * 3 / 2;
+			const u8 *p = &tftCompositorFrame[ o ];
+			tftSendDataRun( p, bytes );
+			memcpy( &tftSentFrame12Bit[ o ], p, bytes );
+			tftCurRow ++;
+		}
+
+		tftCurWindow ++;
+		tftCurRow = 0;
+		if ( tftCurWindow == tftNumWindows )
+		{
+			if ( !tftStay12Bit )
+				tftUse16BitColor();
+			tftSentFrameValid = 1;
+		}
+	}
+	return 0;
+}
+
+static void tftCompositorFlushImm()
+{
+	while ( tftCompositorSendNext() )
+		flush4BitBuffer( true );
+	flush4BitBuffer( true );
+	TFTimm_DC_LOW
+}
+
+// sends the changes of a 12-bit frame and waits until they have been transmitted
+int tftCompositorUpdateImm( const u8 *fb )
+{
+	int n = tftCompositorPrepare( fb );
+	tftCompositorFlushImm();
+	return n;
+}
+
+// same for a 16-bit frame (converted to tftFrameBuffer12Bit), full frames keep the 16-bit colors
+int tftUpdateFramebuffer16BitImm( const u8 *raw )
+{
+	tftConvert12Bit( tftFrameBuffer12Bit, raw );
+	int n = tftCompositorPrepare( tftFrameBuffer12Bit );
+	if ( tftFullFrame )
+	{
+		tftNumWindows = 0;
+		tftSendFramebuffer16BitImm( raw );
+	} else
+		tftCompositorFlushImm();
+	return n;
+}
+
+bool tftIsFrameKnown()
+{
+	return tftSentFrameValid != 0;
+}
+
+//
+// the dirty regions of the SID visualizations (setPixelDirty, transposed framebuffer, see tftPrepareDirtyUpdates)
+// are converted into tftFrameBuffer12Bit and sent by the compositor, which only compares the tiles containing them.
+// Call repeatedly, sends as much as the 4-bit buffer takes, returns 0 when there is nothing left to send.
+//
+static u8 tftDirtyTiles[ TFT_TILES * TFT_TILES ];
+
+int tftUpdateNextDirtyRegions()
+{
+	if ( nDirtyRegions == 0 )
+		return 0;
+
+	if ( !tftDirtyPass )
+	{
+		const u16 *fb = (const u16 *)tftFrameBuffer;
+		memset( tftDirtyTiles, 0, sizeof( tftDirtyTiles ) );
+		for ( u32 r = 0; r < (240/DIRTY_SIZE)*(240/DIRTY_SIZE); r++ )
+		{
+			if ( tftDirty[ r ] == 0 )
+				continue;
+
+			u32 row = ( r % (240/DIRTY_SIZE) ) * DIRTY_SIZE;
+			u32 col = ( r / (240/DIRTY_SIZE) ) * DIRTY_SIZE;
+			for ( u32 j = row; j < row + DIRTY_SIZE; j++ )
+				for ( u32 i = col; i < col + DIRTY_SIZE; i += 2 )
+				{
+					u32 c = ( rgb16to12( fb[ j + i * 240 ] ) << 12 ) | rgb16to12( fb[ j + ( i + 1 ) * 240 ] );
+					u8 *p = &tftFrameBuffer12Bit[ j * 240 * 3 / 2 + i * 3 / 2 ];
+					p[ 0 ] = ( c >> 16 ) & 255;
+					p[ 1 ] = ( c >> 8 ) & 255;
+					p[ 2 ] = c & 255;
+				}
+			tftDirtyTiles[ col / TFT_TILE + ( row / TFT_TILE ) * TFT_TILES ] = 1;
+		}
+		tftCompositorPrepareTiles( tftFrameBuffer12Bit, tftDirtyTiles, true );
+		tftDirtyPass = 1;
+	}
+
+	if ( tftCompositorSendNext() )
+		return 1;
+
+	tftClearDirty();
 	return 1;
 }
 
@@ -773,10 +1056,10 @@ void tftBlendRGBA( unsigned char *rgba, unsigned char *dst, int dither )
 	}
 }
 
-void tftConvertFrameBuffer12Bit()
+static void tftConvert12Bit( unsigned char *dst, const u8 *raw )
 {
-	unsigned char *p = tftFrameBuffer12Bit;
-	unsigned short *s = (unsigned short *)tftFrameBuffer;
+	unsigned char *p = dst;
+	const unsigned short *s = (const unsigned short *)raw;
 	for ( int i = 0; i < 240 * 240; i += 2 )
 	{
 		unsigned int c = ( rgb16to12( s[ i ] ) << 12 ) | ( ((u32)rgb16to12( s[ i + 1 ] )) << 0 );
@@ -786,6 +1069,11 @@ void tftConvertFrameBuffer12Bit()
 	}
 }
 
+void tftConvertFrameBuffer12Bit()
+{
+	tftConvert12Bit( tftFrameBuffer12Bit, tftFrameBuffer );
+}
+
 
 int tftParseTGAFromNet( unsigned char *tga, u32 size ){
 	int w = 0, h = 0;
@@ -87,6 +87,13 @@ extern void setPixelDirty( u32 x, u32 y, u32 c );
 extern int  tftUpdateNextDirtyRegions();
 extern bool tftIsDirtyRegion();
 
+// dirty-rectangle compositor, transmits only what changed since the last frame
+extern int  tftCompositorPrepare( const u8 *fb );
+extern int  tftCompositorSendNext();
+extern int  tftCompositorUpdateImm( const u8 *fb );
+extern int  tftUpdateFramebuffer16BitImm( const u8 *raw );
+extern bool tftIsFrameKnown();
+
 
 #endif
 
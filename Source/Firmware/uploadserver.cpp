@@ -0,0 +1,527 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ uploadserver.cpp
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - streaming receiver for file uploads from the web interface
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "uploadserver.h"
+#include "net.h"
+#include <circle/net/in.h>
+#include <circle/net/ipaddress.h>
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+
+extern CLogger *logger;
+
+extern u32 prgSizeLaunch;
+extern unsigned char prgDataLaunch[ 1027*1024*12 ] AAA;
+
+// kernel images are received into this file and only replace the kernel once complete
+static const char FILENAME_KERNEL_UPLOAD[] = "SD:kernel_upload.tmp";
+static const char FILENAME_KERNEL_BACKUP[] = "SD:kernel_backup.tmp";
+
+static const char s_Response[] =
+	"<!doctype html><html><head><meta charset=\"utf-8\">"
+	"<meta http-equiv=\"refresh\" content=\"4; url=http://%s/\">"
+	"<title>Sidekick64 upload</title></head>"
+	"<body style=\"background:#343a40;color:#fff;font-family:sans-serif\">"
+	"<p>%s</p><p><a style=\"color:#fff\" href=\"http://%s/\">Back</a></p></body></html>";
+
+// prefix is lower case
+static boolean hasPrefixNoCase( const char *s, const char *prefix )
+{
+	for ( ; *prefix; s++, prefix++ )
+	{
+		char a = *s;
+		if ( a >= 'A' && a <= 'Z' ) a += 'a' - 'A';
+		if ( a != *prefix )
+			return false;
+	}
+	return true;
+}
+
+// searches a header field ("content-length:"), returns its value
+static const char *findHeaderField( const char *pHeader, const char *pField )
+{
+	for ( const char *p = pHeader; *p != 0; p++ )
+	{
+		if ( p != pHeader && p[ -1 ] != '\n' )
+			continue;
+		if ( hasPrefixNoCase( p, pField ) )
+		{
+			p += strlen( pField );
+			while ( *p == ' ' ) p++;
+			return p;
+		}
+	}
+	return 0;
+}
+
+// copies a (possibly quoted) parameter value like name="x" or boundary=x
+static boolean getParameter( const char *pHeader, const char *pParameter, char *pValue, unsigned maxLength )
+{
+	const char *p = strstr( pHeader, pParameter );
+	if ( p == 0 )
+		return false;
+	p += strlen( pParameter );
+
+	char end = ';';
+	if ( *p == '"' )
+	{
+		end = '"';
+		p++;
+	}
+	unsigned l = 0;
+	while ( p[ l ] != 0 && p[ l ] != end && p[ l ] != '\r' && p[ l ] != '\n' && ( end == '"' || p[ l ] != ' ' ) )
+	{
+		if ( l + 1 >= maxLength )
+			return false;
+		pValue[ l ] = p[ l ];
+		l++;
+	}
+	pValue[ l ] = 0;
+	return true;
+}
+
+CUploadServer::CUploadServer( CNetSubSystem *pNet, u16 nPort, CSidekickNet *pSidekickNet )
+:	m_pNet( pNet ),
+	m_nPort( nPort ),
+	m_pSidekickNet( pSidekickNet ),
+	m_pListener( 0 ),
+	m_Busy( false ),
+	m_Target( TargetNone ),
+	m_pError( 0 ),
+	m_nFieldLength( 0 ),
+	m_SaveOrLaunch( 0 ),
+	m_nFileLength( 0 ),
+	m_FileComplete( false ),
+	m_KernelSaved( false ),
+	m_KernelFileOpen( false ),
+	m_nWriteBuffer( 0 )
+{
+	m_Filename[ 0 ] = 0;
+	m_Extension[ 0 ] = 0;
+}
+
+CUploadServer::~CUploadServer()
+{
+	abortKernel();
+	if ( m_pListener != 0 )
+		delete m_pListener;
+}
+
+void CUploadServer::Run( void )
+{
+	m_pListener = new CSocket( m_pNet, IPPROTO_TCP );
+	if ( m_pListener->Bind( m_nPort ) < 0 || m_pListener->Listen() < 0 )
+	{
+		logger->Write( "UploadServer", LogError, "Cannot listen on port %u", m_nPort );
+		delete m_pListener;
+		m_pListener = 0;
+		return;
+	}
+
+	while ( 1 )
+	{
+		CIPAddress foreignIP;
+		u16 foreignPort;
+		CSocket *pConnection = m_pListener->Accept( &foreignIP, &foreignPort );
+		if ( pConnection == 0 )
+		{
+			CScheduler::Get()->Yield();
+			continue;
+		}
+
+		handleConnection( pConnection );
+		m_Busy = false;
+		delete pConnection;
+	}
+}
+
+int CUploadServer::receiveHeader( CSocket *pSocket, char *pHeader, unsigned *pHeaderLength )
+{
+	// returns the number of body bytes received along with the header (kept in m_RecvBuffer)
+	unsigned fill = 0;
+	while ( 1 )
+	{
+		int n = pSocket->Receive( m_RecvBuffer, NET_UPLOAD_RECV_BUFFER, 0 );
+		if ( n <= 0 )
+			return -1;
+
+		unsigned take = (unsigned)n;
+		if ( fill + take > NET_UPLOAD_MAX_REQUEST - 1 )
+			take = NET_UPLOAD_MAX_REQUEST - 1 - fill;
+		memcpy( &pHeader[ fill ], m_RecvBuffer, take );
+		pHeader[ fill + take ] = 0;
+
+		char *pEnd = strstr( pHeader, "\r\n\r\n" );
+		if ( pEnd != 0 )
+		{
+			unsigned headerLength = pEnd + 4 - pHeader;
+			unsigned rest = fill + (unsigned)n - headerLength;
+			memmove( m_RecvBuffer, &m_RecvBuffer[ (unsigned)n - rest ], rest );
+			*pEnd = 0;
+			*pHeaderLength = headerLength;
+			return rest;
+		}
+
+		fill += take;
+		if ( fill >= NET_UPLOAD_MAX_REQUEST - 1 )
+			return -1;
+	}
+}
+
+void CUploadServer::sendResponse( CSocket *pSocket, const char *pStatus, const char *pMsg )
+{
+	CString ip;
+	m_pNet->GetConfig()->GetIPAddress()->Format( &ip );
+
+	CString body;
+	body.Format( s_Response, (const char *) ip, pMsg, (const char *) ip );
+
+	CString response;
+	response.Format( "HTTP/1.1 %s\r\nContent-Type: text/html; charset=UTF-8\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+		pStatus, body.GetLength() );
+	response.Append( body );
+
+	pSocket->Send( (const char *) response, response.GetLength(), 0 );
+}
+
+void CUploadServer::handleConnection( CSocket *pSocket )
+{
+	char header[ NET_UPLOAD_MAX_REQUEST ];
+	unsigned headerLength = 0;
+	int rest = receiveHeader( pSocket, header, &headerLength );
+	if ( rest < 0 )
+		return;
+
+	if ( strncmp( header, "POST /upload ", 13 ) != 0 )
+	{
+		sendResponse( pSocket, "404 Not Found", "Uploads are sent to /upload." );
+		return;
+	}
+
+	const char *pContentLength = findHeaderField( header, "content-length:" );
+	const char *pContentType = findHeaderField( header, "content-type:" );
+	char boundary[ MULTIPART_MAX_BOUNDARY + 1 ];
+	if ( pContentLength == 0 || pContentType == 0
+		|| !hasPrefixNoCase( pContentType, "multipart/form-data" )
+		|| !getParameter( pContentType, "boundary=", boundary, sizeof( boundary ) )
+		|| !m_Parser.Init( boundary, partHandler, this ) )
+	{
+		sendResponse( pSocket, "400 Bad Request", "Invalid request (1)" );
+		return;
+	}
+	u32 contentLength = 0;
+	for ( const char *p = pContentLength; *p >= '0' && *p <= '9'; p++ )
+		contentLength = contentLength * 10 + *p - '0';
+
+	// downloads (network worker) use prgDataLaunch as well
+	if ( m_pSidekickNet->isAnyNetworkActionQueued() )
+	{
+		sendResponse( pSocket, "503 Service Unavailable", "A download is in progress, please try again later." );
+		return;
+	}
+	m_Busy = true;
+
+	m_Target = TargetNone;
+	m_pError = 0;
+	m_Filename[ 0 ] = 0;
+	m_Extension[ 0 ] = 0;
+	m_SaveOrLaunch = 0;
+	m_nFileLength = 0;
+	m_FileComplete = false;
+	m_KernelSaved = false;
+
+	logger->Write( "UploadServer", LogNotice, "Receiving upload, %u bytes", contentLength );
+
+	unsigned start = CTimer::GetClockTicks();
+	u32 received = 0;
+	boolean ok = true;
+	int n = rest;
+	while ( ok )
+	{
+		if ( n > 0 )
+		{
+			received += n;
+			ok = m_Parser.Put( m_RecvBuffer, n );
+		}
+		if ( !ok || m_Parser.IsComplete() || received >= contentLength )
+			break;
+
+		n = pSocket->Receive( m_RecvBuffer, NET_UPLOAD_RECV_BUFFER, 0 );
+		if ( n <= 0 )
+		{
+			m_pError = "Connection lost during upload";
+			ok = false;
+		}
+	}
+	unsigned us = CTimer::GetClockTicks() - start;
+	if ( us == 0 ) us = 1;
+	unsigned rate = (unsigned)( (u64)received * 1000000 / us );
+
+	if ( ok && !m_Parser.IsComplete() )
+	{
+		m_pError = "Incomplete upload";
+		ok = false;
+	}
+	if ( !ok )
+		abortKernel();
+
+	char msg[ 255 ];
+	msg[ 0 ] = 0;
+	if ( !ok || !m_FileComplete )
+	{
+		strcpy( msg, m_pError != 0 ? m_pError : "Invalid request (2)" );
+	}
+	else if ( m_KernelSaved )
+	{
+		strcpy( msg, "Now rebooting into new kernel..." );
+		m_pSidekickNet->requestReboot();
+	}
+	else
+	{
+		prgSizeLaunch = m_nFileLength;
+		u8 mode = 0;		// launch only
+		if ( m_SaveOrLaunch == 's' ) mode = 1;			// save only
+		else if ( m_SaveOrLaunch == 'b' ) mode = 2;		// save and launch
+		if ( strcmp( m_Extension, "d81" ) == 0 ) mode = 1;	// cannot be launched
+		m_pSidekickNet->prepareLaunchOfUpload( m_Extension, m_Filename, mode, msg );
+	}
+
+	logger->Write( "UploadServer", ok ? LogNotice : LogWarning, "%u bytes in %u ms (%u KB/s): %s",
+		received, us / 1000, rate / 1024, msg );
+
+	CString report;
+	report.Format( "%s<br/>%u bytes received in %u.%03u s (%u KB/s).", msg, received, us / 1000000, ( us / 1000 ) % 1000, rate / 1024 );
+	sendResponse( pSocket, ok ? "200 OK" : "400 Bad Request", report );
+}
+
+boolean CUploadServer::partHandler( unsigned event, const u8 *pData, unsigned length, void *pParam )
+{
+	CUploadServer *pThis = (CUploadServer *) pParam;
+	switch ( event )
+	{
+	case MULTIPART_PART_BEGIN:	return pThis->beginPart( (const char *) pData );
+	case MULTIPART_PART_DATA:	return pThis->partData( pData, length );
+	case MULTIPART_PART_END:	return pThis->endPart();
+	}
+	return false;
+}
+
+boolean CUploadServer::beginPart( const char *pHeader )
+{
+	m_Target = TargetNone;
+	if ( !getParameter( pHeader, " name=", m_FieldName, sizeof( m_FieldName ) ) )
+		return true;
+
+	char filename[ 255 ];
+	if ( !getParameter( pHeader, " filename=", filename, sizeof( filename ) ) )
+	{
+		m_Target = TargetField;
+		m_nFieldLength = 0;
+		return true;
+	}
+
+	// the form has a single file input
+	if ( filename[ 0 ] == 0 || m_FileComplete )
+		return true;
+
+	strcpy( m_Filename, filename );
+	const char *pDot = 0;
+	for ( const char *p = m_Filename; *p != 0; p++ )
+		if ( *p == '.' ) pDot = p + 1;
+	unsigned exl = 0;
+	while ( pDot != 0 && pDot[ exl ] != 0 && exl < sizeof( m_Extension ) - 1 )
+	{
+		char c = pDot[ exl ];
+		if ( c >= 'A' && c <= 'Z' ) c += 32;	//strtolower
+		m_Extension[ exl++ ] = c;
+	}
+	m_Extension[ exl ] = 0;
+	m_nFileLength = 0;
+
+	if ( strcmp( m_FieldName, "kernelimg" ) == 0 && strstr( m_Filename, "kernel" ) != 0 && strcmp( m_Extension, "img" ) == 0 )
+	{
+		m_pSidekickNet->requireCacheWellnessTreatment();
+		if ( f_open( &m_KernelFile, FILENAME_KERNEL_UPLOAD, FA_WRITE | FA_CREATE_ALWAYS ) != FR_OK )
+		{
+			m_pError = "Cannot write kernel image to SD card";
+			return false;
+		}
+		m_KernelFileOpen = true;
+		m_nWriteBuffer = 0;
+		m_Target = TargetKernel;
+	}
+	else if ( strcmp( m_Extension, "prg" ) == 0 ||
+			  strcmp( m_Extension, "d64" ) == 0 ||
+			  strcmp( m_Extension, "d81" ) == 0 ||
+			  strcmp( m_Extension, "crt" ) == 0 ||
+			  strcmp( m_Extension, "sid" ) == 0 ||
+			  m_pSidekickNet->isLibOpenMPTFileType( m_Extension ) ||
+			  strcmp( m_Extension, "bin" ) == 0 )
+	{
+		m_Target = TargetLaunch;
+	}
+	else
+	{
+		m_pError = "Unsupported file type";
+		return false;
+	}
+
+	return true;
+}
+
+boolean CUploadServer::partData( const u8 *pData, unsigned length )
+{
+	switch ( m_Target )
+	{
+	case TargetField:
+		while ( length-- > 0 && m_nFieldLength < sizeof( m_FieldValue ) - 1 )
+			m_FieldValue[ m_nFieldLength++ ] = *pData++;
+		break;
+
+	case TargetLaunch:
+		if ( m_nFileLength + length > sizeof( prgDataLaunch ) )
+		{
+			m_pError = "File too large";
+			return false;
+		}
+		memcpy( &prgDataLaunch[ m_nFileLength ], pData, length );
+		m_nFileLength += length;
+		break;
+
+	case TargetKernel:
+		m_nFileLength += length;
+		while ( length > 0 )
+		{
+			unsigned n = NET_UPLOAD_WRITE_BUFFER - m_nWriteBuffer;
+			if ( n > length ) n = length;
+			memcpy( &m_WriteBuffer[ m_nWriteBuffer ], pData, n );
+			m_nWriteBuffer += n;
+			pData += n;
+			length -= n;
+			if ( m_nWriteBuffer == NET_UPLOAD_WRITE_BUFFER && !flushKernel() )
+				return false;
+		}
+		break;
+
+	default:
+		break;
+	}
+	return true;
+}
+
+boolean CUploadServer::endPart()
+{
+	const char *pKernel;
+	FRESULT fr;
+	switch ( m_Target )
+	{
+	case TargetField:
+		m_FieldValue[ m_nFieldLength ] = 0;
+		if ( strcmp( m_FieldName, "radio_saveorlaunch" ) == 0 )
+			m_SaveOrLaunch = m_FieldValue[ 0 ];
+		break;
+
+	case TargetLaunch:
+		m_FileComplete = m_nFileLength > 0;
+		break;
+
+	case TargetKernel:
+		if ( !flushKernel() )
+			return false;
+		m_KernelFileOpen = false;
+		if ( f_close( &m_KernelFile ) != FR_OK || m_nFileLength == 0 )
+		{
+			f_unlink( FILENAME_KERNEL_UPLOAD );
+			m_pError = "Cannot write kernel image to SD card";
+			return false;
+		}
+
+		// the old kernel is only replaced by a complete image and kept as a backup until the new one
+		// is in place, f_rename takes the new name without drive
+		pKernel = m_pSidekickNet->getKernelImageFilename();
+		f_unlink( FILENAME_KERNEL_BACKUP );
+		fr = f_rename( pKernel, FILENAME_KERNEL_BACKUP + 3 );
+		if ( fr != FR_OK && fr != FR_NO_FILE )
+		{
+			f_unlink( FILENAME_KERNEL_UPLOAD );
+			m_pError = "Cannot rename kernel image on SD card";
+			return false;
+		}
+		if ( f_rename( FILENAME_KERNEL_UPLOAD, pKernel + 3 ) != FR_OK )
+		{
+			if ( fr == FR_OK )
+				f_rename( FILENAME_KERNEL_BACKUP, pKernel + 3 );
+			m_pError = "Cannot rename kernel image on SD card";
+			return false;
+		}
+		if ( fr == FR_OK )
+			f_unlink( FILENAME_KERNEL_BACKUP );
+		m_pSidekickNet->requireCacheWellnessTreatment();
+		logger->Write( "UploadServer", LogNotice, "Saved kernel image to %s, length: %u", pKernel, m_nFileLength );
+		m_KernelSaved = true;
+		m_FileComplete = true;
+		break;
+
+	default:
+		break;
+	}
+	m_Target = TargetNone;
+	return true;
+}
+
+boolean CUploadServer::flushKernel()
+{
+	if ( m_nWriteBuffer == 0 )
+		return true;
+
+	UINT written;
+	if ( f_write( &m_KernelFile, m_WriteBuffer, m_nWriteBuffer, &written ) != FR_OK || written != m_nWriteBuffer )
+	{
+		m_pError = "Cannot write kernel image to SD card";
+		return false;
+	}
+	m_nWriteBuffer = 0;
+	return true;
+}
+
+void CUploadServer::abortKernel()
+{
+	if ( !m_KernelFileOpen )
+		return;
+	m_KernelFileOpen = false;
+	f_close( &m_KernelFile );
+	f_unlink( FILENAME_KERNEL_UPLOAD );
+	m_pSidekickNet->requireCacheWellnessTreatment();
+}
@@ -0,0 +1,115 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ uploadserver.h
+
+ RasPiC64 - A framework for interfacing the C64 and a Raspberry Pi 3B/3B+
+          - streaming receiver for file uploads from the web interface
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Network related code in this file contributed by Henning Pingel based on 
+ the networking examples within Rene Stanges Circle framework.
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _uploadserver_h
+#define _uploadserver_h
+
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/types.h>
+#include <fatfs/ff.h>
+#include "multipart.h"
+
+#define NET_UPLOAD_PORT				8064
+#define NET_UPLOAD_MAX_REQUEST		4096		// request line and headers
+#define NET_UPLOAD_RECV_BUFFER		4096		// >= FRAME_BUFFER_SIZE
+#define NET_UPLOAD_WRITE_BUFFER		(64*1024)	// SD card writes are collected to this size
+
+class CSidekickNet;
+
+//
+// receives the upload form of the web interface (POST /upload) on its own port. CHTTPDaemon
+// buffers a complete request before it is handed to GetContent, here the multipart body is
+// parsed while it arrives and file parts go straight to the launch buffer or, for kernel
+// images, to the SD card. The size of an upload is thus only limited by its destination.
+//
+class CUploadServer : public CTask
+{
+public:
+	CUploadServer( CNetSubSystem *pNet, u16 nPort, CSidekickNet *pSidekickNet );
+	~CUploadServer();
+
+	void Run( void );
+
+	// true while an upload is received into prgDataLaunch or the SD card, no downloads may start meanwhile
+	boolean IsBusy() const { return m_Busy; }
+
+private:
+	enum TTarget
+	{
+		TargetNone,			// part is skipped
+		TargetField,		// form field, value is kept
+		TargetLaunch,		// file for prgDataLaunch
+		TargetKernel		// kernel image, written to SD card
+	};
+
+	void handleConnection( CSocket *pSocket );
+	int receiveHeader( CSocket *pSocket, char *pHeader, unsigned *pHeaderLength );
+	void sendResponse( CSocket *pSocket, const char *pStatus, const char *pMsg );
+
+	static boolean partHandler( unsigned event, const u8 *pData, unsigned length, void *pParam );
+	boolean beginPart( const char *pHeader );
+	boolean partData( const u8 *pData, unsigned length );
+	boolean endPart();
+	boolean flushKernel();
+	void abortKernel();
+
+	CNetSubSystem *m_pNet;
+	u16 m_nPort;
+	CSidekickNet *m_pSidekickNet;
+	CSocket *m_pListener;
+
+	CMultipartParser m_Parser;
+	u8 m_RecvBuffer[ NET_UPLOAD_RECV_BUFFER ];
+	volatile boolean m_Busy;
+
+	// state of the current upload
+	TTarget m_Target;
+	const char *m_pError;
+	char m_FieldName[ 32 ];
+	char m_FieldValue[ 16 ];
+	unsigned m_nFieldLength;
+	char m_Filename[ 255 ];
+	char m_Extension[ 10 ];
+	char m_SaveOrLaunch;
+	u32 m_nFileLength;
+	boolean m_FileComplete;
+	boolean m_KernelSaved;
+
+	FIL m_KernelFile;
+	boolean m_KernelFileOpen;
+	u8 m_WriteBuffer[ NET_UPLOAD_WRITE_BUFFER ];
+	unsigned m_nWriteBuffer;
+};
+
+#endif
@@ -29,7 +29,9 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
 #include <arm_neon.h>
+#endif
 
 #define STRETCH_X
 #define SCANLINE
@@ -247,6 +249,15 @@ typedef struct
 
 volatile VICSTATE vic656x AAA;
 
+#ifdef STRETCH_X
+// the FIQ renders the raster lines into this buffer (one row per line) instead of the frame buffer,
+// flushLinesVIC656x() copies completed lines and generates the second row with the scanline palette
+#define VIC_LINE_BYTES		2176
+#define VIC_LINES			VIC20_PAL_V_LINES
+u8 vicLines[ VIC_LINES ][ VIC_LINE_BYTES ] AAA;
+volatile s16 vicCurrentLine = 0;
+#endif
+
 __attribute__( ( always_inline ) ) inline void initVIC656x( bool VIC20PAL = true, bool debugBorders = false )
 {
 	memset( (void*)&vic656x, 0, sizeof( vic656x ) );
@@ -414,6 +425,7 @@ __attribute__( ( always_inline ) ) inline void pre_fetchVIC656x( u16 _addr )
 
 __attribute__( ( always_inline ) ) inline u16 post_fetchVIC656x( u16 ___addr )
 {
+	(void)___addr;		// the address has been latched by pre_fetchVIC656x
 	u16 D;
 
 	if ( ( addr & 0x9000 ) == 0x8000 )
@@ -555,13 +567,9 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 		}
 	}
 
-	extern u16 *pScreen;
-	extern u32 pitch;
-	u8 *pScreen8 = (u8*)pScreen;
-
 	#ifdef STRETCH_X
 	x += OFFSET_X;
-	u8* dst = (u8*)&pScreen8[ 2 * ( x * VIC20_PIXELS_PER_TICK + y * pitch * 2 ) ];
+	u8* dst = &vicLines[ y ][ 2 * x * VIC20_PIXELS_PER_TICK ];
 
 	if ( vic656x.hCycles == VIC20_NTSC_H_CYCLES )
 	{
@@ -578,9 +586,10 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 
 	if ( x < vic656x.leftBorder || x > vic656x.rightBorder )
 		rightBorderHack = 4; // = render nothing
-
-	CACHE_PRELOADL2STRMW( dst + pitch * 2 );
 	#else
+	extern u16 *pScreen;
+	extern u32 pitch;
+	u8 *pScreen8 = (u8*)pScreen;
 	u8* dst = (u8*)&pScreen8[ x * VIC20_PIXELS_PER_TICK + ( y + 20 ) * pitch * 2 ];
 	#endif
 	CACHE_PRELOADL2STRMW( dst );
@@ -593,14 +602,11 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 		#ifdef STRETCH_X
 		  #ifndef SCANLINE
 			*(u32*)dst =
-			*(u32*)( dst + 4 ) =
-			*(u32*)( dst + pitch * 2 ) =
-			*(u32*)( dst + 4 + pitch * 2 ) = vic656x.colorLUT[ 9 ];
+			*(u32*)( dst + 4 ) = vic656x.colorLUT[ 9 ];
 		  #else
-			register u64 px = vic656x.colorLUT[ 9 ];
+			u64 px = vic656x.colorLUT[ 9 ];
 			px |= px << 32;
 			*(u64*)dst = px;
-			*(u64*)( dst + pitch * 2 ) = px | 0x1010101010101010;
 		  #endif
 		#else
 		for ( int i = 0; i < 4; i++ )
@@ -614,14 +620,11 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 			#ifdef STRETCH_X
 			  #ifndef SCANLINE
 				*(u32*)dst =
-				*(u32*)( dst + 4 ) =
-				*(u32*)( dst + pitch * 2 ) =
-				*(u32*)( dst + 4 + pitch * 2 ) = vic656x.colorLUT[ 9 ];
+				*(u32*)( dst + 4 ) = vic656x.colorLUT[ 9 ];
 			  #else
-				register u64 px = vic656x.colorLUT[ 9 ];
+				u64 px = vic656x.colorLUT[ 9 ];
 				px |= px << 32;
 				*(u64*)dst = px;
-				*(u64*)( dst + pitch * 2 ) = px | 0x1010101010101010;
 			  #endif
 			#else
 			for ( int i = 0; i < 4; i++ )
@@ -632,14 +635,11 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 			#ifdef STRETCH_X
 			  #ifndef SCANLINE
 				*(u32*)dst =
-				*(u32*)( dst + 4 ) =
-				*(u32*)( dst + pitch * 2 ) =
-				*(u32*)( dst + 4 + pitch * 2 ) = vic656x.colorLUT[ 8 ];
+				*(u32*)( dst + 4 ) = vic656x.colorLUT[ 8 ];
 			  #else
-				register u64 p = vic656x.colorLUT[ 8 ];
+				u64 p = vic656x.colorLUT[ 8 ];
 				p |= p << 32;
 				*(u64*)dst = p;
-				*(u64*)( dst + pitch * 2 ) = p | 0x1010101010101010;
 			  #endif
 			#else
 			for ( int i = 0; i < 4; i++ )
@@ -652,14 +652,11 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 		#ifdef STRETCH_X
 		  #ifndef SCANLINE
 			*(u32*)dst =
-			*(u32*)( dst + 4 ) =
-			*(u32*)( dst + pitch * 2 ) =
-			*(u32*)( dst + 4 + pitch * 2 ) = vic656x.colorLUT[ 9 ];
+			*(u32*)( dst + 4 ) = vic656x.colorLUT[ 9 ];
 		  #else
-			register u64 px = vic656x.colorLUT[ 9 ];
+			u64 px = vic656x.colorLUT[ 9 ];
 			px |= px << 32;
 			*(u64*)dst = px;
-			*(u64*)( dst + pitch * 2 ) = px | 0x1010101010101010;
 		  #endif
 		#else
 	    for (int i = 0; i < 4; i++) 
@@ -672,14 +669,11 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 	{
 		#ifdef STRETCH_X
 		#ifdef SCANLINE
-			register u64 px = (u64)vic656x.colorLUT[ 1 ] | ( ( (u64)vic656x.colorLUT[ 5 ] ) << 32 );
+			u64 px = (u64)vic656x.colorLUT[ 1 ] | ( ( (u64)vic656x.colorLUT[ 5 ] ) << 32 );
 			*(u64*)dst = px;
-			*(u64*)( dst + pitch * 2 ) = px | 0x1010101010101010;
 		#else
 			*(u32*)dst = vic656x.colorLUT[ 1 ];
 			*(u32*)( dst + 4 ) = vic656x.colorLUT[ 5 ];
-			*(u32*)( dst + pitch * 2 ) = vic656x.colorLUT[ 1 ];
-			*(u32*)( dst + 4 + pitch * 2 ) = vic656x.colorLUT[ 5 ];
 		#endif
 		#else
 		*dst = vic656x.colorBRD;
@@ -703,15 +697,12 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 
 			#ifdef STRETCH_X
 			  #ifdef SCANLINE
-				register u64 px = (u64)vic656x.colorLUT[ p >> 6 ] | ( ( (u64)vic656x.colorLUT[ 4 + ( ( p >> 4 ) & 3 ) ] ) << 32 );
+				u64 px = (u64)vic656x.colorLUT[ p >> 6 ] | ( ( (u64)vic656x.colorLUT[ 4 + ( ( p >> 4 ) & 3 ) ] ) << 32 );
 				*(u64*)dst = px;
-				*(u64*)( dst + pitch * 2 ) = px | 0x1010101010101010;
 
 			  #else
 				*(u32*)dst = vic656x.colorLUT[ p >> 6 ];
-				*(u32*)( dst + pitch * 2 ) = vic656x.colorLUT[ ( p >> 6 ) ];
 				*(u32*)( dst + 4 ) = vic656x.colorLUT[ 4 + ( ( p >> 4 ) & 3 ) ];
-				*(u32*)( dst + 4 + pitch * 2 ) = vic656x.colorLUT[ 4 + ( ( p >> 4 ) & 3 ) ];
 			  #endif
 			#else
 			  *(u16*)dst = vic656x.colorLUT[ p >> 6 ];
@@ -742,12 +733,6 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 					( ( p >> 4 ) & 1 ) * ( 65535LL << 48 );
 
 				*(uint64_t*)dst = ( fg64 & mask ) | ( bg64 & ~mask );
-
-				#ifdef SCANLINE
-					*(uint64_t*)( dst + pitch * 2 ) = ( fg64 & mask ) | ( bg64 & ~mask ) | 0x1010101010101010;
-				#else
-					*(uint64_t*)( dst + pitch * 2 ) = ( fg64 & mask ) | ( bg64 & ~mask );
-				#endif	
 			#else
 				u32 bg, fg;
 				u32 bg12, fg12;
@@ -826,6 +811,9 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 
 		vic656x.hCount = 0;
 		vic656x.vCount ++;
+		#ifdef STRETCH_X
+		vicCurrentLine = vic656x.vCount % vic656x.vLines;
+		#endif
 
 		if ( vic656x.curArea == VIC_AREA_DISPLAY )
 			vic656x.rasterCounterY ++;
@@ -946,6 +934,77 @@ __attribute__( ( always_inline ) ) inline void tickVideoVIC656x()
 
 
 
+#ifdef STRETCH_X
+// called outside the FIQ: copies the completed raster lines to the frame buffer
+__attribute__( ( always_inline ) ) inline void flushLinesVIC656x()
+{
+	extern u16 *pScreen;
+	extern u32 pitch;
+	static s16 nextLine = 0;
+
+	// the line before the current one still receives pixels at the right border
+	s16 endLine = vicCurrentLine - 1;
+	if ( endLine < 0 ) endLine += vic656x.vLines;
+
+	s16 lastY;
+	u32 ofs = 8 * vic656x.leftBorder;
+	if ( vic656x.hCycles == VIC20_NTSC_H_CYCLES )
+	{
+		lastY = VIC20_NTSC_LAST_LINE - VIC20_NTSC_FIRST_LINE;
+		ofs += 80;
+	} else
+	{
+		lastY = VIC20_PAL_LAST_LINE - VIC20_PAL_FIRST_LINE;
+		ofs += 16;
+	}
+	u32 len = 8 * ( vic656x.rightBorder - vic656x.leftBorder + 1 );
+
+	while ( nextLine != endLine )
+	{
+		s16 y = nextLine + vic656x.vOffset;
+
+		if ( y > 0 && y < lastY )
+		{
+			const u8 *src = &vicLines[ y ][ ofs ];
+			u8 *dst = (u8*)pScreen + ofs + y * pitch * 4;
+			u8 *dst2 = dst + pitch * 2;
+
+			#ifdef SCANLINE
+			const u8 scanlineBit = 0x10;
+			#else
+			const u8 scanlineBit = 0;
+			#endif
+
+			#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+			const uint8x16_t scanline = vdupq_n_u8( scanlineBit );
+
+			u32 i = 0;
+			for ( ; i + 16 <= len; i += 16 )
+			{
+				uint8x16_t v = vld1q_u8( src + i );
+				vst1q_u8( dst + i, v );
+				vst1q_u8( dst2 + i, vorrq_u8( v, scanline ) );
+			}
+			if ( i < len )
+			{
+				uint8x8_t v = vld1_u8( src + i );
+				vst1_u8( dst + i, v );
+				vst1_u8( dst2 + i, vorr_u8( v, vget_low_u8( scanline ) ) );
+			}
+			#else
+			// scalar fallback, e.g. for the host-side harness (Source/VICHarness)
+			memcpy( dst, src, len );
+			for ( u32 i = 0; i < len; i++ )
+				dst2[ i ] = src[ i ] | scanlineBit;
+			#endif
+		}
+
+		if ( ++ nextLine >= vic656x.vLines )
+			nextLine = 0;
+	}
+}
+#endif
+
 static s16 voltageLUT[ 32 ] = {
 	 1477,  4159,  6463,  8847, 10840, 12968, 15369, 18058,
 	20623, 22212, 23313, 24634, 25837, 26898, 27768, 27908,
@@ -992,7 +1051,7 @@ __attribute__( ( always_inline ) ) inline void tickAudioVIC656x()
 	#ifdef INTERLEAVED_SOUND_EMULATION
 	if ( vic656x.updChannel < 3 )
 	{
-		register u8 i = vic656x.updChannel;
+		u8 i = vic656x.updChannel;
 		vic656x.ch_ctr[ i ] -= 4;
 		if ( vic656x.ch_ctr[ i ] <= 0 )
 		{
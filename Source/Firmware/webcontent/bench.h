@@ -0,0 +1,22 @@
+"<!doctype html>\n"
+"<html lang=\"en\">\n"
+"<head>\n"
+"\t<meta charset=\"utf-8\">\n"
+"\t<meta name=\"viewport\" content=\"width=device-width, initial-scale=1, shrink-to-fit=no\">\n"
+"\t<link rel=\"stylesheet\" href=\"https://cdnjs.cloudflare.com/ajax/libs/bootswatch/4.5.2/darkly/bootstrap.min.css\" integrity=\"sha512-8lE+UgnY2CgbE+WDsGwSwAiMOswuRYm11jXYV5KWH6XfSDAzrdRMbPQDpCwzVjJbe9quHrNNPV6N/llRKnw5Hg==\" crossorigin=\"anonymous\" />\n"
+"\t<title>Sidekick64 Network Benchmark</title>\n"
+"</head>\n"
+"<body>\n"
+"\t&nbsp;<br/><div class=\"container\">\t\n"
+"\t<h3>Sidekick64 Network Benchmark</h3>\n"
+"\t<div class=\"container bg-dark\">\n"
+"\t\t<p>Peer: %s (%s)</p>\n"
+"\t\t<pre>%s</pre>\n"
+"\t\t<p><a href=\"bench.html?run=1\">Run benchmark</a> &middot; <a href=\"bench.html\">Reload results</a></p>\n"
+"\t</div>\n"
+"\t<p class=\"small\"><a href=\"https://github.com/frntc/Sidekick64\" target=\"_blank\">Sidekick64</a></p>\n"
+"\t<p class=\"small\">Based on the <a href=\"https://github.com/rsta2/circle\" target=\"_blank\">Circle</a> C++ bare metal environment.</p>\n"
+"</div>\n"
+"</body>\n"
+"</html>\n"
+""
\ No newline at end of file
@@ -61,6 +61,10 @@
 "\t\t\t\t<br/><br/>\n"
 "\t\t\t</div>\n"
 "\t\t</form>\n"
+"\t\t<script>\n"
+"\t\t\t// files are streamed to the upload server, index.html stays as fallback without scripts\n"
+"\t\t\tdocument.forms['upload_form'].action = 'http://' + location.hostname + ':8064/upload';\n"
+"\t\t</script>\n"
 "\n"
 "\t\t<form action=\"index.html\" method=\"post\" name=\"config_form\" enctype=\"multipart/form-data\">\n"
 "\t\t\t<div class=\"form-group\">\n"
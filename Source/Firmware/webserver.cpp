@@ -46,6 +46,10 @@ static const char s_Upload[] =
 #include "webcontent/upload.h"
 ;
 
+static const char s_Bench[] =
+#include "webcontent/bench.h"
+;
+
 /*
 static const char s_Tuning[] =
 #include "webcontent/tuning.h"
@@ -259,19 +263,7 @@ CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pS
 			
 			m_SidekickNet->requireCacheWellnessTreatment();
 
-#ifndef IS264
-			#if RASPPI >= 4
-				const char * filenamek = "SD:rpi4_kernel_sk64_net.img";
-			#else
-				const char * filenamek = !m_SidekickNet->kernelSupportsWLAN() ? "SD:kernel_sk64_ethernet.img" : "SD:kernel_sk64_net.img";
-			#endif
-#else
-			#if RASPPI >= 4
-				const char * filenamek = m_SidekickNet->usesWLAN() ? "SD:rpi4_kernel_sk264_wlan.img" : "SD:rpi4_kernel_sk264_net.img";
-			#else
-				const char * filenamek = m_SidekickNet->usesWLAN() ? "SD:kernel_sk264_wlan.img" : "SD:kernel_sk264_net.img";
-			#endif
-#endif			
+			const char * filenamek = m_SidekickNet->getKernelImageFilename();
 			logger->Write( FromWebServer, LogNotice, "Saving kernel image to SD card, length: %u", nPartLength);
 			writeFile( logger, "SD:", filenamek, (u8*) pPartData, nPartLength );
 			m_SidekickNet->requireCacheWellnessTreatment();
@@ -471,6 +463,28 @@ CHTTPDaemon *CWebServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pS
 		*ppContentType = "text/html; charset=UTF-8";
 	}
 	*/
+	else if (strcmp (pPath, "/bench.html") == 0)
+	{
+		if (pParams != 0 && strstr (pParams, "run=1") != 0 && m_SidekickNet->IsRunning())
+			m_SidekickNet->queueNetworkBenchmark();
+
+		CString results = "";
+		if (m_SidekickNet->isNetworkBenchmarkRunning())
+			results.Append( "Benchmark is running, reload the page in a few seconds.\n" );
+		else
+			for ( unsigned i = 0; i < 3; i++ )
+			{
+				results.Append( m_SidekickNet->getNetworkBenchmarkInfo( i ) );
+				results.Append( "\n" );
+			}
+		results.Append( m_SidekickNet->getSysMonInfo( 1 ) );
+
+		String.Format (s_Bench, netSktpHostName, m_SidekickNet->usesWLAN() ? "via WLAN" : "via ethernet", (const char *) results);
+
+		pContent = (const u8 *) (const char *) String;
+		nLength = String.GetLength ();
+		*ppContentType = "text/html; charset=UTF-8";
+	}
 	else if (strcmp (pPath, "/style.css") == 0)
 	{
 		pContent = s_Style;
@@ -0,0 +1,8 @@
+// host build of multipartcheck: the Circle types used by multipart.cpp
+#ifndef _circle_types_h
+#define _circle_types_h
+
+typedef unsigned char u8;
+typedef bool boolean;
+
+#endif
@@ -0,0 +1,7 @@
+// host build of multipartcheck: Circle's string functions are those of the C library
+#ifndef _circle_util_h
+#define _circle_util_h
+
+#include <string.h>
+
+#endif
@@ -0,0 +1,168 @@
+/*
+  _________.__    .___      __   .__        __      _______________   
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __  \_____  \   _  \  
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /   /  ____/  /_\  \ 
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <   /       \  \_/   \
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \  \_______ \_____  /
+        \/         \/    \/     \/       \/     \/          \/     \/  
+ 
+ multipartcheck.cpp
+
+ Sidekick64 - host-side check of the multipart/form-data parser of the upload server (multipart.cpp):
+              bodies with random parts are fed in pieces of all sizes, i.e. with delimiters
+              split across pieces, and the parts are compared with what was sent
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// build: g++ -O2 -I. -o multipartcheck multipartcheck.cpp ../Firmware/multipart.cpp
+// usage: multipartcheck [-n bodies] [-s seed]
+//
+// The directory circle/ holds the two Circle headers multipart.cpp needs, mapped to the C library.
+// Exit code 1 if a body was not split into its parts correctly.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "../Firmware/multipart.h"
+
+struct TResult
+{
+	std::vector<std::string> headers;
+	std::vector<std::string> data;
+	unsigned open;		// parts begun but not ended
+	boolean broken;		// events out of order
+};
+
+static boolean handler( unsigned event, const u8 *pData, unsigned length, void *pParam )
+{
+	TResult *r = (TResult *) pParam;
+	switch ( event )
+	{
+	case MULTIPART_PART_BEGIN:
+		if ( r->open ) r->broken = true;
+		r->headers.push_back( std::string( (const char *) pData, length ) );
+		r->data.push_back( std::string() );
+		r->open = 1;
+		break;
+	case MULTIPART_PART_DATA:
+		if ( !r->open || length == 0 ) r->broken = true; else
+			r->data.back().append( (const char *) pData, length );
+		break;
+	case MULTIPART_PART_END:
+		if ( !r->open ) r->broken = true;
+		r->open = 0;
+		break;
+	}
+	return true;
+}
+
+// part data which resembles the delimiter: CR, LF, dashes and prefixes of the boundary
+static std::string randomData( const std::string &boundary )
+{
+	std::string d;
+	unsigned n = rand() % 300;
+	while ( d.size() < n )
+	{
+		switch ( rand() % 6 )
+		{
+		case 0: d += "\r\n"; break;
+		case 1: d += "\r\n--"; break;
+		case 2: d += "\r\n--" + boundary.substr( 0, rand() % boundary.size() ) + '.'; break;	// '.' is not used in boundaries
+		case 3: d += '-'; break;
+		case 4: d += (char)( rand() & 255 ); break;
+		default: d += "data"; break;
+		}
+	}
+	return d;
+}
+
+// sends 'body' in pieces, 'piece' 0 means random sizes
+static boolean check( const std::string &body, const std::string &boundary, const std::vector<std::string> &headers, const std::vector<std::string> &data, unsigned piece )
+{
+	TResult r;
+	r.open = 0;
+	r.broken = false;
+
+	CMultipartParser parser;
+	if ( !parser.Init( boundary.c_str(), handler, &r ) )
+		return false;
+
+	for ( unsigned pos = 0; pos < body.size(); )
+	{
+		unsigned n = piece ? piece : 1 + rand() % 64;
+		if ( n > body.size() - pos ) n = body.size() - pos;
+		if ( !parser.Put( (const u8 *) &body[ pos ], n ) )
+			return false;
+		pos += n;
+	}
+	return parser.IsComplete() && !r.broken && !r.open && r.headers == headers && r.data == data;
+}
+
+int main( int argc, char **argv )
+{
+	unsigned nBodies = 200, seed = 1;
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( strcmp( argv[ i ], "-n" ) == 0 && i + 1 < argc ) nBodies = atoi( argv[ ++i ] ); else
+		if ( strcmp( argv[ i ], "-s" ) == 0 && i + 1 < argc ) seed = atoi( argv[ ++i ] ); else
+		{
+			printf( "usage: multipartcheck [-n bodies] [-s seed]\n" );
+			return 2;
+		}
+	}
+	srand( seed );
+
+	unsigned nChecks = 0, nFailed = 0;
+	for ( unsigned b = 0; b < nBodies; b++ )
+	{
+		// boundaries like browsers create them, some with dashes
+		std::string boundary = ( b & 1 ) ? "----WebKitFormBoundary" : "-";
+		unsigned l = 8 + rand() % 30;
+		for ( unsigned i = 0; i < l; i++ )
+			boundary += "abcdefghijklmnopqrstuvwxyz0123456789-"[ rand() % 37 ];
+
+		std::vector<std::string> headers, data;
+		std::string body = ( b & 2 ) ? "preamble\r\n" : "";
+		unsigned nParts = 1 + rand() % 4;
+		for ( unsigned p = 0; p < nParts; p++ )
+		{
+			char h[ 128 ];
+			sprintf( h, "Content-Disposition: form-data; name=\"f%u\"; filename=\"x%u.prg\"", p, b );
+			headers.push_back( h );
+			data.push_back( randomData( boundary ) );
+			body += ( p == 0 && !( b & 2 ) ? "--" : "\r\n--" ) + boundary + "\r\n" + headers.back() + "\r\n\r\n" + data.back();
+		}
+		body += "\r\n--" + boundary + "--\r\n";
+
+		// every piece size up to beyond the delimiter length, then random sizes
+		for ( unsigned piece = 0; piece <= boundary.size() + 8; piece++ )
+		{
+			nChecks++;
+			if ( !check( body, boundary, headers, data, piece ) )
+			{
+				if ( nFailed++ < 10 )
+					printf( "body %u (boundary '%s', %u bytes) failed with pieces of %u bytes\n", b, boundary.c_str(), (unsigned) body.size(), piece );
+			}
+		}
+	}
+
+	printf( "%u of %u checks passed\n", nChecks - nFailed, nChecks );
+	return nFailed ? 1 : 0;
+}
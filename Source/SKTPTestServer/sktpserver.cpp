@@ -0,0 +1,431 @@
+/*
+  _________.__    .___      __   .__        __        _________   ________   _____  
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __    \_   ___ \ /  _____/  /  |  | 
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /    /    \  \//   __  \  /   |  |_
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <     \     \___\  |__\  \/    ^   /
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \     \______  /\_____  /\____   | 
+        \/         \/    \/     \/       \/     \/            \/       \/      |__| 
+ 
+ sktpserver.cpp
+
+ Sidekick64 - minimal SKTP test server with a reference encoder for
+              compressed and delta frames (chunk type 9)
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+ 
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// build: g++ -O2 -o sktpserver sktpserver.cpp
+// usage: sktpserver [port]
+//
+// Serves a few pages of a dummy file browser, any key flips to the next page.
+// Clients announcing "frames=1" on session start get compressed frames and
+// delta frames against the last acknowledged frame ("ack=<id>"), all others
+// get the plain screencode chunks. Each response is logged along with the
+// size the plain encoding would have had.
+//
+// It is also the peer of the network benchmark (T on the network screen):
+// "GET /bench?bytes=n" answers with n bytes, "POST /bench" swallows the body.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#define FRAME_SIZE 2000 // 1000 screen codes followed by 1000 colors
+#define FRAME_HISTORY 4
+#define MAX_SESSIONS 16
+#define NUM_PAGES 8
+
+typedef unsigned char u8;
+
+struct Session
+{
+	char id[ 33 ];
+	bool frames;
+	unsigned page, counter;
+	unsigned short nextFrameId;
+	unsigned short historyId[ FRAME_HISTORY ];
+	u8 history[ FRAME_HISTORY ][ FRAME_SIZE ];
+};
+
+static Session sessions[ MAX_SESSIONS ];
+static unsigned nSessions = 0;
+
+//
+// reference encoder, see CSidekickNet::sktpDecompress for the format
+//
+static unsigned compressFrame( const u8 *src, unsigned size, u8 *dst )
+{
+	unsigned s = 0, d = 0, literals = 0;
+
+	#define FLUSH_LITERALS \
+		while ( literals > 0 ) { \
+			unsigned n = literals > 128 ? 128 : literals; \
+			dst[ d++ ] = n - 1; \
+			memcpy( &dst[ d ], &src[ s - literals ], n ); \
+			d += n; literals -= n; }
+
+	while ( s < size )
+	{
+		// find the longest match, brute force is fast enough for 2000 bytes
+		unsigned bestLength = 0, bestDistance = 0;
+		for ( unsigned distance = 1; distance <= s; distance++ )
+		{
+			unsigned l = 0;
+			while ( l < 130 && s + l < size && src[ s + l ] == src[ s + l - distance ] )
+				l++;
+			if ( l > bestLength )
+			{
+				bestLength = l;
+				bestDistance = distance;
+				if ( l == 130 ) break;
+			}
+		}
+
+		if ( bestLength >= 3 )
+		{
+			FLUSH_LITERALS
+			dst[ d++ ] = 0x80 | ( bestLength - 3 );
+			dst[ d++ ] = bestDistance & 255;
+			dst[ d++ ] = bestDistance >> 8;
+			s += bestLength;
+		} else
+		{
+			s++;
+			literals++;
+		}
+	}
+	FLUSH_LITERALS
+	#undef FLUSH_LITERALS
+
+	return d;
+}
+
+static u8 screenCode( char c )
+{
+	if ( c >= 'a' && c <= 'z' ) return c - 'a' + 1;
+	if ( c >= 'A' && c <= 'Z' ) return c - 'A' + 1;
+	if ( c == '@' ) return 0;
+	return (u8)c;
+}
+
+static void printFrame( u8 *frame, int x, int y, const char *text, u8 color )
+{
+	for ( int i = 0; text[ i ] && x + i < 40; i++ )
+	{
+		frame[ y * 40 + x + i ] = screenCode( text[ i ] );
+		frame[ 1000 + y * 40 + x + i ] = color;
+	}
+}
+
+static void composePage( Session *s, u8 *frame )
+{
+	char line[ 64 ];
+
+	memset( frame, 32, 1000 );
+	memset( frame + 1000, 14, 1000 );
+
+	printFrame( frame, 1, 1, "SKTP TEST SERVER", 1 );
+	sprintf( line, "page %u/%u  request %u", s->page + 1, NUM_PAGES, s->counter );
+	printFrame( frame, 1, 2, line, 15 );
+	for ( int i = 0; i < 40; i++ )
+	{
+		frame[ 3 * 40 + i ] = 64;
+		frame[ 1000 + 3 * 40 + i ] = 11;
+	}
+	for ( unsigned i = 0; i < 18; i++ )
+	{
+		sprintf( line, "%03u  demo entry %03u.prg", s->page * 18 + i + 1, ( s->page * 18 + i ) * 7 % 1000 );
+		printFrame( frame, 2, 5 + i, line, i & 1 ? 3 : 13 );
+	}
+	printFrame( frame, 1, 24, "any key: next page", 12 );
+}
+
+// plain encoding: one screencode chunk (type 2) per row and color
+static unsigned encodePlain( const u8 *frame, u8 *dst )
+{
+	unsigned d = 0;
+	dst[ d++ ] = 0; // response type: clear screen and paint
+	for ( unsigned pos = 0; pos < 1000; )
+	{
+		unsigned n = 1;
+		while ( n < 40 - pos % 40 && frame[ 1000 + pos + n ] == frame[ 1000 + pos ] )
+			n++;
+		dst[ d++ ] = 2;
+		dst[ d++ ] = n & 255;
+		dst[ d++ ] = pos & 255;
+		dst[ d++ ] = ( ( pos >> 8 ) & 3 ) | ( ( ( n >> 8 ) & 3 ) << 4 );
+		dst[ d++ ] = frame[ 1000 + pos ] & 127;
+		memcpy( &dst[ d ], &frame[ pos ], n );
+		d += n;
+		pos += n;
+	}
+	return d;
+}
+
+static unsigned encodeFrames( Session *s, const u8 *frame, unsigned ack, bool redraw, u8 *dst, bool *isDelta )
+{
+	const u8 *base = 0;
+	if ( !redraw && ack != 0 )
+		for ( int i = 0; i < FRAME_HISTORY; i++ )
+			if ( s->historyId[ i ] == ack )
+				base = s->history[ i ];
+
+	u8 data[ FRAME_SIZE ];
+	for ( unsigned i = 0; i < FRAME_SIZE; i++ )
+		data[ i ] = base ? frame[ i ] ^ base[ i ] : frame[ i ];
+	*isDelta = base != 0;
+
+	unsigned short id = s->nextFrameId++;
+	if ( s->nextFrameId == 0 ) s->nextFrameId = 1;
+	memcpy( s->history[ id % FRAME_HISTORY ], frame, FRAME_SIZE );
+	s->historyId[ id % FRAME_HISTORY ] = id;
+
+	unsigned d = 0;
+	dst[ d++ ] = 1; // response type: paint over, the frame covers the whole screen
+	dst[ d++ ] = 9;
+	dst[ d++ ] = base ? 1 : 0;
+	dst[ d++ ] = id & 255;
+	dst[ d++ ] = id >> 8;
+	dst[ d++ ] = ack & 255;
+	dst[ d++ ] = ack >> 8;
+	unsigned length = compressFrame( data, FRAME_SIZE, &dst[ d + 2 ] );
+	dst[ d++ ] = length & 255;
+	dst[ d++ ] = length >> 8;
+	return d + length;
+}
+
+static bool getParameter( const char *query, const char *name, char *value, unsigned size )
+{
+	unsigned l = strlen( name );
+	for ( const char *p = query; ( p = strstr( p, name ) ) != 0; p += l )
+	{
+		if ( ( p == query || p[ -1 ] == '?' || p[ -1 ] == '&' ) && p[ l ] == '=' )
+		{
+			p += l + 1;
+			unsigned i = 0;
+			while ( *p && *p != '&' && *p != ' ' && i < size - 1 )
+				value[ i++ ] = *p++;
+			value[ i ] = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+static unsigned handleRequest( const char *query, u8 *response )
+{
+	char value[ 64 ];
+
+	if ( getParameter( query, "session", value, sizeof( value ) ) && strcmp( value, "new" ) == 0 )
+	{
+		Session *s = &sessions[ nSessions++ % MAX_SESSIONS ];
+		memset( s, 0, sizeof( Session ) );
+		for ( int i = 0; i < 32; i++ )
+			s->id[ i ] = "0123456789abcdef"[ rand() & 15 ];
+		s->frames = getParameter( query, "frames", value, sizeof( value ) ) && atoi( value ) == 1;
+		s->nextFrameId = 1;
+		printf( "new session %s (frames: %s)\n", s->id, s->frames ? "yes" : "no" );
+		memcpy( response, s->id, 32 );
+		return 32;
+	}
+
+	Session *s = 0;
+	if ( getParameter( query, "sessionid", value, sizeof( value ) ) )
+		for ( unsigned i = 0; i < MAX_SESSIONS; i++ )
+			if ( strcmp( sessions[ i ].id, value ) == 0 )
+				s = &sessions[ i ];
+	if ( s == 0 )
+	{
+		response[ 0 ] = 3; // no session or session expired
+		return 1;
+	}
+
+	unsigned key = getParameter( query, "key", value, sizeof( value ) ) ? strtoul( value, 0, 16 ) : 0;
+	unsigned ack = getParameter( query, "ack", value, sizeof( value ) ) ? atoi( value ) : 0;
+	bool redraw = getParameter( query, "redraw", value, sizeof( value ) );
+
+	if ( key != 0 )
+		s->page = ( s->page + 1 ) % NUM_PAGES;
+	s->counter++;
+
+	u8 frame[ FRAME_SIZE ];
+	composePage( s, frame );
+
+	u8 plain[ 8192 ];
+	unsigned plainLength = encodePlain( frame, plain );
+
+	unsigned length;
+	if ( s->frames )
+	{
+		bool isDelta;
+		length = encodeFrames( s, frame, ack, redraw, response, &isDelta );
+		printf( "key %02X ack %u: %s frame, %u bytes (plain: %u bytes)\n", key, ack, isDelta ? "delta" : "full", length, plainLength );
+	} else
+	{
+		memcpy( response, plain, plainLength );
+		length = plainLength;
+		printf( "key %02X: plain chunks, %u bytes\n", key, length );
+	}
+	return length;
+}
+
+static double seconds()
+{
+	struct timeval tv;
+	gettimeofday( &tv, 0 );
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static unsigned contentLength( const char *header )
+{
+	for ( const char *p = header; ( p = strchr( p, '\n' ) ) != 0; )
+		if ( strncasecmp( ++p, "Content-Length:", 15 ) == 0 )
+			return strtoul( p + 15, 0, 10 );
+	return 0;
+}
+
+// benchmark download, the data is sent in pieces so any size works
+static bool sendBenchData( int fd, unsigned bytes )
+{
+	static u8 data[ 16384 ];
+	for ( unsigned i = 0; i < sizeof( data ); i++ )
+		data[ i ] = i;
+
+	double start = seconds();
+	for ( unsigned sent = 0; sent < bytes; )
+	{
+		unsigned n = bytes - sent < sizeof( data ) ? bytes - sent : sizeof( data );
+		if ( send( fd, data, n, 0 ) != (int)n )
+			return false;
+		sent += n;
+	}
+	if ( bytes > 0 )
+		printf( "bench: sent %u bytes in %.3f s\n", bytes, seconds() - start );
+	return true;
+}
+
+// benchmark upload, 'fill' bytes of the body are already in the request buffer
+static bool receiveBenchData( int fd, unsigned bytes, unsigned fill )
+{
+	char buffer[ 16384 ];
+	double start = seconds();
+	for ( unsigned received = fill; received < bytes; )
+	{
+		unsigned n = bytes - received < sizeof( buffer ) ? bytes - received : sizeof( buffer );
+		int r = recv( fd, buffer, n, 0 );
+		if ( r <= 0 )
+			return false;
+		received += r;
+	}
+	printf( "bench: received %u bytes in %.3f s\n", bytes, seconds() - start );
+	return true;
+}
+
+static void handleConnection( int fd )
+{
+	char request[ 4096 ];
+	unsigned fill = 0;
+
+	struct timeval tv = { 10, 0 };
+	setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+
+	// requests of a keep-alive connection are answered one after another
+	while ( 1 )
+	{
+		char *end;
+		while ( ( end = (char*)memmem( request, fill, "\r\n\r\n", 4 ) ) == 0 )
+		{
+			if ( fill == sizeof( request ) - 1 ) return;
+			int r = recv( fd, request + fill, sizeof( request ) - 1 - fill, 0 );
+			if ( r <= 0 ) return;
+			fill += r;
+		}
+		*end = 0;
+
+		static u8 response[ 8192 ];
+		char header[ 256 ];
+		unsigned length = 0;
+		const char *status = "404 Not Found";
+		char *path = strchr( request, ' ' );
+		unsigned used = end + 4 - request;
+		unsigned benchBytes = 0;
+		char value[ 16 ];
+		if ( strncmp( request, "GET ", 4 ) == 0 && path && strncmp( path + 1, "/sktp.php", 9 ) == 0 )
+		{
+			length = handleRequest( path + 1, response );
+			status = "200 OK";
+		} else
+		if ( strncmp( request, "GET ", 4 ) == 0 && path && strncmp( path + 1, "/bench", 6 ) == 0 )
+		{
+			benchBytes = getParameter( path + 1, "bytes", value, sizeof( value ) ) ? strtoul( value, 0, 10 ) : 0;
+			status = "200 OK";
+		} else
+		if ( strncmp( request, "POST ", 5 ) == 0 && path && strncmp( path + 1, "/bench", 6 ) == 0 )
+		{
+			// the body is consumed here, the connection is closed by the client afterwards
+			unsigned bodyLength = contentLength( request );
+			unsigned buffered = fill - used < bodyLength ? fill - used : bodyLength;
+			if ( !receiveBenchData( fd, bodyLength, buffered ) )
+				return;
+			used += buffered;
+			status = "200 OK";
+		}
+
+		int h = sprintf( header, "HTTP/1.1 %s\r\nContent-Type: application/octet-stream\r\nContent-Length: %u\r\nConnection: keep-alive\r\n\r\n", status, length + benchBytes );
+		if ( send( fd, header, h, 0 ) != h || send( fd, response, length, 0 ) != (int)length || !sendBenchData( fd, benchBytes ) )
+			return;
+
+		memmove( request, request + used, fill - used );
+		fill -= used;
+	}
+}
+
+int main( int argc, char **argv )
+{
+	int port = argc > 1 ? atoi( argv[ 1 ] ) : 8080;
+	setvbuf( stdout, 0, _IOLBF, 0 );
+
+	int fd = socket( AF_INET, SOCK_STREAM, 0 );
+	int one = 1;
+	setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof( one ) );
+
+	struct sockaddr_in addr;
+	memset( &addr, 0, sizeof( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl( INADDR_ANY );
+	addr.sin_port = htons( port );
+	if ( bind( fd, (struct sockaddr*)&addr, sizeof( addr ) ) < 0 || listen( fd, 4 ) < 0 )
+	{
+		perror( "sktpserver" );
+		return 1;
+	}
+	printf( "SKTP test server listening on port %d\n", port );
+
+	while ( 1 )
+	{
+		int c = accept( fd, 0, 0 );
+		if ( c < 0 ) continue;
+		handleConnection( c );
+		close( c );
+	}
+	return 0;
+}
@@ -0,0 +1,665 @@
+/*
+  _________.__    .___      __   .__        __      _______________   
+ /   _____/|__| __| _/____ |  | _|__| ____ |  | __  \_____  \   _  \  
+ \_____  \ |  |/ __ |/ __ \|  |/ /  |/ ___\|  |/ /   /  ____/  /_\  \ 
+ /        \|  / /_/ \  ___/|    <|  \  \___|    <   /       \  \_/   \
+/_______  /|__\____ |\___  >__|_ \__|\___  >__|_ \  \_______ \_____  /
+        \/         \/    \/     \/       \/     \/          \/     \/  
+ 
+ vicharness.cpp
+
+ Sidekick64 - host-side harness for the VIC 656x emulation (vic656x_inline.h):
+              renders register/bus streams to PNG frames and WAV audio,
+              checks golden frame checksums and benchmarks the emulation
+ Copyright (c) 2019, 2020 Carsten Dachsbacher <frenetic@dachsbacher.de>
+
+ Logo created with http://patorjk.com/software/taag/
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// build: g++ -O2 -o vicharness vicharness.cpp
+// usage: vicharness [options] [trace]
+//
+//   -n frames     number of frames to emulate (default 4)
+//   -ntsc         emulate an NTSC VIC (default PAL)
+//   -s seed       synthetic stream: random screen, charset and register writes
+//   -o prefix     write prefix000.png, prefix001.png, ... and prefix.wav
+//   -G file       write the frame and audio checksums to a golden file
+//   -g file       compare against a golden file, exit code 1 on mismatch
+//   -b            benchmark, prints ns per emulated cycle (without NEON, e.g. on x86, the
+//                 line flush is the scalar fallback and not the code the firmware runs)
+//   -f            enable the audio filter (cfgVIC_Audio_Filter)
+//   -v            enable VFLI support (cfgVIC_VFLI_Support)
+//   -d            debug borders (render the complete raster line)
+//   -i intensity  scanline intensity for the PNG palette (0..256, default 256)
+//
+// A trace is a text file, one command per line, numbers are decimal, 0x.. or $..:
+//
+//   load <addr> <file>        raw binary into the VIC-20 address space
+//   prg <file>                .prg file at its load address
+//   chr <file>                4k character ROM
+//   <cycle> <addr> <value>    CPU write at the given emulated cycle, with the
+//                             same decoding as the FIQ handler of kernel_menu20:
+//                             VIC registers at $9000-$900F, VIA $9110/$9112 for
+//                             VFLI, all other addresses go to memory
+//   # ...                     comment
+//
+// Frames are counted when their last raster line has been flushed, the frame
+// that is in progress when the emulation starts is skipped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef unsigned char u8;
+typedef unsigned short u16;
+typedef unsigned int u32;
+typedef unsigned long long u64;
+typedef signed short s16;
+typedef signed int s32;
+
+#define AAA __attribute__( ( aligned( 128 ) ) )
+#define CACHE_PRELOADL2KEEP( p ) { (void)( p ); }
+#define CACHE_PRELOADL2STRMW( p ) {}
+#define minsk(a,b) (((a)<(b))?(a):(b))
+
+// the globals vic656x_inline.h expects, same layout as in kernel_menu20.cpp
+u8 cart_ram[ 1024 * ( 52 + 16 + 4 ) ] AAA;
+u8 *charROM = &cart_ram[ 1024 * 68 ];
+u8 *vfli_ram = &cart_ram[ 1024 * 52 ];
+u8 activateVFLIHack = 0;
+u8 bankVFLI = 0x0f;
+u8 cfgVIC_Audio_Filter = 0;
+u8 cfgVIC_VFLI_Support = 0;
+u16 *pScreen;
+u32 pitch;
+
+#include "../Firmware/vic656x_inline.h"
+
+#define MAX_FRAMES 10000
+
+struct BusWrite
+{
+	u64 cycle;
+	u16 addr;
+	u8  value;
+};
+
+static BusWrite *busWrites = NULL;
+static u32 nBusWrites = 0, maxBusWrites = 0;
+
+static u8 frameBuffer[ 2 * VIC_LINES ][ VIC_LINE_BYTES ];
+
+static s16 *samples = NULL;
+static u32 nSamples = 0, maxSamples = 0;
+
+static u32 frameCRC[ MAX_FRAMES ];
+
+static u32 crcTable[ 256 ];
+
+static void initCRC()
+{
+	for ( u32 i = 0; i < 256; i++ )
+	{
+		u32 c = i;
+		for ( int k = 0; k < 8; k++ )
+			c = ( c & 1 ) ? 0xedb88320 ^ ( c >> 1 ) : c >> 1;
+		crcTable[ i ] = c;
+	}
+}
+
+static u32 crc32( u32 crc, const u8 *data, u32 size )
+{
+	crc = ~crc;
+	for ( u32 i = 0; i < size; i++ )
+		crc = crcTable[ ( crc ^ data[ i ] ) & 255 ] ^ ( crc >> 8 );
+	return ~crc;
+}
+
+static double nanoseconds()
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//
+// trace input
+//
+static void addBusWrite( u64 cycle, u16 addr, u8 value )
+{
+	if ( nBusWrites == maxBusWrites )
+	{
+		maxBusWrites = maxBusWrites ? maxBusWrites * 2 : 4096;
+		busWrites = (BusWrite*)realloc( busWrites, maxBusWrites * sizeof( BusWrite ) );
+	}
+	if ( nBusWrites && busWrites[ nBusWrites - 1 ].cycle > cycle )
+	{
+		fprintf( stderr, "bus writes must be sorted by cycle (cycle %llu)\n", cycle );
+		exit( 2 );
+	}
+	busWrites[ nBusWrites ].cycle = cycle;
+	busWrites[ nBusWrites ].addr = addr;
+	busWrites[ nBusWrites ].value = value;
+	nBusWrites ++;
+}
+
+static bool parseNumber( const char *s, u64 *v )
+{
+	char *end;
+	if ( s[ 0 ] == '$' )
+		*v = strtoull( s + 1, &end, 16 ); else
+		*v = strtoull( s, &end, 0 );
+	return end != s && *end == 0;
+}
+
+static u32 loadFile( const char *name, u8 *dst, u32 maxSize )
+{
+	FILE *f = fopen( name, "rb" );
+	if ( f == NULL )
+	{
+		fprintf( stderr, "can't open '%s'\n", name );
+		exit( 2 );
+	}
+	u32 size = fread( dst, 1, maxSize, f );
+	fclose( f );
+	return size;
+}
+
+static void readTrace( const char *name )
+{
+	FILE *f = fopen( name, "rt" );
+	if ( f == NULL )
+	{
+		fprintf( stderr, "can't open trace '%s'\n", name );
+		exit( 2 );
+	}
+
+	char line[ 1024 ], a[ 512 ], b[ 512 ], c[ 512 ];
+	int lineNr = 0;
+	while ( fgets( line, sizeof( line ), f ) )
+	{
+		lineNr ++;
+		char *comment = strchr( line, '#' );
+		if ( comment ) *comment = 0;
+
+		int n = sscanf( line, "%511s %511s %511s", a, b, c );
+		if ( n <= 0 )
+			continue;
+
+		u64 v1, v2, v3;
+		bool ok = true;
+		if ( n == 3 && !strcmp( a, "load" ) )
+		{
+			ok = parseNumber( b, &v1 ) && v1 < 0xc000;
+			if ( ok ) loadFile( c, &cart_ram[ v1 ], 0xc000 - v1 );
+		} else
+		if ( n == 2 && !strcmp( a, "prg" ) )
+		{
+			static u8 prg[ 0xc002 ];
+			u32 size = loadFile( b, prg, sizeof( prg ) );
+			u32 addr = prg[ 0 ] | ( prg[ 1 ] << 8 );
+			ok = size > 2 && addr + size - 2 <= 0xc000;
+			if ( ok ) memcpy( &cart_ram[ addr ], &prg[ 2 ], size - 2 );
+		} else
+		if ( n == 2 && !strcmp( a, "chr" ) )
+		{
+			loadFile( b, charROM, 4096 );
+		} else
+		if ( n == 3 && parseNumber( a, &v1 ) && parseNumber( b, &v2 ) && parseNumber( c, &v3 ) )
+		{
+			ok = v2 < 0x10000 && v3 < 256;
+			if ( ok ) addBusWrite( v1, v2, v3 );
+		} else
+			ok = false;
+
+		if ( !ok )
+		{
+			fprintf( stderr, "%s:%d: invalid command\n", name, lineNr );
+			exit( 2 );
+		}
+	}
+	fclose( f );
+}
+
+// random screen, colors and charset, the background/border and volume register
+// are changed mid-frame, the oscillators are retriggered to exercise the audio path
+static void syntheticTrace( u32 seed, u64 cycles )
+{
+	srand( seed );
+
+	for ( u32 i = 0; i < 0x2000; i++ )
+		cart_ram[ i ] = rand();
+	for ( u32 i = 0x9400; i < 0x9800; i++ )
+		cart_ram[ i ] = rand();
+	for ( u32 i = 0; i < 4096; i++ )
+		charROM[ i ] = rand();
+
+	const u8 regs[ 16 ] = { 12, 38, 0x80 | 22, 0xae, 0, (u8)( 0xf0 | ( rand() & 15 ) ), 0, 0, 0, 0, 0, 0, 0, 0, 0x0f, 0x1b };
+	for ( u16 r = 0; r < 16; r++ )
+		addBusWrite( 0, 0x9000 + r, regs[ r ] );
+
+	for ( u64 c = 1; c < cycles; c += 1000 + rand() % 9000 )
+	{
+		switch ( rand() % 4 )
+		{
+		case 0: addBusWrite( c, 0x900f, rand() ); break;
+		case 1: addBusWrite( c, 0x900e, rand() ); break;
+		default: addBusWrite( c, 0x900a + rand() % 4, rand() ); break;
+		}
+	}
+}
+
+// decoding of CPU writes as in the FIQ handler of kernel_menu20.cpp
+static void busWrite( u16 addr, u8 D )
+{
+	if ( cfgVIC_VFLI_Support )
+	{
+		if ( addr == 0x9112 && D == 15 )
+			activateVFLIHack = 1;
+		if ( addr == 0x9110 )
+			bankVFLI = D & 0x0f;
+
+		if ( activateVFLIHack && addr >= 0x9400 && addr < 0x9600 )
+		{
+			u16 caddr = ( addr & 0x3ff ) | ( bankVFLI << 10 );
+			#ifdef VFLI_COLORRAM_4BIT
+			u8 nibble = ( caddr & 1 ) << 2;
+			u8 nibble_mask = nibble ? 0xf0 : 0x0f;
+			vfli_ram[ caddr >> 1 ] = ( vfli_ram[ caddr >> 1 ] & ~nibble_mask ) | ( ( D & 0x0f ) << nibble );
+			#else
+			vfli_ram[ caddr ] = D & 0xf;
+			#endif
+		}
+	}
+
+	if ( addr >= 0x9000 && addr <= 0x900f )
+		writeRegisterVIC656x( addr & 0x0f, D ); else
+	if ( addr < 0xc000 )
+		cart_ram[ addr ] = D;
+}
+
+//
+// output
+//
+static void put32BE( u8 *p, u32 v )
+{
+	p[ 0 ] = v >> 24; p[ 1 ] = v >> 16; p[ 2 ] = v >> 8; p[ 3 ] = v;
+}
+
+static void writePNGChunk( FILE *f, const char *type, const u8 *data, u32 size )
+{
+	u8 hdr[ 8 ];
+	put32BE( hdr, size );
+	memcpy( &hdr[ 4 ], type, 4 );
+	fwrite( hdr, 1, 8, f );
+	fwrite( data, 1, size, f );
+
+	u8 crc[ 4 ];
+	put32BE( crc, crc32( crc32( 0, (const u8*)type, 4 ), data, size ) );
+	fwrite( crc, 1, 4, f );
+}
+
+// 8 bit palettized PNG, the image data is zlib-compressed using stored blocks
+static void writePNG( const char *name, const u8 *img, u32 width, u32 height, const u8 *palette, u32 nColors )
+{
+	FILE *f = fopen( name, "wb" );
+	if ( f == NULL )
+	{
+		fprintf( stderr, "can't write '%s'\n", name );
+		exit( 2 );
+	}
+
+	static const u8 signature[ 8 ] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+	fwrite( signature, 1, 8, f );
+
+	u8 ihdr[ 13 ];
+	put32BE( &ihdr[ 0 ], width );
+	put32BE( &ihdr[ 4 ], height );
+	ihdr[ 8 ] = 8;	// bit depth
+	ihdr[ 9 ] = 3;	// palette
+	ihdr[ 10 ] = ihdr[ 11 ] = ihdr[ 12 ] = 0;
+	writePNGChunk( f, "IHDR", ihdr, 13 );
+	writePNGChunk( f, "PLTE", palette, nColors * 3 );
+
+	u32 rawSize = ( width + 1 ) * height;
+	u8 *raw = (u8*)malloc( rawSize );
+	for ( u32 y = 0; y < height; y++ )
+	{
+		raw[ y * ( width + 1 ) ] = 0; // no filter
+		memcpy( &raw[ y * ( width + 1 ) + 1 ], &img[ y * width ], width );
+	}
+
+	u32 nBlocks = ( rawSize + 65534 ) / 65535;
+	u8 *z = (u8*)malloc( 2 + rawSize + nBlocks * 5 + 4 ), *p = z;
+	*p++ = 0x78; *p++ = 0x01;
+	u32 a = 1, b = 0;
+	for ( u32 i = 0; i < rawSize; i += 65535 )
+	{
+		u32 len = rawSize - i < 65535 ? rawSize - i : 65535;
+		*p++ = ( i + len == rawSize ) ? 1 : 0;
+		*p++ = len; *p++ = len >> 8;
+		*p++ = ~len; *p++ = ~len >> 8;
+		memcpy( p, &raw[ i ], len );
+		p += len;
+		for ( u32 j = i; j < i + len; j++ )
+		{
+			a = ( a + raw[ j ] ) % 65521;
+			b = ( b + a ) % 65521;
+		}
+	}
+	put32BE( p, ( b << 16 ) | a );
+	p += 4;
+	writePNGChunk( f, "IDAT", z, p - z );
+	writePNGChunk( f, "IEND", NULL, 0 );
+
+	free( z );
+	free( raw );
+	fclose( f );
+}
+
+static void writeWAV( const char *name, const s16 *data, u32 n, u32 rate )
+{
+	FILE *f = fopen( name, "wb" );
+	if ( f == NULL )
+	{
+		fprintf( stderr, "can't write '%s'\n", name );
+		exit( 2 );
+	}
+
+	u32 dataSize = n * 2;
+	u8 hdr[ 44 ];
+	#define PUT16LE( p, v ) { (p)[ 0 ] = (v); (p)[ 1 ] = (v) >> 8; }
+	#define PUT32LE( p, v ) { PUT16LE( p, v ); PUT16LE( (p) + 2, (v) >> 16 ); }
+	memcpy( &hdr[ 0 ], "RIFF", 4 );	PUT32LE( &hdr[ 4 ], 36 + dataSize );
+	memcpy( &hdr[ 8 ], "WAVEfmt ", 8 );	PUT32LE( &hdr[ 16 ], 16 );
+	PUT16LE( &hdr[ 20 ], 1 );			// PCM
+	PUT16LE( &hdr[ 22 ], 1 );			// mono
+	PUT32LE( &hdr[ 24 ], rate );
+	PUT32LE( &hdr[ 28 ], rate * 2 );
+	PUT16LE( &hdr[ 32 ], 2 );
+	PUT16LE( &hdr[ 34 ], 16 );
+	memcpy( &hdr[ 36 ], "data", 4 );	PUT32LE( &hdr[ 40 ], dataSize );
+	fwrite( hdr, 1, 44, f );
+	for ( u32 i = 0; i < n; i++ )
+	{
+		u8 s[ 2 ];
+		PUT16LE( s, (u16)data[ i ] );
+		fwrite( s, 1, 2, f );
+	}
+	fclose( f );
+}
+
+//
+// emulation
+//
+static void addSample( s16 s )
+{
+	if ( nSamples == maxSamples )
+	{
+		maxSamples = maxSamples ? maxSamples * 2 : 65536;
+		samples = (s16*)realloc( samples, maxSamples * sizeof( s16 ) );
+	}
+	samples[ nSamples ++ ] = s;
+}
+
+// visible part of the frame buffer, same range as flushLinesVIC656x() copies
+static void visibleArea( u32 *x0, u32 *width, u32 *height )
+{
+	bool ntsc = vic656x.hCycles == VIC20_NTSC_H_CYCLES;
+	*x0 = 8 * vic656x.leftBorder + ( ntsc ? 80 : 16 );
+	*width = 8 * ( vic656x.rightBorder - vic656x.leftBorder + 1 );
+	*height = 2 * ( ntsc ? VIC20_NTSC_LAST_LINE - VIC20_NTSC_FIRST_LINE : VIC20_PAL_LAST_LINE - VIC20_PAL_FIRST_LINE );
+}
+
+static u8 *cropFrame()
+{
+	u32 x0, width, height;
+	visibleArea( &x0, &width, &height );
+
+	static u8 img[ 2 * VIC_LINES * VIC_LINE_BYTES ];
+	for ( u32 y = 0; y < height; y++ )
+		memcpy( &img[ y * width ], &frameBuffer[ y ][ x0 ], width );
+	return img;
+}
+
+// runs the emulation until nFrames frames are complete, calls onFrame for each of them
+// returns the number of emulated cycles, the time spent in the flush is added to flushTime
+static u64 emulate( u32 nFrames, void ( *onFrame )( u32 frame ), double *flushTime )
+{
+	u64 cycle = 0;
+	u32 nextWrite = 0;
+	s32 frame = -1;
+	s16 prevLine = vicCurrentLine;
+
+	while ( frame < (s32)nFrames )
+	{
+		while ( nextWrite < nBusWrites && busWrites[ nextWrite ].cycle <= cycle )
+		{
+			busWrite( busWrites[ nextWrite ].addr, busWrites[ nextWrite ].value );
+			nextWrite ++;
+		}
+
+		tickVIC656x();
+
+		// done asynchronously in the main loop on the Pi
+		sampleUpdateVIC656x();
+		if ( vic656x.hasSampleOutput )
+		{
+			addSample( vic656x.curSampleOutput );
+			vic656x.hasSampleOutput = 0;
+		}
+
+		if ( vicCurrentLine != prevLine )
+		{
+			prevLine = vicCurrentLine;
+
+			double t0 = flushTime ? nanoseconds() : 0;
+			flushLinesVIC656x();
+			if ( flushTime ) *flushTime += nanoseconds() - t0;
+
+			// line 1 started: the last line of the previous frame is flushed
+			if ( vicCurrentLine == 1 )
+			{
+				if ( frame >= 0 && onFrame )
+					onFrame( frame );
+				frame ++;
+			}
+		}
+
+		cycle ++;
+	}
+	return cycle;
+}
+
+static const char *outputPrefix = NULL;
+static u8 pngPalette[ 32 * 3 ];
+
+static void storeFrame( u32 frame )
+{
+	u32 x0, width, height;
+	visibleArea( &x0, &width, &height );
+	u8 *img = cropFrame();
+
+	frameCRC[ frame ] = crc32( 0, img, width * height );
+
+	if ( outputPrefix )
+	{
+		char name[ 1024 ];
+		snprintf( name, sizeof( name ), "%s%03d.png", outputPrefix, frame );
+		writePNG( name, img, width, height, pngPalette, 32 );
+	}
+}
+
+// same palette setup as updatePalette() in kernel_menu20.cpp (without the RGB565 quantization)
+static void setupPalette( bool ntsc, int scanlineIntensity )
+{
+	u8 *rgb1 = ntsc ? VIC20_paletteNTSC : VIC20_palettePAL_Even;
+	u8 *rgb2 = ntsc ? VIC20_paletteNTSC : VIC20_palettePAL_Odd;
+
+	for ( int i = 0; i < 16 * 3; i++ )
+	{
+		pngPalette[ i ] = rgb1[ i ];
+		pngPalette[ i + 16 * 3 ] = ( rgb2[ i ] * scanlineIntensity ) >> 8;
+	}
+}
+
+static int compareGolden( const char *name, u32 nFrames, u32 audioCRC )
+{
+	FILE *f = fopen( name, "rt" );
+	if ( f == NULL )
+	{
+		fprintf( stderr, "can't open golden file '%s'\n", name );
+		return 1;
+	}
+
+	u32 nChecked = 0, nFailed = 0;
+	char line[ 256 ];
+	while ( fgets( line, sizeof( line ), f ) )
+	{
+		u32 frame, crc;
+		if ( sscanf( line, "frame %u %x", &frame, &crc ) == 2 && frame < nFrames )
+		{
+			nChecked ++;
+			if ( crc != frameCRC[ frame ] )
+			{
+				printf( "frame %u: checksum %08x, expected %08x\n", frame, frameCRC[ frame ], crc );
+				nFailed ++;
+			}
+		} else
+		if ( sscanf( line, "audio %x", &crc ) == 1 )
+		{
+			nChecked ++;
+			if ( crc != audioCRC )
+			{
+				printf( "audio: checksum %08x, expected %08x\n", audioCRC, crc );
+				nFailed ++;
+			}
+		}
+	}
+	fclose( f );
+
+	if ( nChecked == 0 )
+	{
+		printf( "golden file '%s' has no matching entries\n", name );
+		return 1;
+	}
+	printf( "%u of %u checks passed\n", nChecked - nFailed, nChecked );
+	return nFailed ? 1 : 0;
+}
+
+static void usage()
+{
+	fprintf( stderr, "usage: vicharness [-n frames] [-ntsc] [-s seed] [-o prefix] [-G golden] [-g golden] [-b] [-f] [-v] [-d] [-i intensity] [trace]\n" );
+	exit( 2 );
+}
+
+int main( int argc, char **argv )
+{
+	u32 nFrames = 4;
+	bool ntsc = false, benchmark = false, debugBorders = false;
+	bool synthetic = false;
+	u32 seed = 0;
+	int scanlineIntensity = 256;
+	const char *trace = NULL, *goldenOut = NULL, *goldenIn = NULL;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		bool hasArg = i + 1 < argc;
+		if ( !strcmp( argv[ i ], "-n" ) && hasArg ) nFrames = atoi( argv[ ++ i ] ); else
+		if ( !strcmp( argv[ i ], "-ntsc" ) ) ntsc = true; else
+		if ( !strcmp( argv[ i ], "-s" ) && hasArg ) { synthetic = true; seed = atoi( argv[ ++ i ] ); } else
+		if ( !strcmp( argv[ i ], "-o" ) && hasArg ) outputPrefix = argv[ ++ i ]; else
+		if ( !strcmp( argv[ i ], "-G" ) && hasArg ) goldenOut = argv[ ++ i ]; else
+		if ( !strcmp( argv[ i ], "-g" ) && hasArg ) goldenIn = argv[ ++ i ]; else
+		if ( !strcmp( argv[ i ], "-b" ) ) benchmark = true; else
+		if ( !strcmp( argv[ i ], "-f" ) ) cfgVIC_Audio_Filter = 1; else
+		if ( !strcmp( argv[ i ], "-v" ) ) cfgVIC_VFLI_Support = 1; else
+		if ( !strcmp( argv[ i ], "-d" ) ) debugBorders = true; else
+		if ( !strcmp( argv[ i ], "-i" ) && hasArg ) scanlineIntensity = atoi( argv[ ++ i ] ); else
+		if ( argv[ i ][ 0 ] != '-' && trace == NULL ) trace = argv[ i ]; else
+			usage();
+	}
+
+	if ( nFrames == 0 || nFrames > MAX_FRAMES || ( trace == NULL && !synthetic ) )
+		usage();
+
+	initCRC();
+	pScreen = (u16*)frameBuffer;
+	pitch = VIC_LINE_BYTES / 2;
+
+	initVIC656x( !ntsc, debugBorders );
+	setupPalette( ntsc, scanlineIntensity );
+
+	if ( trace )
+		readTrace( trace );
+	if ( synthetic )
+		syntheticTrace( seed, (u64)( nFrames + 2 ) * vic656x.hCycles * vic656x.vLines );
+
+	if ( benchmark )
+	{
+		double flushTime = 0;
+		double t0 = nanoseconds();
+		u64 cycles = emulate( nFrames, NULL, &flushTime );
+		double t = nanoseconds() - t0;
+
+		printf( "%llu cycles, %u frames, %u samples\n", cycles, nFrames, nSamples );
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+		const char *flushLabel = "line flush";
+#else
+		// flushLinesVIC656x is the scalar fallback here, not the NEON code of the firmware
+		const char *flushLabel = "line flush (host scalar fallback)";
+#endif
+		printf( "%.2f ns per emulated cycle (video+audio %.2f, %s %.2f), %.1fx real-time\n",
+			t / cycles, ( t - flushTime ) / cycles, flushLabel, flushTime / cycles, 1e9 / ( t / cycles ) / vic656x.clock );
+		return 0;
+	}
+
+	emulate( nFrames, storeFrame, NULL );
+
+	u32 audioCRC = crc32( 0, (const u8*)samples, nSamples * sizeof( s16 ) );
+
+	if ( outputPrefix )
+	{
+		char name[ 1024 ];
+		snprintf( name, sizeof( name ), "%s.wav", outputPrefix );
+		writeWAV( name, samples, nSamples, 32000 );
+	}
+
+	if ( goldenOut )
+	{
+		FILE *f = fopen( goldenOut, "wt" );
+		if ( f == NULL )
+		{
+			fprintf( stderr, "can't write '%s'\n", goldenOut );
+			return 2;
+		}
+		for ( u32 i = 0; i < nFrames; i++ )
+			fprintf( f, "frame %u %08x\n", i, frameCRC[ i ] );
+		fprintf( f, "audio %08x\n", audioCRC );
+		fclose( f );
+	}
+
+	if ( goldenIn )
+		return compareGolden( goldenIn, nFrames, audioCRC );
+
+	for ( u32 i = 0; i < nFrames; i++ )
+		printf( "frame %u %08x\n", i, frameCRC[ i ] );
+	printf( "audio %08x (%u samples)\n", audioCRC, nSamples );
+
+	return 0;
+}